@@ -168,6 +168,13 @@ void decompressAssets() {
 
     fixPointers(g_mainAssets);
 
+    // font offsets table is followed by the first font
+    font::resetGlyphMetrics();
+    uint32_t numFonts = ((uint32_t *)g_mainAssets.fontsData)[0] / 4;
+    for (uint32_t fontID = 1; fontID <= numFonts; fontID++) {
+        font::buildGlyphMetrics(getFontData(fontID));
+    }
+
     g_assetsLoaded = true;
 }
 
@@ -224,6 +231,10 @@ const uint16_t *getColors() {
     return g_mainAssets.colorsData->colors.first;
 }
 
+const uint32_t getColorsCount() {
+    return g_mainAssets.colorsData->colors.count;
+}
+
 const char *getActionName(int16_t actionId) {
     if (actionId == 0) {
         return nullptr;
@@ -310,6 +321,9 @@ bool loadExternalAssets(const char *filePath, int *err) {
 
     fixPointers(g_externalAssets);
 
+    // external page widgets are at the new addresses
+    resetStaticWidgetsCache();
+
     return true;
 }
 
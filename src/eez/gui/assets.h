@@ -36,6 +36,7 @@ const char *getThemeName(int i);
 const uint16_t *getThemeColors(int themeIndex);
 const uint32_t getThemeColorsCount(int themeIndex);
 const uint16_t *getColors();
+const uint32_t getColorsCount();
 
 const char *getActionName(int16_t actionId);
 int16_t getDataIdFromName(const char *name);
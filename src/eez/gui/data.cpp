@@ -276,6 +276,14 @@ void YT_DATA_GET_VALUE_FUNCTION_POINTER_value_to_text(const Value &value, char *
     text[0] = 0;
 }
 
+bool compare_YT_DATA_GET_VALUES_FUNCTION_POINTER_value(const Value &a, const Value &b) {
+    return a.getUInt32() == b.getUInt32();
+}
+
+void YT_DATA_GET_VALUES_FUNCTION_POINTER_value_to_text(const Value &value, char *text, int count) {
+    text[0] = 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #define VALUE_TYPE(NAME) bool compare_##NAME##_value(const Value &a, const Value &b);
@@ -780,6 +788,15 @@ Value::YtDataGetValueFunctionPointer ytDataGetGetValueFunc(Cursor cursor, int16_
     return value.getYtDataGetValueFunctionPointer();
 }
 
+Value::YtDataGetValuesFunctionPointer ytDataGetGetValuesFunc(Cursor cursor, int16_t id) {
+    Value value;
+    DATA_OPERATION_FUNCTION(id, DATA_OPERATION_YT_DATA_GET_GET_VALUES_FUNC, cursor, value);
+    if (value.getType() != VALUE_TYPE_YT_DATA_GET_VALUES_FUNCTION_POINTER) {
+        return nullptr;
+    }
+    return value.getYtDataGetValuesFunctionPointer();
+}
+
 uint8_t ytDataGetGraphUpdateMethod(Cursor cursor, int16_t id) {
     Value value;
     DATA_OPERATION_FUNCTION(id, DATA_OPERATION_YT_DATA_GET_GRAPH_UPDATE_METHOD, cursor, value);
@@ -164,6 +164,15 @@ struct Value {
     {
     }
 
+    // Bulk version of YtDataGetValueFunctionPointer, fills min (and max, if not nullptr)
+    // for numRows rows starting from rowIndex.
+    typedef void (*YtDataGetValuesFunctionPointer)(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max);
+
+    Value(YtDataGetValuesFunctionPointer ytDataGetValuesFunctionPointer)
+        : type_(VALUE_TYPE_YT_DATA_GET_VALUES_FUNCTION_POINTER), pVoid_((void *)ytDataGetValuesFunctionPointer)
+    {
+    }
+
     bool operator==(const Value &other) const;
 
     bool operator!=(const Value &other) const {
@@ -248,6 +257,10 @@ struct Value {
         return (YtDataGetValueFunctionPointer)pVoid_;
     }
 
+    YtDataGetValuesFunctionPointer getYtDataGetValuesFunctionPointer() const {
+        return (YtDataGetValuesFunctionPointer)pVoid_;
+    }
+
     uint8_t getFirstUInt8() const {
         return pairOfUint8_.first;
     }
@@ -384,6 +397,7 @@ enum DataOperationEnum {
     DATA_OPERATION_YT_DATA_GET_SELECTED_VALUE_INDEX,
     DATA_OPERATION_YT_DATA_GET_LABEL,
     DATA_OPERATION_YT_DATA_GET_GET_VALUE_FUNC,
+    DATA_OPERATION_YT_DATA_GET_GET_VALUES_FUNC,
     DATA_OPERATION_YT_DATA_GET_GRAPH_UPDATE_METHOD,
     DATA_OPERATION_YT_DATA_GET_PERIOD,
     DATA_OPERATION_YT_DATA_IS_CURSOR_VISIBLE,
@@ -457,6 +471,7 @@ struct YtDataGetLabelParams {
 };
 void ytDataGetLabel(Cursor cursor, int16_t id, uint8_t valueIndex, char *text, int count);
 Value::YtDataGetValueFunctionPointer ytDataGetGetValueFunc(Cursor cursor, int16_t id);
+Value::YtDataGetValuesFunctionPointer ytDataGetGetValuesFunc(Cursor cursor, int16_t id);
 uint8_t ytDataGetGraphUpdateMethod(Cursor cursor, int16_t id);
 float ytDataGetPeriod(Cursor cursor, int16_t id);
 bool ytDataIsCursorVisible(Cursor cursor, int16_t id);
@@ -57,23 +57,25 @@ font::Font styleGetFont(const Style *style) {
 }
 
 bool styleGetSmallerFont(font::Font &font) {
+    int fontID;
     if (font.fontData == getFontData(FONT_ID_OSWALD48)) {
-        font.fontData = getFontData(FONT_ID_OSWALD38);
+        fontID = FONT_ID_OSWALD38;
     } else if (font.fontData == getFontData(FONT_ID_OSWALD38)) {
-        font.fontData = getFontData(FONT_ID_OSWALD24);
+        fontID = FONT_ID_OSWALD24;
     } else if (font.fontData == getFontData(FONT_ID_OSWALD24)) {
-        font.fontData = getFontData(FONT_ID_OSWALD20);
+        fontID = FONT_ID_OSWALD20;
     } else if (font.fontData == getFontData(FONT_ID_OSWALD20)) {
-        font.fontData = getFontData(FONT_ID_OSWALD17);
+        fontID = FONT_ID_OSWALD17;
     } else if (font.fontData == getFontData(FONT_ID_OSWALD17)) {
-        font.fontData = getFontData(FONT_ID_OSWALD14);
+        fontID = FONT_ID_OSWALD14;
     } else if (font.fontData == getFontData(FONT_ID_OSWALD14)) {
-        font.fontData = getFontData(FONT_ID_OSWALD12);
+        fontID = FONT_ID_OSWALD12;
     } else if (font.fontData == getFontData(FONT_ID_OSWALD12)) {
-        font.fontData = getFontData(FONT_ID_ROBOTO_CONDENSED_REGULAR);
+        fontID = FONT_ID_ROBOTO_CONDENSED_REGULAR;
     } else {
         return false;
     }
+    font = font::Font(getFontData(fontID));
     return true;
 }
 
@@ -18,6 +18,9 @@
 
 #include <eez/gui/font.h>
 
+#define CONF_GUI_MAX_FONTS 16
+#define CONF_GUI_MAX_GLYPH_METRICS 1536
+
 namespace eez {
 namespace gui {
 namespace font {
@@ -37,10 +40,76 @@ offset
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Font::Font() : fontData(0) {
+struct FontGlyphMetrics {
+    const uint8_t *fontData;
+    const GlyphMetrics *glyphMetrics;
+};
+
+static FontGlyphMetrics g_fontGlyphMetrics[CONF_GUI_MAX_FONTS];
+static int g_numFontGlyphMetrics;
+
+static GlyphMetrics g_glyphMetrics[CONF_GUI_MAX_GLYPH_METRICS];
+static int g_numGlyphMetrics;
+
+static const GlyphMetrics *findGlyphMetrics(const uint8_t *fontData) {
+    for (int i = 0; i < g_numFontGlyphMetrics; i++) {
+        if (g_fontGlyphMetrics[i].fontData == fontData) {
+            return g_fontGlyphMetrics[i].glyphMetrics;
+        }
+    }
+    return nullptr;
+}
+
+void buildGlyphMetrics(const uint8_t *fontData) {
+    if (!fontData || findGlyphMetrics(fontData) || g_numFontGlyphMetrics == CONF_GUI_MAX_FONTS) {
+        return;
+    }
+
+    Font font(fontData);
+
+    uint8_t start = fontData[2];
+    uint8_t end = fontData[3];
+    if (start > end || g_numGlyphMetrics + (end - start + 1) > CONF_GUI_MAX_GLYPH_METRICS) {
+        // font without glyph metrics still works, glyph headers are decoded on every lookup
+        return;
+    }
+
+    GlyphMetrics *glyphMetrics = g_glyphMetrics + g_numGlyphMetrics;
+    g_numGlyphMetrics += end - start + 1;
+
+    for (int encoding = start; encoding <= end; encoding++) {
+        Glyph glyph;
+        font.getGlyph(encoding, glyph);
+
+        GlyphMetrics &metrics = glyphMetrics[encoding - start];
+        if (glyph) {
+            metrics.offset = glyph.data - fontData;
+            metrics.dx = glyph.dx;
+            metrics.width = glyph.width;
+            metrics.height = glyph.height;
+            metrics.x = glyph.x;
+            metrics.y = glyph.y;
+        } else {
+            metrics.offset = 0;
+        }
+    }
+
+    g_fontGlyphMetrics[g_numFontGlyphMetrics].fontData = fontData;
+    g_fontGlyphMetrics[g_numFontGlyphMetrics].glyphMetrics = glyphMetrics;
+    g_numFontGlyphMetrics++;
+}
+
+void resetGlyphMetrics() {
+    g_numFontGlyphMetrics = 0;
+    g_numGlyphMetrics = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Font::Font() : fontData(0), glyphMetrics(0) {
 }
 
-Font::Font(const uint8_t *data) : fontData(data) {
+Font::Font(const uint8_t *data) : fontData(data), glyphMetrics(findGlyphMetrics(data)) {
 }
 
 uint8_t Font::getAscent() {
@@ -106,6 +175,28 @@ void Font::fillGlyphParameters(Glyph &glyph) {
 }
 
 void Font::getGlyph(uint8_t requested_encoding, Glyph &glyph) {
+    if (glyphMetrics) {
+        uint8_t start = getEncodingStart();
+        if (requested_encoding < start || requested_encoding > getEncodingEnd()) {
+            glyph.data = nullptr;
+            return;
+        }
+
+        const GlyphMetrics &metrics = glyphMetrics[requested_encoding - start];
+        if (!metrics.offset) {
+            glyph.data = nullptr;
+            return;
+        }
+
+        glyph.data = fontData + metrics.offset;
+        glyph.dx = metrics.dx;
+        glyph.width = metrics.width;
+        glyph.height = metrics.height;
+        glyph.x = metrics.x;
+        glyph.y = metrics.y;
+        return;
+    }
+
     glyph.data = findGlyphData(requested_encoding);
     if (glyph.data) {
         fillGlyphParameters(glyph);
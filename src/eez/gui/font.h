@@ -40,8 +40,19 @@ struct Glyph {
     }
 };
 
+// Glyph header fields decoded in advance, so glyph lookup is a single array access.
+struct GlyphMetrics {
+    uint32_t offset; // glyph header offset from the font data start, 0 if glyph doesn't exist
+    int8_t dx;
+    uint8_t width;
+    uint8_t height;
+    int8_t x;
+    int8_t y;
+};
+
 struct Font {
     const uint8_t *fontData;
+    const GlyphMetrics *glyphMetrics; // indexed by (encoding - encoding start), can be null
 
     Font();
     Font(const uint8_t *data);
@@ -60,6 +71,10 @@ struct Font {
     void fillGlyphParameters(Glyph &glyph);
 };
 
+// Builds glyph metrics table for the font, Font objects constructed afterwards use it.
+void buildGlyphMetrics(const uint8_t *fontData);
+void resetGlyphMetrics();
+
 } // namespace font
 } // namespace gui
 } // namespace eez
@@ -30,6 +30,7 @@
 #include <eez/util.h>
 
 #include <eez/gui/gui.h>
+#include <eez/gui/profiler.h>
 
 #define CONF_GUI_BLINK_TIME 400 // 400ms
 
@@ -141,8 +142,12 @@ void oneIter() {
 
     WATCHDOG_RESET();
 
+    profiler::beginFrame();
+
     mcu::display::sync();
 
+    profiler::endPhase(profiler::PHASE_SYNC);
+
     g_wasBlinkTime = g_isBlinkTime;
     g_isBlinkTime = (millis() % (2 * CONF_GUI_BLINK_TIME)) > CONF_GUI_BLINK_TIME;
 
@@ -156,8 +161,13 @@ void oneIter() {
     appContext->rect.h = mcu::display::getDisplayHeight();
 
     eventHandling();
+
+    profiler::endPhase(profiler::PHASE_EVENTS);
+
     stateManagmentHook();
 
+    profiler::endPhase(profiler::PHASE_STATE);
+
     bool wasOn = mcu::display::isOn();
     if (wasOn) {
         mcu::display::beginBuffersDrawing();
@@ -173,6 +183,9 @@ void oneIter() {
     if (wasOn || mcu::display::isOn()) {
         mcu::display::endBuffersDrawing();
     }
+
+    profiler::endPhase(profiler::PHASE_UPDATE);
+    profiler::endFrame();
 }
 
 void sendMessageToGuiThread(uint8_t messageType, uint32_t messageParam, uint32_t timeoutMillisec) {
@@ -103,7 +103,7 @@ void overlayEnumWidgetHook(WidgetCursor &widgetCursor, EnumWidgetsCallback callb
     Value widgetCursorValue((void *)&widgetCursor, VALUE_TYPE_POINTER);
     DATA_OPERATION_FUNCTION(containerWidget->overlay, DATA_OPERATION_UPDATE_OVERLAY_DATA, widgetCursor.cursor, widgetCursorValue);
 
-    if (callback == findWidgetStep) {
+    if (callback == findWidgetStep || callback == hitTestIndexStep) {
         int xOverlayOffset = 0;
         int yOverlayOffset = 0;
         getOverlayOffset(widgetCursor, xOverlayOffset, yOverlayOffset);
@@ -0,0 +1,138 @@
+/*
+ * EEZ Modular Firmware
+ * Copyright (C) 2015-present, Envox d.o.o.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#if OPTION_DISPLAY
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <eez/system.h>
+
+#include <eez/gui/profiler.h>
+
+namespace eez {
+namespace gui {
+namespace profiler {
+
+static uint32_t g_phaseTimes[CONF_GUI_PROFILER_NUM_FRAMES][NUM_PHASES];
+static int g_frameIndex; // next frame is recorded here
+static int g_numFrames;
+
+static uint32_t g_currentPhaseTimes[NUM_PHASES];
+static uint32_t g_phaseStartTime;
+
+static bool g_overlayVisible;
+
+static const char *g_phaseNames[NUM_PHASES + 1] = {
+    "sync",
+    "events",
+    "state",
+    "update",
+    "frame"
+};
+
+void beginFrame() {
+    memset(g_currentPhaseTimes, 0, sizeof(g_currentPhaseTimes));
+    g_phaseStartTime = micros();
+}
+
+void endPhase(Phase phase) {
+    uint32_t time = micros();
+    g_currentPhaseTimes[phase] += time - g_phaseStartTime;
+    g_phaseStartTime = time;
+}
+
+void endFrame() {
+    memcpy(g_phaseTimes[g_frameIndex], g_currentPhaseTimes, sizeof(g_currentPhaseTimes));
+
+    g_frameIndex = (g_frameIndex + 1) % CONF_GUI_PROFILER_NUM_FRAMES;
+    if (g_numFrames < CONF_GUI_PROFILER_NUM_FRAMES) {
+        g_numFrames++;
+    }
+}
+
+const char *getPhaseName(int phase) {
+    return g_phaseNames[phase];
+}
+
+int getNumFrames() {
+    return g_numFrames;
+}
+
+uint32_t getPhaseTime(int frameIndex, int phase) {
+    const uint32_t *phaseTimes = g_phaseTimes[(g_frameIndex - g_numFrames + frameIndex + CONF_GUI_PROFILER_NUM_FRAMES) % CONF_GUI_PROFILER_NUM_FRAMES];
+
+    if (phase == NUM_PHASES) {
+        uint32_t frameTime = 0;
+        for (int i = 0; i < NUM_PHASES; i++) {
+            frameTime += phaseTimes[i];
+        }
+        return frameTime;
+    }
+
+    return phaseTimes[phase];
+}
+
+static int compareTimes(const void *a, const void *b) {
+    uint32_t timeA = *(const uint32_t *)a;
+    uint32_t timeB = *(const uint32_t *)b;
+    return timeA < timeB ? -1 : timeA > timeB ? 1 : 0;
+}
+
+void getStatistics(PhaseStatistics *statistics) {
+    int numFrames = g_numFrames;
+
+    for (int phase = 0; phase <= NUM_PHASES; phase++) {
+        PhaseStatistics &phaseStatistics = statistics[phase];
+
+        if (numFrames == 0) {
+            memset(&phaseStatistics, 0, sizeof(PhaseStatistics));
+            continue;
+        }
+
+        uint32_t times[CONF_GUI_PROFILER_NUM_FRAMES];
+        uint64_t total = 0;
+        for (int i = 0; i < numFrames; i++) {
+            times[i] = getPhaseTime(i, phase);
+            total += times[i];
+        }
+
+        qsort(times, numFrames, sizeof(uint32_t), compareTimes);
+
+        phaseStatistics.min = times[0];
+        phaseStatistics.avg = (uint32_t)(total / numFrames);
+        // nearest rank
+        phaseStatistics.p99 = times[(99 * numFrames + 99) / 100 - 1];
+        phaseStatistics.max = times[numFrames - 1];
+    }
+}
+
+void setOverlayVisible(bool visible) {
+    g_overlayVisible = visible;
+}
+
+bool isOverlayVisible() {
+    return g_overlayVisible;
+}
+
+} // namespace profiler
+} // namespace gui
+} // namespace eez
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * EEZ Modular Firmware
+ * Copyright (C) 2015-present, Envox d.o.o.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+
+namespace eez {
+namespace gui {
+namespace profiler {
+
+// Phases of the GUI thread main loop iteration (gui::oneIter), in order of execution.
+enum Phase {
+    PHASE_SYNC,   // mcu::display::sync, in the simulator it includes frame pacing
+    PHASE_EVENTS, // touch::tick and eventHandling
+    PHASE_STATE,  // stateManagmentHook
+    PHASE_UPDATE, // gui::updateScreen and composing of the display buffers
+    NUM_PHASES
+};
+
+#define CONF_GUI_PROFILER_NUM_FRAMES 128
+
+struct PhaseStatistics {
+    uint32_t min;
+    uint32_t avg;
+    uint32_t p99;
+    uint32_t max;
+};
+
+void beginFrame();
+void endPhase(Phase phase);
+void endFrame();
+
+// Phase index NUM_PHASES is the whole frame.
+const char *getPhaseName(int phase);
+
+// Timings are in microseconds, frameIndex 0 is the oldest recorded frame.
+int getNumFrames();
+uint32_t getPhaseTime(int frameIndex, int phase);
+
+// Fills NUM_PHASES + 1 statistics, the last one is for the whole frame.
+void getStatistics(PhaseStatistics *statistics);
+
+void setOverlayVisible(bool visible);
+bool isOverlayVisible();
+
+} // namespace profiler
+} // namespace gui
+} // namespace eez
@@ -18,7 +18,10 @@
 
 #if OPTION_DISPLAY
 
+#include <string.h>
+
 #include <eez/debug.h>
+#include <eez/system.h>
 
 #include <eez/gui/gui.h>
 
@@ -28,6 +31,9 @@ namespace gui {
 static uint8_t g_stateBuffer[2][CONF_MAX_STATE_SIZE];
 static WidgetState *g_previousState;
 static WidgetState *g_currentState;
+static bool g_wasTouched;
+
+UpdateScreenStatistics g_updateScreenStatistics;
 
 int getCurrentStateBufferIndex() {
     return (uint8_t *)g_currentState == &g_stateBuffer[0][0] ? 0 : 1;
@@ -39,9 +45,26 @@ uint32_t getCurrentStateBufferSize(const WidgetCursor &widgetCursor) {
 
 void refreshScreen() {
     g_currentState = 0;
+    invalidateHitTestIndex();
+}
+
+void resetUpdateScreenStatistics() {
+    memset(&g_updateScreenStatistics, 0, sizeof(g_updateScreenStatistics));
 }
 
 void updateScreen() {
+    uint32_t startTime = micros();
+
+    g_updateScreenStatistics.numWidgetsVisited = 0;
+    g_updateScreenStatistics.numWidgetsSkipped = 0;
+    g_updateScreenStatistics.numVersionedWidgetsSkipped = 0;
+
+    // while touched, application can mark otherwise static widgets as active
+    bool isTouched = touch::getEventType() != EVENT_TYPE_TOUCH_NONE;
+    g_staticWidgetsSkipAllowed = !isTouched && !g_wasTouched;
+    g_wasTouched = isTouched;
+    g_skipWidgetsFrame++;
+
     g_isActiveWidget = false;
     g_previousState = g_currentState;
     g_currentState = (WidgetState *)(&g_stateBuffer[getCurrentStateBufferIndex() == 0 ? 1 : 0][0]);
@@ -51,7 +74,20 @@ void updateScreen() {
 	widgetCursor.previousState = g_previousState;
 	widgetCursor.currentState = g_currentState;
 
+    beginLayoutHash();
     widgetCursor.appContext->updateAppView(widgetCursor);
+    endLayoutHash();
+
+    uint32_t frameTime = micros() - startTime;
+    g_updateScreenStatistics.numFrames++;
+    g_updateScreenStatistics.frameTime = frameTime;
+    if (frameTime > g_updateScreenStatistics.maxFrameTime) {
+        g_updateScreenStatistics.maxFrameTime = frameTime;
+    }
+    g_updateScreenStatistics.totalFrameTime += frameTime;
+    g_updateScreenStatistics.totalWidgetsVisited += g_updateScreenStatistics.numWidgetsVisited;
+    g_updateScreenStatistics.totalWidgetsSkipped += g_updateScreenStatistics.numWidgetsSkipped;
+    g_updateScreenStatistics.totalVersionedWidgetsSkipped += g_updateScreenStatistics.numVersionedWidgetsSkipped;
 }
 
 } // namespace gui
@@ -18,9 +18,27 @@
 
 #pragma once
 
+#include <stdint.h>
+
 namespace eez {
 namespace gui {
 
+struct UpdateScreenStatistics {
+    uint32_t numFrames;
+    uint32_t numWidgetsVisited; // in the last frame
+    uint32_t numWidgetsSkipped; // in the last frame
+    uint32_t numVersionedWidgetsSkipped; // in the last frame, included in numWidgetsSkipped
+    uint32_t frameTime; // last frame, in microseconds
+    uint32_t maxFrameTime;
+    uint64_t totalFrameTime;
+    uint64_t totalWidgetsVisited;
+    uint64_t totalWidgetsSkipped;
+    uint64_t totalVersionedWidgetsSkipped;
+};
+
+extern UpdateScreenStatistics g_updateScreenStatistics;
+void resetUpdateScreenStatistics();
+
 void updateScreen();
 
 } // namespace gui
@@ -21,10 +21,12 @@
 #include <assert.h>
 #include <cstddef>
 #include <limits.h>
+#include <string.h>
 
 #include <eez/system.h>
 
 #include <eez/gui/gui.h>
+#include <eez/gui/widgets/container.h>
 
 using namespace eez::mcu;
 
@@ -33,6 +35,8 @@ namespace gui {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static void findWidgetInHitTestIndex(AppContext *appContext);
+
 static int g_findWidgetAtX;
 static int g_findWidgetAtY;
 static WidgetCursor g_foundWidget;
@@ -41,6 +45,10 @@ static bool g_clicked;
 
 bool g_isActiveWidget;
 
+bool g_skipStaticWidgets = true;
+bool g_staticWidgetsSkipAllowed;
+uint32_t g_skipWidgetsFrame;
+
 ////////////////////////////////////////////////////////////////////////////////
 
 FixPointersFunctionType NONE_fixPointers = nullptr;
@@ -117,6 +125,10 @@ void drawWidgetCallback(const WidgetCursor &widgetCursor_) {
 
     widgetCursor.currentState->flags.active = g_isActiveWidget;
 
+    g_updateScreenStatistics.numWidgetsVisited++;
+
+    hashLayoutWidget(widgetCursor);
+
     const Widget *widget = widgetCursor.widget;
     if (*g_drawWidgetFunctions[widget->type]) {
         (*g_drawWidgetFunctions[widget->type])(widgetCursor);
@@ -140,6 +152,182 @@ void WidgetCursor::nextState() {
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Static widget is a text, rectangle, bitmap or (non overlay) container of static
+// widgets without data, action and blinking style. Its state never changes, so
+// once it is drawn, whole subtree state can be copied from the previous state
+// without visiting it again.
+//
+// Versioned widget is like static widget, but it can also be a display data or
+// select widget and it can have an action and data for which isVersionedDataHook
+// returns true. Application keeps a change counter for such data (see
+// getDataVersionHook), so subtree state is copied from the previous state only
+// if the counter didn't change since the previous frame.
+
+#define CONF_GUI_STATIC_WIDGETS_CACHE_SIZE 256
+#define CONF_GUI_VERSIONED_WIDGETS_CACHE_SIZE 64
+
+struct StaticWidgetsCacheEntry {
+    const Widget *widget;
+    uint16_t numWidgets; // 0 if not static
+    bool versioned;
+};
+
+static StaticWidgetsCacheEntry g_staticWidgetsCache[CONF_GUI_STATIC_WIDGETS_CACHE_SIZE];
+
+struct VersionedWidgetsCacheEntry {
+    const Widget *widget;
+    Cursor cursor;
+    uint32_t version;
+    uint32_t frame;
+};
+
+static VersionedWidgetsCacheEntry g_versionedWidgetsCache[CONF_GUI_VERSIONED_WIDGETS_CACHE_SIZE];
+
+static uint16_t getNumStaticWidgets(const Widget *widget, bool &versioned);
+
+static uint16_t countStaticWidgets(const Widget *widget, bool &versioned) {
+    versioned = false;
+
+    if (widget->data != DATA_ID_NONE || widget->action != ACTION_ID_NONE) {
+        if (widget->data == DATA_ID_NONE || !isVersionedDataHook(widget->data)) {
+            return 0;
+        }
+        versioned = true;
+    }
+
+    if (styleIsBlink(getStyle(widget->style))) {
+        return 0;
+    }
+
+    if (widget->type == WIDGET_TYPE_TEXT || widget->type == WIDGET_TYPE_RECTANGLE || widget->type == WIDGET_TYPE_BITMAP) {
+        return 1;
+    }
+
+    if (widget->type == WIDGET_TYPE_DISPLAY_DATA) {
+        return versioned ? 1 : 0;
+    }
+
+    uint32_t numWidgets = 1;
+
+    if (widget->type == WIDGET_TYPE_SELECT) {
+        if (!versioned) {
+            return 0;
+        }
+
+        // only one child is drawn, so count the largest one
+        const ContainerWidget *selectWidget = GET_WIDGET_PROPERTY(widget, specific, const ContainerWidget *);
+        uint16_t maxNumChildWidgets = 0;
+        for (uint32_t index = 0; index < selectWidget->widgets.count; ++index) {
+            bool childVersioned;
+            uint16_t numChildWidgets = getNumStaticWidgets(GET_WIDGET_LIST_ELEMENT(selectWidget->widgets, index), childVersioned);
+            if (numChildWidgets == 0) {
+                return 0;
+            }
+            if (numChildWidgets > maxNumChildWidgets) {
+                maxNumChildWidgets = numChildWidgets;
+            }
+        }
+        numWidgets += maxNumChildWidgets;
+
+        return numWidgets <= 0xFFFF ? (uint16_t)numWidgets : 0;
+    }
+
+    if (widget->type != WIDGET_TYPE_CONTAINER) {
+        return 0;
+    }
+
+    const ContainerWidget *containerWidget = GET_WIDGET_PROPERTY(widget, specific, const ContainerWidget *);
+    if (containerWidget->overlay != DATA_ID_NONE) {
+        return 0;
+    }
+
+    for (uint32_t index = 0; index < containerWidget->widgets.count; ++index) {
+        bool childVersioned;
+        uint16_t numChildWidgets = getNumStaticWidgets(GET_WIDGET_LIST_ELEMENT(containerWidget->widgets, index), childVersioned);
+        if (numChildWidgets == 0) {
+            return 0;
+        }
+        versioned = versioned || childVersioned;
+        numWidgets += numChildWidgets;
+    }
+
+    return numWidgets <= 0xFFFF ? (uint16_t)numWidgets : 0;
+}
+
+static uint16_t getNumStaticWidgets(const Widget *widget, bool &versioned) {
+    StaticWidgetsCacheEntry &entry = g_staticWidgetsCache[((uintptr_t)widget / sizeof(Widget)) % CONF_GUI_STATIC_WIDGETS_CACHE_SIZE];
+    if (entry.widget != widget) {
+        entry.widget = widget;
+        entry.numWidgets = countStaticWidgets(widget, entry.versioned);
+    }
+    versioned = entry.versioned;
+    return entry.numWidgets;
+}
+
+void resetStaticWidgetsCache() {
+    memset(g_staticWidgetsCache, 0, sizeof(g_staticWidgetsCache));
+    memset(g_versionedWidgetsCache, 0, sizeof(g_versionedWidgetsCache));
+}
+
+// Returns true if data version of versioned widget didn't change since the previous frame.
+// Version is remembered for every visit, so subtree will be skipped in the next frame.
+static bool checkWidgetVersion(const WidgetCursor &widgetCursor) {
+    uint32_t version = getDataVersionHook(widgetCursor.cursor);
+
+    VersionedWidgetsCacheEntry &entry = g_versionedWidgetsCache[
+        ((uintptr_t)widgetCursor.widget / sizeof(Widget) + (uint32_t)(widgetCursor.cursor + 1)) % CONF_GUI_VERSIONED_WIDGETS_CACHE_SIZE];
+
+    bool unchanged =
+        version != 0 &&
+        entry.widget == widgetCursor.widget &&
+        entry.cursor == widgetCursor.cursor &&
+        entry.version == version &&
+        entry.frame + 1 == g_skipWidgetsFrame;
+
+    entry.widget = widgetCursor.widget;
+    entry.cursor = widgetCursor.cursor;
+    entry.version = version;
+    entry.frame = g_skipWidgetsFrame;
+
+    return unchanged;
+}
+
+static bool skipStaticWidget(WidgetCursor &widgetCursor) {
+    if (!g_skipStaticWidgets || !g_staticWidgetsSkipAllowed) {
+        return false;
+    }
+
+    WidgetState *previousState = widgetCursor.previousState;
+    WidgetState *currentState = widgetCursor.currentState;
+    if (!previousState || !currentState || previousState->flags.active != g_isActiveWidget) {
+        return false;
+    }
+
+    bool versioned;
+    uint16_t numWidgets = getNumStaticWidgets(widgetCursor.widget, versioned);
+    if (numWidgets == 0) {
+        return false;
+    }
+
+    if (versioned && !checkWidgetVersion(widgetCursor)) {
+        return false;
+    }
+
+    if (previousState->size < sizeof(WidgetState) || getCurrentStateBufferSize(widgetCursor) + previousState->size > CONF_MAX_STATE_SIZE) {
+        return false;
+    }
+
+    memcpy(currentState, previousState, previousState->size);
+
+    g_updateScreenStatistics.numWidgetsSkipped += numWidgets;
+    if (versioned) {
+        g_updateScreenStatistics.numVersionedWidgetsSkipped += numWidgets;
+    }
+
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void enumWidget(WidgetCursor &widgetCursor, EnumWidgetsCallback callback) {
@@ -154,10 +342,12 @@ void enumWidget(WidgetCursor &widgetCursor, EnumWidgetsCallback callback) {
     bool savedIsActiveWidget = g_isActiveWidget;
     g_isActiveWidget = g_isActiveWidget || isActiveWidget(widgetCursor);
 
-    callback(widgetCursor);
+    if (callback != drawWidgetCallback || !skipStaticWidget(widgetCursor)) {
+        callback(widgetCursor);
 
-    if (*g_enumWidgetFunctions[widgetCursor.widget->type]) {
-       (*g_enumWidgetFunctions[widgetCursor.widget->type])(widgetCursor, callback);
+        if (*g_enumWidgetFunctions[widgetCursor.widget->type]) {
+           (*g_enumWidgetFunctions[widgetCursor.widget->type])(widgetCursor, callback);
+        }
     }
 
     g_isActiveWidget = savedIsActiveWidget;
@@ -301,11 +491,372 @@ WidgetCursor findWidget(AppContext* appContext, int16_t x, int16_t y, bool click
     g_findWidgetAtX = x;
     g_findWidgetAtY = y;
 
-    enumWidgets(appContext, findWidgetStep);
+    findWidgetInHitTestIndex(appContext);
 
     return g_foundWidget;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Hit test index
+//
+// Widgets which can be touched or focused (with action, touch or keyboard
+// handler and app views) are collected, in enumeration order, with one
+// enumeration of the page. Their rectangles (extended to the minimal touch size,
+// as in findWidgetStep) are binned into the grid of cells over the display, so
+// findWidget only runs findWidgetStep for the widgets from the cell under
+// the touch point, and focus lookups visit only the collected widgets.
+//
+// Index is rebuilt after the page is changed or the screen refreshed, and when
+// the position, cursor or visibility of any collected widget (e.g. list is
+// scrolled, select widget shows another child, overlay is moved) changed since
+// the previous frame, which is detected from the layout hash calculated while
+// drawing.
+
+#define CONF_GUI_HIT_TEST_INDEX_MAX_WIDGETS 256
+#define CONF_GUI_HIT_TEST_INDEX_MAX_CELL_ENTRIES 2048
+#define CONF_GUI_HIT_TEST_INDEX_NUM_COLUMNS 16
+#define CONF_GUI_HIT_TEST_INDEX_NUM_ROWS 8
+
+static const int NUM_CELLS = CONF_GUI_HIT_TEST_INDEX_NUM_COLUMNS * CONF_GUI_HIT_TEST_INDEX_NUM_ROWS;
+
+struct HitTestIndexEntry {
+    AppContext *appContext;
+    const Widget *widget;
+    Cursor cursor;
+    int16_t x;
+    int16_t y;
+    uint16_t nestedEnd; // for the app view, index of the first entry after its widgets
+    uint8_t column1;
+    uint8_t column2;
+    uint8_t row1;
+    uint8_t row2;
+};
+
+static HitTestIndexEntry g_hitTestIndexEntries[CONF_GUI_HIT_TEST_INDEX_MAX_WIDGETS];
+static uint16_t g_hitTestIndexNumEntries;
+static uint16_t g_hitTestIndexCellStart[NUM_CELLS + 1];
+static uint16_t g_hitTestIndexCellEntries[CONF_GUI_HIT_TEST_INDEX_MAX_CELL_ENTRIES];
+static AppContext *g_hitTestIndexAppContext;
+static bool g_hitTestIndexValid;
+static bool g_hitTestIndexOverflow;
+
+static uint32_t g_layoutHash;
+static uint32_t g_lastLayoutHash;
+static bool g_isLayoutHashInProgress;
+
+static bool isHitTestIndexWidget(const Widget *widget) {
+    return widget->type == WIDGET_TYPE_APP_VIEW ||
+        widget->action != ACTION_ID_NONE ||
+        *g_onTouchWidgetFunctions[widget->type] ||
+        *g_onKeyboardWidgetFunctions[widget->type];
+}
+
+static inline void hashLayout(uint32_t value) {
+    // FNV-1a
+    g_layoutHash = (g_layoutHash ^ value) * 16777619;
+}
+
+void beginLayoutHash() {
+    g_layoutHash = 2166136261u;
+    g_isLayoutHashInProgress = true;
+}
+
+void hashLayoutWidget(const WidgetCursor &widgetCursor) {
+    const Widget *widget = widgetCursor.widget;
+
+    if (isHitTestIndexWidget(widget)) {
+        hashLayout((uint32_t)(uintptr_t)widgetCursor.appContext);
+        hashLayout((uint32_t)(uintptr_t)widget);
+        hashLayout((uint32_t)widgetCursor.cursor);
+        hashLayout(((uint32_t)(uint16_t)widgetCursor.x << 16) | (uint16_t)widgetCursor.y);
+        hashLayout(((uint32_t)(uint16_t)widget->w << 16) | (uint16_t)widget->h);
+    } else if (isOverlay(widgetCursor)) {
+        Overlay *overlay = getOverlay(widgetCursor);
+        if (overlay) {
+            hashLayout((uint32_t)overlay->state);
+            hashLayout(((uint32_t)(uint16_t)overlay->xOffset << 16) | (uint16_t)overlay->yOffset);
+            hashLayout(((uint32_t)(uint16_t)overlay->width << 16) | (uint16_t)overlay->height);
+        }
+    }
+}
+
+void endLayoutHash() {
+    g_isLayoutHashInProgress = false;
+
+    if (g_layoutHash != g_lastLayoutHash) {
+        g_lastLayoutHash = g_layoutHash;
+        invalidateHitTestIndex();
+    }
+}
+
+void invalidateHitTestIndex() {
+    g_hitTestIndexValid = false;
+}
+
+static void getHitTestIndexCell(int x, int y, int &column, int &row) {
+    const Rect &rect = g_hitTestIndexAppContext->rect;
+
+    column = rect.w > 0 ? (x - rect.x) * CONF_GUI_HIT_TEST_INDEX_NUM_COLUMNS / rect.w : 0;
+    if (column < 0) {
+        column = 0;
+    } else if (column >= CONF_GUI_HIT_TEST_INDEX_NUM_COLUMNS) {
+        column = CONF_GUI_HIT_TEST_INDEX_NUM_COLUMNS - 1;
+    }
+
+    row = rect.h > 0 ? (y - rect.y) * CONF_GUI_HIT_TEST_INDEX_NUM_ROWS / rect.h : 0;
+    if (row < 0) {
+        row = 0;
+    } else if (row >= CONF_GUI_HIT_TEST_INDEX_NUM_ROWS) {
+        row = CONF_GUI_HIT_TEST_INDEX_NUM_ROWS - 1;
+    }
+}
+
+void hitTestIndexStep(const WidgetCursor &widgetCursor) {
+    const Widget *widget = widgetCursor.widget;
+
+    if (!isHitTestIndexWidget(widget)) {
+        return;
+    }
+
+    if (g_hitTestIndexNumEntries == CONF_GUI_HIT_TEST_INDEX_MAX_WIDGETS) {
+        g_hitTestIndexOverflow = true;
+        return;
+    }
+
+    HitTestIndexEntry &entry = g_hitTestIndexEntries[g_hitTestIndexNumEntries++];
+
+    entry.appContext = widgetCursor.appContext;
+    entry.widget = widget;
+    entry.cursor = widgetCursor.cursor;
+    entry.x = widgetCursor.x;
+    entry.y = widgetCursor.y;
+    entry.nestedEnd = 0;
+
+    int column1;
+    int row1;
+    int column2;
+    int row2;
+
+    if (widget->type == WIDGET_TYPE_APP_VIEW) {
+        // app view widgets are enumerated even if outside of the app view
+        column1 = 0;
+        row1 = 0;
+        column2 = CONF_GUI_HIT_TEST_INDEX_NUM_COLUMNS - 1;
+        row2 = CONF_GUI_HIT_TEST_INDEX_NUM_ROWS - 1;
+    } else {
+        // same extended rectangle as in findWidgetStep
+        Overlay *overlay = getOverlay(widgetCursor);
+
+        static const int MIN_SIZE = 50;
+
+        int x = widgetCursor.x;
+        int w = overlay ? overlay->width : widget->w;
+        if (w < MIN_SIZE) {
+            x = x - (MIN_SIZE - w) / 2;
+            w = MIN_SIZE;
+        }
+
+        int y = widgetCursor.y;
+        int h = overlay ? overlay->height : widget->h;
+        if (h < MIN_SIZE) {
+            y = y - (MIN_SIZE - h) / 2;
+            h = MIN_SIZE;
+        }
+
+        getHitTestIndexCell(x, y, column1, row1);
+        getHitTestIndexCell(x + w - 1, y + h - 1, column2, row2);
+    }
+
+    entry.column1 = (uint8_t)column1;
+    entry.row1 = (uint8_t)row1;
+    entry.column2 = (uint8_t)column2;
+    entry.row2 = (uint8_t)row2;
+}
+
+static void buildHitTestIndex(AppContext *appContext) {
+    g_hitTestIndexAppContext = appContext;
+    g_hitTestIndexNumEntries = 0;
+    g_hitTestIndexOverflow = false;
+    g_hitTestIndexValid = true;
+
+    enumWidgets(appContext, hitTestIndexStep);
+
+    if (g_hitTestIndexOverflow) {
+        return;
+    }
+
+    // widgets of the app view are enumerated right after the app view widget,
+    // until the widget from the same app context as app view is reached
+    for (uint16_t i = 0; i < g_hitTestIndexNumEntries; i++) {
+        HitTestIndexEntry &entry = g_hitTestIndexEntries[i];
+        if (entry.widget->type == WIDGET_TYPE_APP_VIEW) {
+            uint16_t j = i + 1;
+            while (j < g_hitTestIndexNumEntries && g_hitTestIndexEntries[j].appContext != entry.appContext) {
+                j++;
+            }
+            entry.nestedEnd = j;
+        }
+    }
+
+    // count cell entries ...
+    memset(g_hitTestIndexCellStart, 0, sizeof(g_hitTestIndexCellStart));
+    for (uint16_t i = 0; i < g_hitTestIndexNumEntries; i++) {
+        const HitTestIndexEntry &entry = g_hitTestIndexEntries[i];
+        for (int row = entry.row1; row <= entry.row2; row++) {
+            for (int column = entry.column1; column <= entry.column2; column++) {
+                g_hitTestIndexCellStart[row * CONF_GUI_HIT_TEST_INDEX_NUM_COLUMNS + column + 1]++;
+            }
+        }
+    }
+
+    for (int cell = 0; cell < NUM_CELLS; cell++) {
+        g_hitTestIndexCellStart[cell + 1] += g_hitTestIndexCellStart[cell];
+    }
+
+    if (g_hitTestIndexCellStart[NUM_CELLS] > CONF_GUI_HIT_TEST_INDEX_MAX_CELL_ENTRIES) {
+        g_hitTestIndexOverflow = true;
+        return;
+    }
+
+    // ... and fill them, every cell keeps the enumeration order
+    uint16_t cellEnd[NUM_CELLS];
+    memcpy(cellEnd, g_hitTestIndexCellStart, sizeof(cellEnd));
+    for (uint16_t i = 0; i < g_hitTestIndexNumEntries; i++) {
+        const HitTestIndexEntry &entry = g_hitTestIndexEntries[i];
+        for (int row = entry.row1; row <= entry.row2; row++) {
+            for (int column = entry.column1; column <= entry.column2; column++) {
+                g_hitTestIndexCellEntries[cellEnd[row * CONF_GUI_HIT_TEST_INDEX_NUM_COLUMNS + column]++] = i;
+            }
+        }
+    }
+}
+
+static bool useHitTestIndex(AppContext *appContext) {
+#if OPTION_GUI_THREAD
+    // index is not thread safe, other threads enumerate the widgets directly
+    if (osThreadGetId() != g_guiTaskHandle) {
+        return false;
+    }
+#endif
+
+    // layout hash is not calculated while display is off
+    if (!mcu::display::isOn()) {
+        return false;
+    }
+
+    // while drawing, active page is the page being drawn (see AppContext::getActivePageStackPointer)
+    if (g_isLayoutHashInProgress) {
+        return false;
+    }
+
+    if (!g_hitTestIndexValid || g_hitTestIndexAppContext != appContext) {
+        buildHitTestIndex(appContext);
+    }
+
+    return !g_hitTestIndexOverflow;
+}
+
+static WidgetCursor getHitTestIndexWidgetCursor(const HitTestIndexEntry &entry) {
+    WidgetCursor widgetCursor;
+    widgetCursor.appContext = entry.appContext;
+    widgetCursor.widget = entry.widget;
+    widgetCursor.x = entry.x;
+    widgetCursor.y = entry.y;
+    widgetCursor.cursor = entry.cursor;
+    return widgetCursor;
+}
+
+static AppContext *getAppViewAppContext(const WidgetCursor &widgetCursor) {
+    Value appContextValue;
+    DATA_OPERATION_FUNCTION(widgetCursor.widget->data, DATA_OPERATION_GET, widgetCursor.cursor, appContextValue);
+    return appContextValue.getAppContext();
+}
+
+static void findWidgetInHitTestIndex(AppContext *appContext) {
+    if (!useHitTestIndex(appContext)) {
+        enumWidgets(appContext, findWidgetStep);
+        return;
+    }
+
+    if (appContext->getActivePageId() == PAGE_ID_NONE || appContext->isActivePageInternal()) {
+        return;
+    }
+
+    int column;
+    int row;
+    getHitTestIndexCell(g_findWidgetAtX, g_findWidgetAtY, column, row);
+    int cell = row * CONF_GUI_HIT_TEST_INDEX_NUM_COLUMNS + column;
+
+    uint16_t skipUntil = 0;
+
+    for (uint16_t i = g_hitTestIndexCellStart[cell]; i < g_hitTestIndexCellStart[cell + 1]; i++) {
+        uint16_t entryIndex = g_hitTestIndexCellEntries[i];
+        if (entryIndex < skipUntil) {
+            continue;
+        }
+
+        const HitTestIndexEntry &entry = g_hitTestIndexEntries[entryIndex];
+        WidgetCursor widgetCursor = getHitTestIndexWidgetCursor(entry);
+
+        findWidgetStep(widgetCursor);
+
+        if (entry.widget->type == WIDGET_TYPE_APP_VIEW) {
+            AppContext *appViewAppContext = getAppViewAppContext(widgetCursor);
+            if (appViewAppContext->isActivePageInternal()) {
+                // internal page can't be indexed, let it find the widget
+                widgetCursor.appContext = appViewAppContext;
+                enumWidgets(widgetCursor, findWidgetStep);
+                skipUntil = entry.nestedEnd;
+            }
+        }
+    }
+}
+
+static void enumHitTestIndex(uint16_t begin, uint16_t end, EnumWidgetsCallback callback) {
+    for (uint16_t i = begin; i < end; i++) {
+        const HitTestIndexEntry &entry = g_hitTestIndexEntries[i];
+        WidgetCursor widgetCursor = getHitTestIndexWidgetCursor(entry);
+
+        callback(widgetCursor);
+
+        if (entry.widget->type == WIDGET_TYPE_APP_VIEW) {
+            if (getAppViewAppContext(widgetCursor)->isActivePageInternal()) {
+                // enumWidgets doesn't enter internal pages
+                i = entry.nestedEnd - 1;
+            }
+        }
+    }
+}
+
+void enumInteractiveWidgets(AppContext *appContext, EnumWidgetsCallback callback) {
+    AppContext *rootAppContext = &getRootAppContext();
+
+    if (!useHitTestIndex(rootAppContext)) {
+        enumWidgets(appContext, callback);
+        return;
+    }
+
+    if (appContext->getActivePageId() == PAGE_ID_NONE || appContext->isActivePageInternal()) {
+        return;
+    }
+
+    if (appContext == rootAppContext) {
+        enumHitTestIndex(0, g_hitTestIndexNumEntries, callback);
+        return;
+    }
+
+    // find the app view with this app context
+    for (uint16_t i = 0; i < g_hitTestIndexNumEntries; i++) {
+        const HitTestIndexEntry &entry = g_hitTestIndexEntries[i];
+        if (entry.widget->type == WIDGET_TYPE_APP_VIEW && entry.nestedEnd > i + 1 && g_hitTestIndexEntries[i + 1].appContext == appContext) {
+            enumHitTestIndex(i + 1, entry.nestedEnd, callback);
+            return;
+        }
+    }
+
+    enumWidgets(appContext, callback);
+}
+
 } // namespace gui
 } // namespace eez
 
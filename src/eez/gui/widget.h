@@ -291,6 +291,16 @@ void enumWidgets(WidgetCursor &widgetCursor, EnumWidgetsCallback callback);
 void findWidgetStep(const WidgetCursor &widgetCursor);
 WidgetCursor findWidget(AppContext* appContext, int16_t x, int16_t y, bool clicked = true);
 
+void hitTestIndexStep(const WidgetCursor &widgetCursor);
+void invalidateHitTestIndex();
+void beginLayoutHash();
+void hashLayoutWidget(const WidgetCursor &widgetCursor);
+void endLayoutHash();
+
+// Same as enumWidgets, but only widgets with action, touch or keyboard handler
+// and app views are enumerated.
+void enumInteractiveWidgets(AppContext *appContext, EnumWidgetsCallback callback);
+
 extern OnTouchFunctionType *g_onTouchWidgetFunctions[];
 extern OnKeyboardFunctionType *g_onKeyboardWidgetFunctions[];
 
@@ -300,9 +310,20 @@ void enumWidget(WidgetCursor &widgetCursor, EnumWidgetsCallback callback);
 extern bool g_isActiveWidget;
 void drawWidgetCallback(const WidgetCursor &widgetCursor);
 
+extern bool g_skipStaticWidgets;
+extern bool g_staticWidgetsSkipAllowed;
+extern uint32_t g_skipWidgetsFrame;
+void resetStaticWidgetsCache();
+
 OnTouchFunctionType getWidgetTouchFunction(const WidgetCursor &widgetCursor);
 
 uint16_t overrideStyleHook(const WidgetCursor &widgetCursor, uint16_t styleId);
+
+// Data for which application maintains a change counter, returned by getDataVersionHook.
+bool isVersionedDataHook(int16_t dataId);
+// Must change whenever anything that versioned data widgets draw for the cursor could change
+// (value, color, blinking, focus, ...). Returns 0 if it is not known, then nothing is skipped.
+uint32_t getDataVersionHook(Cursor cursor);
 uint16_t overrideStyleColorHook(const WidgetCursor &widgetCursor, const Style *style);
 uint16_t overrideActiveStyleColorHook(const WidgetCursor &widgetCursor, const Style *style);
 
@@ -29,10 +29,56 @@
 using namespace eez::mcu;
 
 #define CONF_GUI_YT_GRAPH_BLANK_PIXELS_AFTER_CURSOR 10
+#define CONF_GUI_YT_GRAPH_NUM_COLUMNS_PER_CHUNK 64
 
 namespace eez {
 namespace gui {
 
+// Graph is drawn in chunks of columns: values for the whole chunk are fetched at once,
+// then vertical spans are calculated and drawn with a single display::drawVLines call per value.
+// Only GUI thread draws widgets, so these buffers can be shared by all the graphs.
+static float g_values[2][CONF_GUI_YT_GRAPH_NUM_COLUMNS_PER_CHUNK + 1];
+static int g_y[2][CONF_GUI_YT_GRAPH_NUM_COLUMNS_PER_CHUNK + 1];
+static int16_t g_yFrom[2][CONF_GUI_YT_GRAPH_NUM_COLUMNS_PER_CHUNK];
+static int16_t g_yTo[2][CONF_GUI_YT_GRAPH_NUM_COLUMNS_PER_CHUNK];
+
+// Fills min (and max if not nullptr) for numRows rows starting from position.
+// Rows at or after numPositions are set to NaN without calling data getter.
+static void getValues(
+    Value::YtDataGetValueFunctionPointer ytDataGetValue, Value::YtDataGetValuesFunctionPointer ytDataGetValues,
+    uint32_t numPositions, uint32_t position, uint32_t numRows, uint8_t valueIndex, float *min, float *max
+) {
+    uint32_t i = 0;
+    while (i < numRows) {
+        uint32_t rowIndex = position + i;
+
+        if (rowIndex >= numPositions) {
+            min[i] = NAN;
+            if (max) {
+                max[i] = NAN;
+            }
+            i++;
+            continue;
+        }
+
+        uint32_t n = MIN(numRows - i, numPositions - rowIndex);
+
+        if (ytDataGetValues) {
+            ytDataGetValues(rowIndex, n, valueIndex, min + i, max ? max + i : nullptr);
+        } else {
+            float fMax;
+            for (uint32_t j = 0; j < n; j++) {
+                min[i + j] = ytDataGetValue(rowIndex + j, valueIndex, &fMax);
+                if (max) {
+                    max[i + j] = fMax;
+                }
+            }
+        }
+
+        i += n;
+    }
+}
+
 struct YTGraphWidgetState {
     WidgetState genericState;
     uint32_t refreshCounter;
@@ -67,10 +113,8 @@ struct YTGraphDrawHelper {
 
     int x;
 
-    int yPrev[2];
-    int y[2];
-
     Value::YtDataGetValueFunctionPointer ytDataGetValue;
+    Value::YtDataGetValuesFunctionPointer ytDataGetValues;
 
     YTGraphDrawHelper(const WidgetCursor &widgetCursor_) : widgetCursor(widgetCursor_), widget(widgetCursor.widget) {
         min[0] = ytDataGetMin(widgetCursor.cursor, widget->data, 0).getFloat();
@@ -85,15 +129,10 @@ struct YTGraphDrawHelper {
         dataColor16[1] = display::getColor16FromIndex(y2Style->color);
 
         ytDataGetValue = ytDataGetGetValueFunc(widgetCursor.cursor, widget->data);
+        ytDataGetValues = ytDataGetGetValuesFunc(widgetCursor.cursor, widget->data);
     }
 
-    int getYValue(int valueIndex, uint32_t position) {
-        if (position >= numPositions) {
-            return INT_MIN;
-        }
-
-        float value = ytDataGetValue(position, valueIndex, nullptr);
-
+    int getYValue(int valueIndex, float value) {
         if (isNaN(value)) {
             return INT_MIN;
         }
@@ -107,31 +146,63 @@ struct YTGraphDrawHelper {
         return widget->h - 1 - y;
     }
 
-    void drawValue(int valueIndex) {
-        if (y[valueIndex] == INT_MIN) {
-            return;
+    static bool isFlat(int yPrev, int y) {
+        return yPrev != INT_MIN && abs(yPrev - y) <= 1;
+    }
+
+    static void getSpan(int yPrev, int y, int16_t &yFrom, int16_t &yTo) {
+        if (y == INT_MIN) {
+            // nothing to draw
+            yFrom = 1;
+            yTo = 0;
+        } else if (yPrev == INT_MIN || abs(yPrev - y) <= 1) {
+            yFrom = yTo = y;
+        } else if (yPrev < y) {
+            yFrom = yPrev + 1;
+            yTo = y;
+        } else {
+            yFrom = y;
+            yTo = yPrev - 1;
         }
+    }
 
-        display::setColor16(dataColor16[valueIndex]);
+    // draws numColumns columns starting at x for the positions starting at position
+    void drawColumns(int x, uint32_t position, uint32_t numColumns) {
+        for (int valueIndex = 0; valueIndex < 2; valueIndex++) {
+            float *values = g_values[valueIndex];
+            int *y = g_y[valueIndex];
 
-        if (yPrev[valueIndex] == INT_MIN || abs(yPrev[valueIndex] - y[valueIndex]) <= 1) {
-            display::drawPixel(x, widgetCursor.y + y[valueIndex]);
-        } else {
-            if (yPrev[valueIndex] < y[valueIndex]) {
-                display::drawVLine(x, widgetCursor.y + yPrev[valueIndex] + 1, y[valueIndex] - yPrev[valueIndex] - 1);
+            // y[0] is for the previous position, for the position 0 previous position is 0
+            if (position > 0) {
+                getValues(ytDataGetValue, ytDataGetValues, numPositions, position - 1, numColumns + 1, valueIndex, values, nullptr);
             } else {
-                display::drawVLine(x, widgetCursor.y + y[valueIndex], yPrev[valueIndex] - y[valueIndex] - 1);
+                getValues(ytDataGetValue, ytDataGetValues, numPositions, position, numColumns, valueIndex, values + 1, nullptr);
+                values[0] = values[1];
+            }
+
+            for (uint32_t i = 0; i <= numColumns; i++) {
+                y[i] = getYValue(valueIndex, values[i]);
+            }
+
+            for (uint32_t i = 0; i < numColumns; i++) {
+                getSpan(y[i], y[i + 1], g_yFrom[valueIndex][i], g_yTo[valueIndex][i]);
             }
         }
-    }
 
-    void drawStep() {
-        if (y[0] != INT_MIN && y[1] != INT_MIN && abs(yPrev[0] - y[0]) <= 1 && abs(yPrev[1] - y[1]) <= 1 && y[0] == y[1]) {
-            display::setColor16(position % 2 ? dataColor16[1] : dataColor16[0]);
-            display::drawPixel(x, widgetCursor.y + y[0]);
-        } else {
-            drawValue(0);
-            drawValue(1);
+        // if both values are at the same pixel, alternate colors
+        for (uint32_t i = 0; i < numColumns; i++) {
+            int y0 = g_y[0][i + 1];
+            int y1 = g_y[1][i + 1];
+            if (y0 != INT_MIN && y0 == y1 && isFlat(g_y[0][i], y0) && isFlat(g_y[1][i], y1)) {
+                int hiddenValueIndex = (position + i) % 2 ? 0 : 1;
+                g_yFrom[hiddenValueIndex][i] = 1;
+                g_yTo[hiddenValueIndex][i] = 0;
+            }
+        }
+
+        for (int valueIndex = 0; valueIndex < 2; valueIndex++) {
+            display::setColor16(dataColor16[valueIndex]);
+            display::drawVLines(x, widgetCursor.y, numColumns, g_yFrom[valueIndex], g_yTo[valueIndex]);
         }
     }
 
@@ -148,16 +219,16 @@ struct YTGraphDrawHelper {
             display::fillRect(widgetCursor.x, widgetCursor.y, x2, widgetCursor.y + widget->h - 1);
         }
 
-        for (position = startPosition; position < endPosition; ++position) {
-            x = widgetCursor.x + position % graphWidth;
+        for (position = startPosition; position < endPosition; ) {
+            uint32_t column = position % graphWidth;
 
-            y[0] = getYValue(0, position);
-            yPrev[0] = getYValue(0, position == 0 ? position : position - 1);
+            // chunk doesn't wrap around the right edge
+            uint32_t numColumns = MIN(endPosition - position, CONF_GUI_YT_GRAPH_NUM_COLUMNS_PER_CHUNK);
+            numColumns = MIN(numColumns, graphWidth - column);
 
-            y[1] = getYValue(1, position);
-            yPrev[1] = getYValue(1, position == 0 ? position : position - 1);
+            drawColumns(widgetCursor.x + column, position, numColumns);
 
-            drawStep();
+            position += numColumns;
         }
     }
 
@@ -184,20 +255,16 @@ struct YTGraphDrawHelper {
 
         numPositions = position + numPointsToDraw;
 
-        yPrev[0] = getYValue(0, previousHistoryValuePosition);
-        yPrev[1] = getYValue(1, previousHistoryValuePosition);
-
         display::setColor16(color16);
         display::fillRect(startX, widgetCursor.y, endX - 1, widgetCursor.y + widget->h - 1);
 
-        for (x = startX; x < endX; x++, position++) {
-            y[0] = getYValue(0, position);
-            y[1] = getYValue(1, position);
+        for (x = startX; x < endX; ) {
+            uint32_t numColumns = MIN((uint32_t)(endX - x), CONF_GUI_YT_GRAPH_NUM_COLUMNS_PER_CHUNK);
 
-            drawStep();
+            drawColumns(x, position, numColumns);
 
-            yPrev[0] = y[0];
-            yPrev[1] = y[1];
+            x += numColumns;
+            position += numColumns;
         }
     }
 };
@@ -230,43 +297,39 @@ struct YTGraphStaticDrawHelper {
     uint32_t cursorPosition;
 
     Value::YtDataGetValueFunctionPointer ytDataGetValue;
+    Value::YtDataGetValuesFunctionPointer ytDataGetValues;
 
     int xLabels[MAX_NUM_OF_Y_VALUES];
     int yLabels[MAX_NUM_OF_Y_VALUES];
 
     YTGraphStaticDrawHelper(const WidgetCursor &widgetCursor_) : widgetCursor(widgetCursor_), widget(widgetCursor.widget) {
         ytDataGetValue = ytDataGetGetValueFunc(widgetCursor.cursor, widget->data);
+        ytDataGetValues = ytDataGetGetValuesFunc(widgetCursor.cursor, widget->data);
     }
 
-    void getYValue(uint32_t position, int &min, int &max) {
-        if (position >= numPositions) {
+    void getYValue(float fMin, float fMax, int &min, int &max) {
+        if (isNaN(fMin)) {
             max = INT_MIN;
-            min = INT_MIN;
         } else {
-            float fMax;
-            float fMin = ytDataGetValue(position, m_valueIndex, &fMax);
-
-            if (isNaN(fMin)) {
-                max = INT_MIN;
-            } else {
-                max = widget->h - 1 - (int)floor(widget->h / 2.0f + (fMin + offset) * scale);
-            }
+            max = widget->h - 1 - (int)floor(widget->h / 2.0f + (fMin + offset) * scale);
+        }
 
-            if (isNaN(fMax)) {
-                min = INT_MIN;
-            } else {
-                min = widget->h - 1 - (int)floor(widget->h / 2.0f + (fMax + offset) * scale);
-            }
+        if (isNaN(fMax)) {
+            min = INT_MIN;
+        } else {
+            min = widget->h - 1 - (int)floor(widget->h / 2.0f + (fMax + offset) * scale);
         }
     }
 
-    void drawValue() {
+    void getSpan(int16_t &spanFrom, int16_t &spanTo) {
+        // nothing to draw
+        spanFrom = 1;
+        spanTo = 0;
+
         if (yMin == INT_MIN) {
             return;
         }
 
-        display::setColor16(dataColor16);
-
         int yFrom;
         int yTo;
 
@@ -286,7 +349,7 @@ struct YTGraphStaticDrawHelper {
             }
         }
 
-        if ((yFrom < 0 && yTo < 0) || (yFrom >= widget->h && yTo >= widget->h)) {
+        if (yFrom > yTo || (yFrom < 0 && yTo < 0) || (yFrom >= widget->h && yTo >= widget->h)) {
             return;
         }
 
@@ -298,11 +361,8 @@ struct YTGraphStaticDrawHelper {
             yTo = widget->h - 1;
         }
 
-        if (yFrom == yTo) {
-            display::drawPixel(x, widgetCursor.y + yFrom);
-        } else {
-            display::drawVLine(x, widgetCursor.y + yFrom, yTo - yFrom);
-        }
+        spanFrom = yFrom;
+        spanTo = yTo;
     }
 
     void getMinMax(int *yLabels, int n, int &yMin, int &yMax) {
@@ -346,18 +406,34 @@ struct YTGraphStaticDrawHelper {
             const Style* style = ytDataGetStyle(widgetCursor.cursor, widget->data, m_valueIndex);
             dataColor16 = display::getColor16FromIndex(style->color);
 
-            getYValue(position > 0 ? position - 1 : 0, yPrevMin, yPrevMax);
+            float *fMin = g_values[0];
+            float *fMax = g_values[1];
+
+            getValues(ytDataGetValue, ytDataGetValues, numPositions, position > 0 ? position - 1 : 0, 1, m_valueIndex, fMin, fMax);
+            getYValue(fMin[0], fMax[0], yPrevMin, yPrevMax);
+
+            for (x = startX; x < endX; ) {
+                uint32_t numColumns = MIN((uint32_t)(endX - x), CONF_GUI_YT_GRAPH_NUM_COLUMNS_PER_CHUNK);
 
-            for (x = startX; x < endX; x++, position++) {
-                getYValue(position, yMin, yMax);
-                drawValue();
-                yPrevMin = yMin;
-                yPrevMax = yMax;
+                getValues(ytDataGetValue, ytDataGetValues, numPositions, position, numColumns, m_valueIndex, fMin, fMax);
 
-                if (yMin != INT_MIN) {
-                    xLabels[m_valueIndex] = x;
-                    yLabels[m_valueIndex] = widgetCursor.y + yMin;
+                for (uint32_t i = 0; i < numColumns; i++) {
+                    getYValue(fMin[i], fMax[i], yMin, yMax);
+                    getSpan(g_yFrom[0][i], g_yTo[0][i]);
+                    yPrevMin = yMin;
+                    yPrevMax = yMax;
+
+                    if (yMin != INT_MIN) {
+                        xLabels[m_valueIndex] = x + i;
+                        yLabels[m_valueIndex] = widgetCursor.y + yMin;
+                    }
                 }
+
+                display::setColor16(dataColor16);
+                display::drawVLines(x, widgetCursor.y, numColumns, g_yFrom[0], g_yTo[0]);
+
+                x += numColumns;
+                position += numColumns;
             }
         }
     }
@@ -236,7 +236,7 @@ static void moveToNextFocusCursor() {
     g_findFocusCursorState = 0;
     g_focusWidgetCursorIter = 0;
     
-    enumWidgets(&getRootAppContext(), findNextFocusCursor);
+    enumInteractiveWidgets(&getRootAppContext(), findNextFocusCursor);
     
     if (g_findFocusCursorState > 0) {
         g_focusWidgetCursor = g_focusWidgetCursorIter;
@@ -264,7 +264,7 @@ static void moveToPreviousFocusCursor() {
     g_findFocusCursorState = 0;
     g_focusWidgetCursorIter = 0;
     
-    enumWidgets(&getRootAppContext(), findPreviousFocusCursor);
+    enumInteractiveWidgets(&getRootAppContext(), findPreviousFocusCursor);
     
     if (g_findFocusCursorState > 0) {
         g_focusWidgetCursor = g_focusWidgetCursorIter;
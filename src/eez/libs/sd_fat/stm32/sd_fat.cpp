@@ -205,7 +205,9 @@ int File::read() {
 }
 
 size_t File::read(void *buf, uint32_t size) {
-    static const uint32_t CHUNK_SIZE = 512;
+    // multiple of the sector size, so FatFs can read whole sectors
+    // directly into the (aligned) buffer with a single multi-block transfer
+    static const uint32_t CHUNK_SIZE = 32 * 512;
 
     UINT brTotal = 0;
 
@@ -252,7 +254,8 @@ size_t File::read(void *buf, uint32_t size) {
 }
 
 size_t File::write(const void *buf, size_t size) {
-	static const uint32_t CHUNK_SIZE = 512;
+    // multiple of the sector size, see File::read
+	static const uint32_t CHUNK_SIZE = 32 * 512;
 
     UINT bwTotal = 0;
 
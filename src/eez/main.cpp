@@ -18,6 +18,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 #if defined(EEZ_PLATFORM_STM32)
 #include <main.h>
@@ -46,6 +47,9 @@
 #include <eez/tasks.h>
 
 #include <eez/modules/mcu/encoder.h>
+#if defined(EEZ_PLATFORM_SIMULATOR) && OPTION_DISPLAY
+#include <eez/modules/mcu/display.h>
+#endif
 
 #include <eez/modules/psu/psu.h>
 #include <eez/modules/psu/serial_psu.h>
@@ -93,6 +97,14 @@ int main(int argc, char **argv) {
     startEmscripten();
 #else
 
+#if defined(EEZ_PLATFORM_SIMULATOR) && OPTION_DISPLAY
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            eez::mcu::display::setHeadless(true);
+        }
+    }
+#endif
+
 #if defined(EEZ_PLATFORM_STM32)
 	if (RCC->CSR & RCC_CSR_IWDGRSTF) {	
 		/* Reset by IWDG */
@@ -42,7 +42,13 @@ static const uint32_t DECOMPRESSED_ASSETS_SIZE = 8 * 1024 * 1024;
 static uint8_t * const DLOG_RECORD_BUFFER = DECOMPRESSED_ASSETS_START_ADDRESS + DECOMPRESSED_ASSETS_SIZE;
 static const uint32_t DLOG_RECORD_BUFFER_SIZE = 128 * 1024;
 
-static uint8_t * const FILE_VIEW_BUFFER = DLOG_RECORD_BUFFER + DLOG_RECORD_BUFFER_SIZE;
+static uint8_t * const DLOG_PYRAMID_BUFFER = DLOG_RECORD_BUFFER + DLOG_RECORD_BUFFER_SIZE;
+static const uint32_t DLOG_PYRAMID_BUFFER_SIZE = 64 * 1024;
+
+static uint8_t * const DLOG_DECODE_BUFFER = DLOG_PYRAMID_BUFFER + DLOG_PYRAMID_BUFFER_SIZE;
+static const uint32_t DLOG_DECODE_BUFFER_SIZE = 16 * 1024;
+
+static uint8_t * const FILE_VIEW_BUFFER = DLOG_DECODE_BUFFER + DLOG_DECODE_BUFFER_SIZE;
 #if defined(EEZ_PLATFORM_STM32)
 static const uint32_t FILE_VIEW_BUFFER_SIZE = 1024 * 1024;
 #endif
@@ -59,7 +65,14 @@ static const uint32_t SOUND_TUNES_MEMORY_SIZE = 32 * 1024;
 static uint8_t * const FILE_MANAGER_MEMORY = SOUND_TUNES_MEMORY + SOUND_TUNES_MEMORY_SIZE;
 static const uint32_t FILE_MANAGER_MEMORY_SIZE = 512 * 1024;
 
-static uint8_t * const VRAM_SCREENSHOOT_JPEG_OUT_BUFFER = FILE_MANAGER_MEMORY + FILE_MANAGER_MEMORY_SIZE;
+static uint8_t * const FILE_TRANSFER_BUFFER = FILE_MANAGER_MEMORY + FILE_MANAGER_MEMORY_SIZE;
+static const uint32_t FILE_TRANSFER_BUFFER_SIZE = 64 * 1024;
+
+// scratch memory for DEBUg benchmarks
+static uint8_t * const BENCHMARK_BUFFER = FILE_TRANSFER_BUFFER + FILE_TRANSFER_BUFFER_SIZE;
+static const uint32_t BENCHMARK_BUFFER_SIZE = 32 * 1024;
+
+static uint8_t * const VRAM_SCREENSHOOT_JPEG_OUT_BUFFER = BENCHMARK_BUFFER + BENCHMARK_BUFFER_SIZE;
 static const uint32_t VRAM_SCREENSHOOT_JPEG_OUT_BUFFER_SIZE = 256 * 1024;
 
 static uint8_t * const SCREENSHOOT_BUFFER_START_ADDRESS = VRAM_SCREENSHOOT_JPEG_OUT_BUFFER + VRAM_SCREENSHOOT_JPEG_OUT_BUFFER_SIZE;
@@ -27,6 +27,7 @@
 #include <eez/debug.h>
 #include <eez/index.h>
 #include <eez/system.h>
+#include <eez/util.h>
 
 #include <eez/modules/bp3c/comm.h>
 
@@ -174,7 +175,7 @@ TransferResult transfer(int slotIndex, uint8_t *output, uint8_t *input, uint32_t
         }
     } else {
         if (result == HAL_OK) {
-            uint32_t crc = HAL_CRC_Calculate(&hcrc, (uint32_t *)input, bufferSize - 4);
+            uint32_t crc = crc32(input, bufferSize - 4);
             return crc == *((uint32_t *)(input + bufferSize - 4)) ? TRANSFER_STATUS_OK : TRANSFER_STATUS_CRC_ERROR;
         } else {
             return (TransferResult)result;
@@ -21,6 +21,7 @@
 
 #if OPTION_DISPLAY
 
+#include <eez/system.h>
 #include <eez/util.h>
 #include <eez/keyboard.h>
 #include <eez/mouse.h>
@@ -46,6 +47,14 @@ gui::font::Font g_font;
 
 static uint8_t g_colorCache[256][4];
 
+#define CONF_MAX_NUM_PALETTE_COLORS 512
+
+// Theme colors followed by the global colors, with the background luminosity adjustment
+// already applied, so setColor/setBackColor by color index is just a table lookup.
+// Rebuilt in onThemeChanged and onLuminocityChanged.
+static uint16_t g_palette[CONF_MAX_NUM_PALETTE_COLORS];
+static uint32_t g_paletteCount;
+
 #define FLOAT_TO_COLOR_COMPONENT(F) ((F) < 0 ? 0 : (F) > 255 ? 255 : (uint8_t)(F))
 #define RGB_TO_HIGH_BYTE(R, G, B) (((R) & 248) | (G) >> 5)
 #define RGB_TO_LOW_BYTE(R, G, B) (((G) & 28) << 3 | (B) >> 3)
@@ -93,11 +102,39 @@ uint32_t blendColor(uint32_t fgColor, uint32_t bgColor) {
     return result;
 }
 
+static uint16_t computeAdjustedColor(uint16_t c, uint8_t luminosityStep);
+
+static uint32_t getNumPaletteColors() {
+    uint32_t numColors = g_themeColorsCount + getColorsCount();
+    // colors that doesn't fit are adjusted when used
+    return numColors < CONF_MAX_NUM_PALETTE_COLORS ? numColors : CONF_MAX_NUM_PALETTE_COLORS;
+}
+
+static void buildPalette(uint16_t *palette, uint32_t numColors, uint8_t luminosityStep) {
+    for (uint32_t i = 0; i < numColors; i++) {
+        uint16_t c = i < g_themeColorsCount ? g_themeColors[i] : g_colors[i - g_themeColorsCount];
+        palette[i] = luminosityStep == DISPLAY_BACKGROUND_LUMINOSITY_STEP_DEFAULT ? c : computeAdjustedColor(c, luminosityStep);
+    }
+}
+
+static void rebuildPalette() {
+    if (!g_themeColors) {
+        return;
+    }
+
+    g_paletteCount = 0;
+    uint32_t numColors = getNumPaletteColors();
+    buildPalette(g_palette, numColors, psu::persist_conf::devConf.displayBackgroundLuminosityStep);
+    g_paletteCount = numColors;
+}
+
 void onThemeChanged() {
 	if (g_assetsLoaded) {
 		g_themeColors = getThemeColors(psu::persist_conf::devConf.selectedThemeIndex);
 		g_themeColorsCount = getThemeColorsCount(psu::persist_conf::devConf.selectedThemeIndex);
 		g_colors = getColors();
+
+        rebuildPalette();
 	}
 }
 
@@ -109,6 +146,8 @@ void onLuminocityChanged() {
         g_colorCache[i][2] = 0;
         g_colorCache[i][3] = 0;
     }
+
+    rebuildPalette();
 }
 
 #define swap(type, i, j) {type t = i; i = j; j = t;}
@@ -178,21 +217,10 @@ void hslToRgb(float h, float s, float l, float &r, float &g, float &b) {
     b *= 255;
 }
 
-void adjustColor(uint16_t &c) {
-    if (psu::persist_conf::devConf.displayBackgroundLuminosityStep == DISPLAY_BACKGROUND_LUMINOSITY_STEP_DEFAULT) {
-        return;
-    }
-
+static uint16_t computeAdjustedColor(uint16_t c, uint8_t luminosityStep) {
 	uint8_t ch = c >> 8;
 	uint8_t cl = c & 0xFF;
 
-    int i = (ch & 0xF0) | (cl & 0x0F);
-    if (ch == g_colorCache[i][0] && cl == g_colorCache[i][1]) {
-        // cache hit!
-		c = (g_colorCache[i][2] << 8) | g_colorCache[i][3];
-        return;
-    }
-
     uint8_t r, g, b;
     r = ch & 248;
     g = ((ch << 5) | (cl >> 3)) & 252;
@@ -208,7 +236,7 @@ void adjustColor(uint16_t &c) {
     float lmin = l - a;
     float lmax = l + a;
 
-    float lNew = remap((float)psu::persist_conf::devConf.displayBackgroundLuminosityStep,
+    float lNew = remap((float)luminosityStep,
         (float)DISPLAY_BACKGROUND_LUMINOSITY_STEP_MIN,
         lmin,
         (float)DISPLAY_BACKGROUND_LUMINOSITY_STEP_MAX,
@@ -224,13 +252,35 @@ void adjustColor(uint16_t &c) {
     uint8_t chNew = RGB_TO_HIGH_BYTE(r, g, b);
     uint8_t clNew = RGB_TO_LOW_BYTE(r, g, b);
 
+	return (chNew << 8) | clNew;
+}
+
+void adjustColor(uint16_t &c) {
+    if (psu::persist_conf::devConf.displayBackgroundLuminosityStep == DISPLAY_BACKGROUND_LUMINOSITY_STEP_DEFAULT) {
+        return;
+    }
+
+	uint8_t ch = c >> 8;
+	uint8_t cl = c & 0xFF;
+
+    int i = (ch & 0xF0) | (cl & 0x0F);
+    if (ch == g_colorCache[i][0] && cl == g_colorCache[i][1]) {
+        // cache hit!
+		c = (g_colorCache[i][2] << 8) | g_colorCache[i][3];
+        return;
+    }
+
+    uint16_t cNew = computeAdjustedColor(c, psu::persist_conf::devConf.displayBackgroundLuminosityStep);
+    uint8_t chNew = cNew >> 8;
+    uint8_t clNew = cNew & 0xFF;
+
     // store new color in the cache
     g_colorCache[i][0] = ch;
     g_colorCache[i][1] = cl;
     g_colorCache[i][2] = chNew;
     g_colorCache[i][3] = clNew;
 
-	c = (chNew << 8) | clNew;
+	c = cNew;
 }
 
 uint16_t getColor16FromIndex(uint16_t color) {
@@ -238,6 +288,17 @@ uint16_t getColor16FromIndex(uint16_t color) {
 	return color < g_themeColorsCount ? g_themeColors[color] : g_colors[color - g_themeColorsCount];
 }
 
+static uint16_t getAdjustedColor16FromIndex(uint16_t color) {
+    color = transformColorHook(color);
+    if (color < g_paletteCount) {
+        return g_palette[color];
+    }
+
+    uint16_t c = color < g_themeColorsCount ? g_themeColors[color] : g_colors[color - g_themeColorsCount];
+    adjustColor(c);
+    return c;
+}
+
 void setColor(uint8_t r, uint8_t g, uint8_t b) {
     g_fc = RGB_TO_COLOR(r, g, b);
 	adjustColor(g_fc);
@@ -249,8 +310,7 @@ void setColor16(uint16_t color) {
 }
 
 void setColor(uint16_t color, bool ignoreLuminocity) {
-    g_fc = getColor16FromIndex(color);
-	adjustColor(g_fc);
+    g_fc = getAdjustedColor16FromIndex(color);
 }
 
 uint16_t getColor() {
@@ -263,8 +323,7 @@ void setBackColor(uint8_t r, uint8_t g, uint8_t b) {
 }
 
 void setBackColor(uint16_t color, bool ignoreLuminocity) {
-	g_bc = getColor16FromIndex(color);
-	adjustColor(g_bc);
+	g_bc = getAdjustedColor16FromIndex(color);
 }
 
 uint16_t getBackColor() {
@@ -281,67 +340,213 @@ uint8_t getOpacity() {
     return g_opacity;
 }
 
-// static int g_prevDirtyX1;
-// static int g_prevDirtyY1;
-// static int g_prevDirtyX2;
-// static int g_prevDirtyY2;
+static uint16_t g_benchmarkPalette[CONF_MAX_NUM_PALETTE_COLORS];
+
+void benchmarkColors(int numRepeats, ColorsBenchmarkResult &result) {
+    result.numColors = 0;
+    result.buildTime = 0;
+    result.referenceTime = 0;
+    result.time = 0;
+
+    // benchmark is always done at a non-default luminosity, without changing the one in use
+    result.luminosityStep = psu::persist_conf::devConf.displayBackgroundLuminosityStep;
+    if (result.luminosityStep == DISPLAY_BACKGROUND_LUMINOSITY_STEP_DEFAULT) {
+        result.luminosityStep = DISPLAY_BACKGROUND_LUMINOSITY_STEP_MIN;
+    }
+
+    if (!g_themeColors) {
+        return;
+    }
+
+    uint32_t numColors = getNumPaletteColors();
+    result.numColors = numColors;
+
+    uint32_t start = micros();
+    buildPalette(g_benchmarkPalette, numColors, result.luminosityStep);
+    result.buildTime = micros() - start;
+
+    volatile uint16_t sink;
+
+    // what every setColor(colorIndex) did before: HSL conversion of the theme color
+    start = micros();
+    for (int i = 0; i < numRepeats; i++) {
+        for (uint32_t colorIndex = 0; colorIndex < numColors; colorIndex++) {
+            uint16_t c = colorIndex < g_themeColorsCount ? g_themeColors[colorIndex] : g_colors[colorIndex - g_themeColorsCount];
+            sink = computeAdjustedColor(c, result.luminosityStep);
+        }
+    }
+    result.referenceTime = micros() - start;
+
+    start = micros();
+    for (int i = 0; i < numRepeats; i++) {
+        for (uint32_t colorIndex = 0; colorIndex < numColors; colorIndex++) {
+            sink = g_benchmarkPalette[colorIndex];
+        }
+    }
+    result.time = micros() - start;
+
+    (void)sink;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Dirty region tracking
+//
+// Everything drawn in the current frame is collected in g_nextDirty as a small
+// list of non overlapping rectangles. There are two frame buffers, so the
+// buffer we are composing into was last composed two frames ago: the region
+// that must be composed again is this frame dirty region plus the region that
+// was composed in the previous frame (g_prevDirty), into the other buffer.
+
+#define CONF_MAX_DIRTY_RECTS 8
+
+struct DirtyRect {
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+};
+
+struct DirtyRegion {
+    DirtyRect rects[CONF_MAX_DIRTY_RECTS];
+    int numRects;
+};
+
+static DirtyRegion g_prevDirty;
+static DirtyRegion g_nextDirty;
+
+// markDirty is disabled while composing buffers into the frame buffer
+static bool g_markDirtyEnabled = true;
+
+// offset of the selected buffer, markDirty coordinates are in the buffer coordinates
+static int g_dirtyXOffset;
+static int g_dirtyYOffset;
+
+DirtyStatistics g_dirtyStatistics;
+
+// rows of the frame buffer changed by the last endBuffersDrawing
+static int g_composedY1 = 0;
+static int g_composedY2 = -1;
+
+static inline bool isOverlapping(const DirtyRect &a, const DirtyRect &b) {
+    return a.x1 <= b.x2 && b.x1 <= a.x2 && a.y1 <= b.y2 && b.y1 <= a.y2;
+}
+
+static inline void unionRect(DirtyRect &a, const DirtyRect &b) {
+    a.x1 = MIN(a.x1, b.x1);
+    a.y1 = MIN(a.y1, b.y1);
+    a.x2 = MAX(a.x2, b.x2);
+    a.y2 = MAX(a.y2, b.y2);
+}
+
+static inline uint32_t getRectArea(const DirtyRect &rect) {
+    return (rect.x2 - rect.x1 + 1) * (rect.y2 - rect.y1 + 1);
+}
+
+static void removeRect(DirtyRegion &region, int i) {
+    region.rects[i] = region.rects[--region.numRects];
+}
+
+static void addRect(DirtyRegion &region, DirtyRect rect) {
+    while (true) {
+        // merge with overlapping rectangle, so rectangles in the region never overlap
+        int i;
+        for (i = 0; i < region.numRects; i++) {
+            if (isOverlapping(region.rects[i], rect)) {
+                break;
+            }
+        }
+
+        if (i == region.numRects) {
+            if (region.numRects < CONF_MAX_DIRTY_RECTS) {
+                region.rects[region.numRects++] = rect;
+                return;
+            }
+
+            // no more space, merge with the rectangle that grows the least
+            uint32_t minGrowth = 0xFFFFFFFF;
+            for (int j = 0; j < region.numRects; j++) {
+                DirtyRect merged = region.rects[j];
+                unionRect(merged, rect);
+                uint32_t growth = getRectArea(merged) - getRectArea(region.rects[j]);
+                if (growth < minGrowth) {
+                    minGrowth = growth;
+                    i = j;
+                }
+            }
+        }
+
+        unionRect(rect, region.rects[i]);
+        removeRect(region, i);
+    }
+}
+
+static void expandRows(const DirtyRegion &region, int &y1, int &y2) {
+    for (int i = 0; i < region.numRects; i++) {
+        y1 = MIN(y1, region.rects[i].y1);
+        y2 = MAX(y2, region.rects[i].y2);
+    }
+}
+
+static uint32_t getRegionArea(const DirtyRegion &region) {
+    uint32_t area = 0;
+    for (int i = 0; i < region.numRects; i++) {
+        area += getRectArea(region.rects[i]);
+    }
+    return area;
+}
+
+static void addRect(DirtyRegion &region, int x1, int y1, int x2, int y2) {
+    DirtyRect rect;
+    rect.x1 = MAX(x1, 0);
+    rect.y1 = MAX(y1, 0);
+    rect.x2 = MIN(x2, getDisplayWidth() - 1);
+    rect.y2 = MIN(y2, getDisplayHeight() - 1);
+
+    if (rect.x1 <= rect.x2 && rect.y1 <= rect.y2) {
+        addRect(region, rect);
+    }
+}
 
-// static int g_nextDirtyX1 = getDisplayWidth();
-// static int g_nextDirtyY1 = getDisplayHeight();
-// static int g_nextDirtyX2 = -1;
-// static int g_nextDirtyY2 = -1;
+static bool isOverlapping(const DirtyRegion &region, const DirtyRect &rect) {
+    for (int i = 0; i < region.numRects; i++) {
+        if (isOverlapping(region.rects[i], rect)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-// static int g_dirtyX1;
-// static int g_dirtyY1;
-// static int g_dirtyX2;
-// static int g_dirtyY2;
+void markDirty(int x1, int y1, int x2, int y2) {
+    if (g_markDirtyEnabled) {
+        addRect(g_nextDirty, x1 + g_dirtyXOffset, y1 + g_dirtyYOffset, x2 + g_dirtyXOffset, y2 + g_dirtyYOffset);
+    }
+}
 
-bool g_dirty;
+void markDirty() {
+    if (g_markDirtyEnabled) {
+        g_nextDirty.numRects = 0;
+        addRect(g_nextDirty, 0, 0, getDisplayWidth() - 1, getDisplayHeight() - 1);
+    }
+}
 
 void clearDirty() {
-    g_dirty = false;
-
-    // g_prevDirtyX1 = g_nextDirtyX1;
-    // g_prevDirtyY1 = g_nextDirtyY1;
-    // g_prevDirtyX2 = g_nextDirtyX2;
-    // g_prevDirtyY2 = g_nextDirtyY2;
-
-    // g_nextDirtyX1 = getDisplayWidth();
-    // g_nextDirtyY1 = getDisplayHeight();
-    // g_nextDirtyX2 = -1;
-    // g_nextDirtyY2 = -1;
-}
-
-// void markDirty(int x1, int y1, int x2, int y2) {
-//     if (x1 < g_nextDirtyX1) {
-//         g_nextDirtyX1 = x1;
-//     }
-//     if (y1 < g_nextDirtyY1) {
-//         g_nextDirtyY1 = y1;
-//     }
-//     if (x2 > g_nextDirtyX2) {
-//         g_nextDirtyX2 = x2;
-//     }
-//     if (y2 > g_nextDirtyY2) {
-//         g_nextDirtyY2 = y2;
-//     }
-// }
+    g_prevDirty = g_nextDirty;
+    g_nextDirty.numRects = 0;
+}
 
-bool isDirty() {
-    // g_dirtyX1 = MIN(g_prevDirtyX1, g_nextDirtyX1);
-    // g_dirtyY1 = MIN(g_prevDirtyY1, g_nextDirtyY1);
-    // g_dirtyX2 = MAX(g_prevDirtyX2, g_nextDirtyX2);
-    // g_dirtyY2 = MAX(g_prevDirtyY2, g_nextDirtyY2);
+void resetDirty() {
+    g_prevDirty.numRects = 0;
+    g_nextDirty.numRects = 0;
+}
 
-    // if (g_dirtyX1 <= g_dirtyX2 && g_dirtyY1 <= g_dirtyY2) {
-    //     // char msg[50];
-    //     // sprintf(msg, "%d x %d\n", g_dirtyX2 - g_dirtyX1 + 1, g_dirtyY2 - g_dirtyY1 + 1);
-    //     // Serial.println(msg);
-    //     return true;
-    // }
+bool isDirty() {
+    return g_nextDirty.numRects > 0;
+}
 
-    // return false;
-    return g_dirty;
+bool getComposedRows(int &y1, int &y2) {
+    y1 = g_composedY1;
+    y2 = g_composedY2;
+    return y1 <= y2;
 }
 
 void drawFocusFrame(int x, int y, int w, int h) {
@@ -362,15 +567,6 @@ void drawFocusFrame(int x, int y, int w, int h) {
     fillRect(x, y + h - lineWidth, x + w - 1, y + h - 1);
 }
 
-static int8_t measureGlyph(uint8_t encoding) {
-    gui::font::Glyph glyph;
-    g_font.getGlyph(encoding, glyph);
-    if (!glyph)
-        return 0;
-
-    return glyph.dx;
-}
-
 int8_t measureGlyph(uint8_t encoding, gui::font::Font &font) {
     gui::font::Glyph glyph;
     font.getGlyph(encoding, glyph);
@@ -380,15 +576,13 @@ int8_t measureGlyph(uint8_t encoding, gui::font::Font &font) {
     return glyph.dx;
 }
 
-int measureStr(const char *text, int textLength, gui::font::Font &font, int max_width) {
-    g_font = font;
-
+static int doMeasureStr(const char *text, int textLength, gui::font::Font &font, int max_width) {
     int width = 0;
 
     if (textLength == -1) {
         char encoding;
         while ((encoding = *text++) != 0) {
-            int glyph_width = measureGlyph(encoding);
+            int glyph_width = measureGlyph(encoding, font);
             if (max_width > 0 && width + glyph_width > max_width) {
                 return max_width;
             }
@@ -397,7 +591,7 @@ int measureStr(const char *text, int textLength, gui::font::Font &font, int max_
     } else {
         for (int i = 0; i < textLength && text[i]; ++i) {
             char encoding = text[i];
-            int glyph_width = measureGlyph(encoding);
+            int glyph_width = measureGlyph(encoding, font);
             if (max_width > 0 && width + glyph_width > max_width) {
                 return max_width;
             }
@@ -408,6 +602,78 @@ int measureStr(const char *text, int textLength, gui::font::Font &font, int max_
     return width;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Least recently used measured strings, the same labels and values are
+// measured again in every frame and with every smaller font tried by drawText.
+
+#define CONF_MEASURE_STR_CACHE_SIZE 32
+#define CONF_MEASURE_STR_CACHE_MAX_TEXT_LENGTH 47
+
+struct MeasureStrCacheEntry {
+    const uint8_t *fontData;
+    uint32_t hash;
+    uint32_t lastUsed;
+    int width;
+    uint8_t textLength;
+    char text[CONF_MEASURE_STR_CACHE_MAX_TEXT_LENGTH];
+};
+
+static MeasureStrCacheEntry g_measureStrCache[CONF_MEASURE_STR_CACHE_SIZE];
+static uint32_t g_measureStrCacheTime;
+
+static int measureStrCached(const char *text, int textLength, gui::font::Font &font) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    int length = 0;
+    while ((textLength == -1 || length < textLength) && text[length]) {
+        if (length == CONF_MEASURE_STR_CACHE_MAX_TEXT_LENGTH) {
+            return doMeasureStr(text, textLength, font, 0);
+        }
+        hash = (hash ^ (uint8_t)text[length]) * 16777619u;
+        length++;
+    }
+
+    g_measureStrCacheTime++;
+
+    MeasureStrCacheEntry *leastRecentlyUsed = &g_measureStrCache[0];
+    for (int i = 0; i < CONF_MEASURE_STR_CACHE_SIZE; i++) {
+        MeasureStrCacheEntry &entry = g_measureStrCache[i];
+        if (entry.hash == hash && entry.fontData == font.fontData && entry.textLength == length && memcmp(entry.text, text, length) == 0) {
+            entry.lastUsed = g_measureStrCacheTime;
+            return entry.width;
+        }
+        if (entry.lastUsed < leastRecentlyUsed->lastUsed) {
+            leastRecentlyUsed = &entry;
+        }
+    }
+
+    int width = doMeasureStr(text, length, font, 0);
+
+    leastRecentlyUsed->fontData = font.fontData;
+    leastRecentlyUsed->hash = hash;
+    leastRecentlyUsed->lastUsed = g_measureStrCacheTime;
+    leastRecentlyUsed->width = width;
+    leastRecentlyUsed->textLength = (uint8_t)length;
+    memcpy(leastRecentlyUsed->text, text, length);
+
+    return width;
+}
+
+int measureStr(const char *text, int textLength, gui::font::Font &font, int max_width) {
+    bool useCache = max_width == 0;
+#if OPTION_GUI_THREAD
+    // cache is not thread safe, other threads measure the string directly
+    useCache = useCache && osThreadGetId() == g_guiTaskHandle;
+#endif
+
+    if (useCache) {
+        return measureStrCached(text, textLength, font);
+    }
+
+    return doMeasureStr(text, textLength, font, max_width);
+}
+
 Buffer g_buffers[NUM_BUFFERS];
 
 static void *g_bufferPointer;
@@ -415,6 +681,47 @@ static void *g_bufferPointer;
 static int g_bufferToDrawIndexes[NUM_BUFFERS];
 static int g_numBuffersToDraw;
 
+static void setDirtyOffset(int bufferIndex) {
+    if (bufferIndex != -1) {
+        g_dirtyXOffset = g_buffers[bufferIndex].xOffset;
+        g_dirtyYOffset = g_buffers[bufferIndex].yOffset;
+    } else {
+        g_dirtyXOffset = 0;
+        g_dirtyYOffset = 0;
+    }
+}
+
+// Rectangle of the frame buffer covered by the buffer, including the shadow.
+static bool getBufferRect(const Buffer &buffer, DirtyRect &rect) {
+    if (buffer.width <= 0 || buffer.height <= 0) {
+        return false;
+    }
+
+    rect.x1 = buffer.x + buffer.xOffset;
+    rect.y1 = buffer.y + buffer.yOffset;
+    rect.x2 = rect.x1 + buffer.width - 1;
+    rect.y2 = rect.y1 + buffer.height - 1;
+
+    if (buffer.withShadow) {
+        expandRectWithShadow(rect.x1, rect.y1, rect.x2, rect.y2);
+    }
+
+    return true;
+}
+
+// Marks everything the buffer covers in the frame buffer, i.e. what is changed
+// when the buffer is moved, resized or not drawn anymore.
+static void markBufferDirty(const Buffer &buffer) {
+    DirtyRect rect;
+    if (getBufferRect(buffer, rect)) {
+        addRect(g_nextDirty, rect.x1, rect.y1, rect.x2, rect.y2);
+    }
+
+    if (buffer.backdrop) {
+        addRect(g_nextDirty, buffer.backdrop->x, buffer.backdrop->y, buffer.backdrop->x + buffer.backdrop->w - 1, buffer.backdrop->y + buffer.backdrop->h - 1);
+    }
+}
+
 //int getNumFreeBuffers() {
 //    int count = 0;
 //    for (int bufferIndex = 0; bufferIndex < NUM_BUFFERS; bufferIndex++) {
@@ -447,6 +754,7 @@ int allocBuffer() {
 
 void freeBuffer(int bufferIndex) {
     g_buffers[bufferIndex].flags.allocated = false;
+    markBufferDirty(g_buffers[bufferIndex]);
     // DebugTrace("Buffer %d freed up, %d buffers available now!\n", bufferIndex, getNumFreeBuffers());
 }
 
@@ -454,12 +762,16 @@ void selectBuffer(int bufferIndex) {
     g_buffers[bufferIndex].flags.used = true;
     g_bufferToDrawIndexes[g_numBuffersToDraw++] = bufferIndex;
     setBufferPointer(g_buffers[bufferIndex].bufferPointer);
+    setDirtyOffset(bufferIndex);
 }
 
 void setBufferBounds(int bufferIndex, int x, int y, int width, int height, bool withShadow, uint8_t opacity, int xOffset, int yOffset, Rect *backdrop) {
     Buffer &buffer = g_buffers[bufferIndex];
     
     if (buffer.x != x || buffer.y != y || buffer.width != width || buffer.height != height || buffer.withShadow != withShadow || buffer.opacity != opacity || buffer.xOffset != xOffset || buffer.yOffset != yOffset || backdrop != buffer.backdrop) {
+        // old position
+        markBufferDirty(buffer);
+
         buffer.x = x;
         buffer.y = y;
         buffer.width = width;
@@ -470,22 +782,15 @@ void setBufferBounds(int bufferIndex, int x, int y, int width, int height, bool
         buffer.yOffset = yOffset;
         buffer.backdrop = backdrop;
 
-        int x1 = x + xOffset;
-        int y1 = y + yOffset;
-        int x2 = x1 + width - 1;
-        int y2 = y1 + height - 1;
-
-        if (withShadow) {
-            expandRectWithShadow(x1, y1, x2, y2);
-        }
-
-        markDirty(x1, y1, x2, y2);
+        // new position
+        markBufferDirty(buffer);
     }
 
     for (int i = 0; i < g_numBuffersToDraw; i++) {
         if (g_bufferToDrawIndexes[i] == bufferIndex) {
             if (i > 0) {
                 setBufferPointer(g_buffers[g_bufferToDrawIndexes[i - 1]].bufferPointer);
+                setDirtyOffset(g_bufferToDrawIndexes[i - 1]);
             }
             break;
         }
@@ -511,27 +816,62 @@ void freeUnusedBuffers() {
 
 void beginBuffersDrawing() {
     g_bufferPointer = getBufferPointer();
+    setDirtyOffset(-1);
 }
 
 void endBuffersDrawing() {
     setBufferPointer(g_bufferPointer);
+    setDirtyOffset(-1);
 
     if (keyboard::isDisplayDirty()) {
-    	g_dirty = true;
+        markDirty();
     }
 
     if (mouse::isDisplayDirty()) {
-    	g_dirty = true;
+        markDirty();
+    }
+
+    // buffers that are not drawn anymore uncover what is below them
+    for (int bufferIndex = 0; bufferIndex < NUM_BUFFERS; bufferIndex++) {
+        if (g_buffers[bufferIndex].flags.allocated && !g_buffers[bufferIndex].flags.used) {
+            markBufferDirty(g_buffers[bufferIndex]);
+        }
     }
 
+    g_composedY1 = getDisplayHeight();
+    g_composedY2 = -1;
+
     if (isDirty()) {
+        // this frame buffer was last composed two frames ago
+        DirtyRegion region = g_nextDirty;
+        for (int i = 0; i < g_prevDirty.numRects; i++) {
+            addRect(region, g_prevDirty.rects[i]);
+        }
+
+        // shadow is blended over what is below, so it must be composed completely or not at all
+        bool regionChanged;
+        do {
+            regionChanged = false;
+            for (int i = 0; i < g_numBuffersToDraw; i++) {
+                Buffer &buffer = g_buffers[g_bufferToDrawIndexes[i]];
+                DirtyRect shadowRect;
+                if (buffer.withShadow && getBufferRect(buffer, shadowRect) && isOverlapping(region, shadowRect)) {
+                    int numRects = region.numRects;
+                    uint32_t area = getRegionArea(region);
+                    addRect(region, shadowRect);
+                    if (region.numRects != numRects || getRegionArea(region) != area) {
+                        regionChanged = true;
+                    }
+                }
+            }
+        } while (regionChanged);
+
+        g_markDirtyEnabled = false;
+
         for (int i = 0; i < g_numBuffersToDraw; i++) {
             int bufferIndex = g_bufferToDrawIndexes[i];
             Buffer &buffer = g_buffers[bufferIndex];
 
-            int sx = buffer.x;
-            int sy = buffer.y;
-
             int x1 = buffer.x + buffer.xOffset;
             int y1 = buffer.y + buffer.yOffset;
             int x2 = x1 + buffer.width - 1;
@@ -540,41 +880,54 @@ void endBuffersDrawing() {
             if (buffer.backdrop) {
                 auto savedOpacity = setOpacity(CONF_BACKDROP_OPACITY);
                 setColor(COLOR_ID_BACKDROP);
-                fillRect(buffer.backdrop->x, buffer.backdrop->y, buffer.backdrop->x + buffer.backdrop->w - 1, buffer.backdrop->y + buffer.backdrop->h - 1);
+                for (int j = 0; j < region.numRects; j++) {
+                    const DirtyRect &rect = region.rects[j];
+                    int bx1 = MAX(rect.x1, buffer.backdrop->x);
+                    int by1 = MAX(rect.y1, buffer.backdrop->y);
+                    int bx2 = MIN(rect.x2, buffer.backdrop->x + buffer.backdrop->w - 1);
+                    int by2 = MIN(rect.y2, buffer.backdrop->y + buffer.backdrop->h - 1);
+                    if (bx1 <= bx2 && by1 <= by2) {
+                        fillRect(bx1, by1, bx2, by2);
+                    }
+                }
                 setOpacity(savedOpacity);
             }
 
-            if (buffer.withShadow) {
-                // if (x1 > g_dirtyY1 || y1 > g_dirtyY1 || x2 < g_dirtyX2 || y2 < g_dirtyY2) {
-                    drawShadow(x1, y1, x2, y2);
-                // }
+            DirtyRect shadowRect;
+            if (buffer.withShadow && getBufferRect(buffer, shadowRect) && isOverlapping(region, shadowRect)) {
+                drawShadow(x1, y1, x2, y2);
             }
 
-            // if (x1 < g_dirtyX1) {
-            //     int xd = g_dirtyX1 - x1;
-            //     sx += xd;
-            //     x1 += xd;
-            // }
+            for (int j = 0; j < region.numRects; j++) {
+                const DirtyRect &rect = region.rects[j];
+                int dx1 = MAX(rect.x1, x1);
+                int dy1 = MAX(rect.y1, y1);
+                int dx2 = MIN(rect.x2, x2);
+                int dy2 = MIN(rect.y2, y2);
+                if (dx1 <= dx2 && dy1 <= dy2) {
+                    bitBlt(buffer.bufferPointer, nullptr, buffer.x + dx1 - x1, buffer.y + dy1 - y1, dx2 - dx1 + 1, dy2 - dy1 + 1, dx1, dy1, buffer.opacity);
+                }
+            }
+        }
 
-            // if (y1 < g_dirtyY1) {
-            //     int yd = g_dirtyY1 - y1;
-            //     sy += yd;
-            //     y1 += yd;
-            // }
+        g_markDirtyEnabled = true;
 
-            // if (x2 > g_dirtyX2) {
-            //     x2 = g_dirtyX2;
-            // }
+        // focus frame and mouse cursor are drawn over composed buffers,
+        // they are marked dirty, so they are composed again in the next frame
+        keyboard::updateDisplay();
+        mouse::updateDisplay();
 
-            // if (y2 > g_dirtyY2) {
-            //     y2 = g_dirtyY2;
-            // }
+        expandRows(region, g_composedY1, g_composedY2);
+        expandRows(g_nextDirty, g_composedY1, g_composedY2);
 
-            bitBlt(buffer.bufferPointer, nullptr, sx, sy, x2 - x1 + 1, y2 - y1 + 1, x1, y1, buffer.opacity);
+        uint32_t numPixels = getRegionArea(region);
+        g_dirtyStatistics.numFrames++;
+        g_dirtyStatistics.lastNumRects = region.numRects;
+        g_dirtyStatistics.lastNumPixels = numPixels;
+        if (numPixels > g_dirtyStatistics.maxNumPixels) {
+            g_dirtyStatistics.maxNumPixels = numPixels;
         }
-
-        keyboard::updateDisplay();
-        mouse::updateDisplay();
+        g_dirtyStatistics.totalNumPixels += numPixels;
     }
 
     g_numBuffersToDraw = 0;
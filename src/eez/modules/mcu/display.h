@@ -84,11 +84,53 @@ uint8_t getOpacity();
 
 const uint8_t * takeScreenshot();
 
-void clearDirty();
-// void markDirty(int x1, int y1, int x2, int y2);
-extern bool g_dirty;
-#define markDirty(x1, y1, x2, y2) g_dirty = true
+struct ColorsBenchmarkResult {
+    uint32_t numColors; // theme and global colors in the palette
+    uint8_t luminosityStep;
+    uint32_t buildTime; // in microseconds
+    uint32_t referenceTime; // HSL conversion for every color, in microseconds
+    uint32_t time; // palette lookup for every color, in microseconds
+};
+void benchmarkColors(int numRepeats, ColorsBenchmarkResult &result);
+
+#if defined(EEZ_PLATFORM_SIMULATOR)
+void setHeadless(bool headless); // render into frame buffers, but don't open the window
+
+struct DrawTextBenchmarkResult {
+    uint32_t numGlyphs;
+    uint32_t numPixels;
+    uint32_t referenceTime; // per pixel blendColor, in microseconds
+    uint32_t time; // in microseconds
+    uint32_t numMismatches; // pixels different from the per pixel blendColor
+};
+void benchmarkDrawText(gui::font::Font &font, const char *text, int numRepeats, DrawTextBenchmarkResult &result);
+
+struct BlitBenchmarkResult {
+    const char *name;
+    uint32_t numPixels;
+    uint32_t time; // in microseconds
+};
+static const int NUM_BLIT_BENCHMARKS = 5;
+void benchmarkBlit(int numRepeats, BlitBenchmarkResult *results);
+#endif
+
+// Dirty region tracking, only the region changed in the last two frames
+// (there are two frame buffers) is composed into the frame buffer.
+void markDirty(int x1, int y1, int x2, int y2);
+void markDirty(); // whole display
+void clearDirty(); // called after buffers are swapped
+void resetDirty(); // called when both frame buffers have the same content
 bool isDirty();
+bool getComposedRows(int &y1, int &y2); // frame buffer rows changed by the last endBuffersDrawing
+
+struct DirtyStatistics {
+    uint32_t numFrames;
+    uint32_t lastNumRects;
+    uint32_t lastNumPixels;
+    uint32_t maxNumPixels;
+    uint64_t totalNumPixels;
+};
+extern DirtyStatistics g_dirtyStatistics;
 
 void drawPixel(int x, int y);
 void drawPixel(int x, int y, uint8_t opacity);
@@ -98,6 +140,9 @@ void fillRect(int x1, int y1, int x2, int y2, int radius = 0);
 void fillRect(void *dst, int x1, int y1, int x2, int y2);
 void drawHLine(int x, int y, int l);
 void drawVLine(int x, int y, int l);
+// Draws numLines vertical lines in adjacent columns starting from x, line i is drawn
+// from y + yFrom[i] to y + yTo[i] (inclusive), and it is skipped if yFrom[i] > yTo[i].
+void drawVLines(int x, int y, int numLines, const int16_t *yFrom, const int16_t *yTo);
 void bitBlt(int x1, int y1, int x2, int y2, int x, int y);
 void bitBlt(void *src, int x1, int y1, int x2, int y2);
 void bitBlt(void *src, void *dst, int x1, int y1, int x2, int y2);
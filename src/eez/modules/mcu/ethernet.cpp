@@ -580,6 +580,10 @@ int write(const char *buffer, int buffer_size) {
         // Echo the buffer back to the sender
         iSendResult = ::send(client_socket, buffer, buffer_size, 0);
         if (iSendResult == SOCKET_ERROR) {
+            if (WSAGetLastError() == WSAEWOULDBLOCK) {
+                return 0;
+            }
+
             DebugTrace("send failed with error: %d\n", WSAGetLastError());
             closesocket(client_socket);
             client_socket = INVALID_SOCKET;
@@ -593,6 +597,10 @@ int write(const char *buffer, int buffer_size) {
     if (client_socket != -1) {
         int n = ::write(client_socket, buffer, buffer_size);
         if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+
             close(client_socket);
             client_socket = -1;
             return 0;
@@ -816,8 +824,15 @@ int writeBuffer(const char *buffer, uint32_t length) {
 #endif
 
 #if defined(EEZ_PLATFORM_SIMULATOR)
-    int numWritten = write(buffer, length);
-    osDelay(1);
+    // socket is non-blocking, so keep writing until everything is sent or client is disconnected
+    uint32_t numWritten = 0;
+    while (numWritten < length) {
+        numWritten += write(buffer + numWritten, length - numWritten);
+        osDelay(1);
+        if (!connected()) {
+            break;
+        }
+    }
     return numWritten;
 #endif
 }
@@ -28,6 +28,14 @@
 #include <SDL.h>
 #include <SDL_image.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DISPLAY_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DISPLAY_SIMD_NEON
+#endif
+
 #include <cmsis_os.h>
 
 #include <eez/modules/mcu/display.h>
@@ -37,6 +45,7 @@
 #include <eez/memory.h>
 #include <eez/usb.h>
 #include <eez/gui/gui.h>
+#include <eez/gui/profiler.h>
 #include <eez/platform/simulator/front_panel.h>
 #include <eez/system.h>
 #include <eez/util.h>
@@ -57,6 +66,10 @@ static bool g_isOn;
 
 static SDL_Window *g_mainWindow;
 static SDL_Renderer *g_renderer;
+static SDL_Texture *g_texture;
+static bool g_textureValid; // texture holds the content of g_lastBuffer
+
+static bool g_headless;
 
 static uint32_t *g_buffer;
 static uint32_t *g_lastBuffer;
@@ -121,6 +134,14 @@ bool init() {
 
     SDL_SetRenderDrawBlendMode(g_renderer, SDL_BLENDMODE_BLEND);
 
+    // Create texture, it is kept for the lifetime of the window and only changed rows are uploaded
+    g_texture = SDL_CreateTexture(g_renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    if (g_texture == NULL) {
+        printf("Texture could not be created! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    g_textureValid = false;
+
     // Initialize PNG loading
     int imgFlags = IMG_INIT_PNG;
     if ((IMG_Init(imgFlags) & imgFlags) != imgFlags) {
@@ -157,6 +178,10 @@ void setBufferPointer(void *buffer) {
     g_buffer = (uint32_t *)buffer;
 }
 
+void setHeadless(bool headless) {
+    g_headless = headless;
+}
+
 void turnOn() {
     if (!isOn()) {
         g_isOn = true;
@@ -176,11 +201,13 @@ void turnOn() {
         g_buffers[6].bufferPointer = (uint32_t *)VRAM_AUX_BUFFER7_START_ADDRESS;
         g_buffers[7].bufferPointer = (uint32_t *)VRAM_AUX_BUFFER8_START_ADDRESS;
 
+        g_textureValid = false;
+
         refreshScreen();
     }
 }
 
-void updateScreen(uint32_t *buffer);
+void updateScreen(uint32_t *buffer, int y1 = 0, int y2 = DISPLAY_HEIGHT - 1);
 
 void turnOff() {
     if (isOn()) {
@@ -200,31 +227,77 @@ bool isOn() {
 void updateBrightness() {
 }
 
-void updateScreen(uint32_t *buffer) {
+// Stacked bar per recorded frame, one color per phase, with the line at 60 fps.
+static void drawProfilerOverlay() {
+    using namespace eez::gui::profiler;
+
+    static const int X = 8;
+    static const int Y = 8;
+    static const int BAR_WIDTH = 2;
+    static const int HEIGHT = 120;
+    static const uint32_t FULL_SCALE_TIME = 2 * 1000000 / 60; // two frames at 60 fps
+
+    static const uint8_t PHASE_COLORS[NUM_PHASES][3] = {
+        { 64, 128, 255 }, // sync
+        { 64, 224, 64 },  // events
+        { 255, 224, 64 }, // state
+        { 255, 64, 64 }   // update
+    };
+
+    SDL_Rect rect = { X, Y, CONF_GUI_PROFILER_NUM_FRAMES * BAR_WIDTH, HEIGHT };
+    SDL_SetRenderDrawColor(g_renderer, 0, 0, 0, 160);
+    SDL_RenderFillRect(g_renderer, &rect);
+
+    int numFrames = getNumFrames();
+    for (int frameIndex = 0; frameIndex < numFrames; frameIndex++) {
+        int x = X + (CONF_GUI_PROFILER_NUM_FRAMES - numFrames + frameIndex) * BAR_WIDTH;
+        uint32_t time = 0;
+        int y = Y + HEIGHT;
+        for (int phase = 0; phase < NUM_PHASES && time < FULL_SCALE_TIME; phase++) {
+            time += getPhaseTime(frameIndex, phase);
+            int yPhase = Y + HEIGHT - (int)(MIN(time, FULL_SCALE_TIME) * HEIGHT / FULL_SCALE_TIME);
+            if (yPhase < y) {
+                SDL_Rect bar = { x, yPhase, BAR_WIDTH, y - yPhase };
+                SDL_SetRenderDrawColor(g_renderer, PHASE_COLORS[phase][0], PHASE_COLORS[phase][1], PHASE_COLORS[phase][2], 255);
+                SDL_RenderFillRect(g_renderer, &bar);
+                y = yPhase;
+            }
+        }
+    }
+
+    SDL_SetRenderDrawColor(g_renderer, 255, 255, 255, 255);
+    SDL_RenderDrawLine(g_renderer, X, Y + HEIGHT / 2, X + CONF_GUI_PROFILER_NUM_FRAMES * BAR_WIDTH - 1, Y + HEIGHT / 2);
+}
+
+// Rows outside of [y1, y2] must be the same as in the previously presented buffer.
+void updateScreen(uint32_t *buffer, int y1, int y2) {
     g_lastBuffer = buffer;
 
-    if (!isOn()) {
+    if (!isOn() || g_texture == nullptr) {
         return;
     }
 
-    SDL_Surface *rgbSurface = SDL_CreateRGBSurfaceFrom(
-        buffer, DISPLAY_WIDTH, DISPLAY_HEIGHT, 32, 4 * DISPLAY_WIDTH, 0, 0, 0, 0);
-    if (rgbSurface != NULL) {
-        SDL_Texture *texture = SDL_CreateTextureFromSurface(g_renderer, rgbSurface);
-        if (texture != NULL) {
-            SDL_Rect srcRect = { 0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT };
-            SDL_Rect dstRect = { 0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT };
-
-            SDL_RenderCopyEx(g_renderer, texture, &srcRect, &dstRect, 0.0, NULL, SDL_FLIP_NONE);
+    if (!g_textureValid) {
+        y1 = 0;
+        y2 = DISPLAY_HEIGHT - 1;
+    }
 
-            SDL_DestroyTexture(texture);
+    if (y1 <= y2) {
+        SDL_Rect rect = { 0, y1, DISPLAY_WIDTH, y2 - y1 + 1 };
+        if (SDL_UpdateTexture(g_texture, &rect, buffer + y1 * DISPLAY_WIDTH, 4 * DISPLAY_WIDTH) == 0) {
+            g_textureValid = true;
         } else {
-            printf("Unable to create texture from image buffer! SDL Error: %s\n", SDL_GetError());
+            printf("Unable to update texture from image buffer! SDL Error: %s\n", SDL_GetError());
+            g_textureValid = false;
         }
-        SDL_FreeSurface(rgbSurface);
-    } else {
-        printf("Unable to render text surface! SDL Error: %s\n", SDL_GetError());
     }
+
+    SDL_RenderCopy(g_renderer, g_texture, NULL, NULL);
+
+    if (gui::profiler::isOverlayVisible()) {
+        drawProfilerOverlay();
+    }
+
     SDL_RenderPresent(g_renderer);
 }
 
@@ -286,7 +359,7 @@ void sync() {
         return;
     }
 
-    if (g_mainWindow == nullptr) {
+    if (g_mainWindow == nullptr && !g_headless) {
         init();
     }
 
@@ -305,7 +378,9 @@ void sync() {
     }
 
     if (isDirty()) {
-        updateScreen(g_buffer);
+        int y1, y2;
+        getComposedRows(y1, y2);
+        updateScreen(g_buffer, y1, y2);
 
         if (g_buffer == (uint32_t *)VRAM_BUFFER1_START_ADDRESS) {
             g_buffer = (uint32_t *)VRAM_BUFFER2_START_ADDRESS;
@@ -314,6 +389,9 @@ void sync() {
         }
 
         clearDirty();
+    } else if (gui::profiler::isOverlayVisible() && g_lastBuffer) {
+        // overlay is updated every frame, display content is unchanged
+        updateScreen(g_lastBuffer, 1, 0);
     }
 
 }
@@ -330,6 +408,7 @@ void finishAnimation() {
     }
 
     bitBlt(oldBuffer, 0, 0, getDisplayWidth() - 1, getDisplayHeight() - 1);
+    resetDirty();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -360,36 +439,248 @@ const uint8_t *takeScreenshot() {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-static void doDrawGlyph(const gui::font::Glyph &glyph, int x_glyph, int y_glyph, int width, int height, int offset, int iStartByte) {
-    uint32_t pixel;
-    ((uint8_t *)&pixel)[0] = COLOR_TO_B(g_fc);
-    ((uint8_t *)&pixel)[1] = COLOR_TO_G(g_fc);
-    ((uint8_t *)&pixel)[2] = COLOR_TO_R(g_fc);
-    uint8_t *pixelAlpha = ((uint8_t *)&pixel) + 3;
+// Row-wise pixel primitives, all buffers have DISPLAY_WIDTH stride.
+//
+// Blending over the opaque destination is done with integer arithmetic,
+// result is the same as with blendColor, which is still used for the
+// destination pixels that are not opaque.
+
+static inline uint32_t div255x2(uint32_t x) {
+    // two 16-bit lanes, exact for 0 <= x <= 255 * 255
+    return ((x + 0x00010001 + ((x >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+}
+
+static inline uint32_t blendPixel(uint32_t color, uint32_t alpha, uint32_t dst) {
+    if ((dst >> 24) != 0xFF) {
+        return blendColor((color & 0x00FFFFFF) | (alpha << 24), dst);
+    }
+
+    uint32_t invAlpha = 255 - alpha;
+    uint32_t rb = div255x2((color & 0x00FF00FF) * alpha + (dst & 0x00FF00FF) * invAlpha);
+    uint32_t g = div255x2(((color >> 8) & 0xFF) * alpha + ((dst >> 8) & 0xFF) * invAlpha);
+    return 0xFF000000 | rb | (g << 8);
+}
+
+static inline bool isOpaque4(const uint32_t *p) {
+    return ((p[0] & p[1] & p[2] & p[3]) >> 24) == 0xFF;
+}
+
+// blends 4 pixels, alpha of the pixel i is in the byte i of alpha4,
+// all 4 destination pixels must be opaque
+static inline void blendPixels4(const uint32_t *colors, uint32_t alpha4, uint32_t *dst) {
+#if defined(DISPLAY_SIMD_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i max = _mm_set1_epi16(255);
+
+    // every alpha byte repeated for the 4 channels of its pixel
+    __m128i alpha = _mm_cvtsi32_si128((int)alpha4);
+    alpha = _mm_unpacklo_epi8(alpha, alpha);
+    alpha = _mm_unpacklo_epi16(alpha, alpha);
+    __m128i alphaLo = _mm_unpacklo_epi8(alpha, zero);
+    __m128i alphaHi = _mm_unpackhi_epi8(alpha, zero);
+
+    // alpha channel of the result is 255
+    __m128i fg = _mm_or_si128(_mm_loadu_si128((const __m128i *)colors), _mm_set1_epi32((int)0xFF000000));
+    __m128i fgLo = _mm_unpacklo_epi8(fg, zero);
+    __m128i fgHi = _mm_unpackhi_epi8(fg, zero);
+
+    __m128i bg = _mm_loadu_si128((const __m128i *)dst);
+    __m128i bgLo = _mm_unpacklo_epi8(bg, zero);
+    __m128i bgHi = _mm_unpackhi_epi8(bg, zero);
+
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(fgLo, alphaLo), _mm_mullo_epi16(bgLo, _mm_sub_epi16(max, alphaLo)));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(fgHi, alphaHi), _mm_mullo_epi16(bgHi, _mm_sub_epi16(max, alphaHi)));
+
+    lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, one), _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, one), _mm_srli_epi16(hi, 8)), 8);
+
+    _mm_storeu_si128((__m128i *)dst, _mm_packus_epi16(lo, hi));
+#elif defined(DISPLAY_SIMD_NEON)
+    uint32_t alphas[4] = {
+        (alpha4 & 0xFF) * 0x01010101,
+        ((alpha4 >> 8) & 0xFF) * 0x01010101,
+        ((alpha4 >> 16) & 0xFF) * 0x01010101,
+        (alpha4 >> 24) * 0x01010101
+    };
+    uint8x16_t alpha = vreinterpretq_u8_u32(vld1q_u32(alphas));
+    uint8x16_t invAlpha = vmvnq_u8(alpha);
+
+    // alpha channel of the result is 255
+    uint8x16_t fg = vreinterpretq_u8_u32(vorrq_u32(vld1q_u32(colors), vdupq_n_u32(0xFF000000)));
+    uint8x16_t bg = vreinterpretq_u8_u32(vld1q_u32(dst));
+
+    uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(fg), vget_low_u8(alpha)), vget_low_u8(bg), vget_low_u8(invAlpha));
+    uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(fg), vget_high_u8(alpha)), vget_high_u8(bg), vget_high_u8(invAlpha));
+
+    const uint16x8_t one = vdupq_n_u16(1);
+    lo = vshrq_n_u16(vaddq_u16(vaddq_u16(lo, one), vshrq_n_u16(lo, 8)), 8);
+    hi = vshrq_n_u16(vaddq_u16(vaddq_u16(hi, one), vshrq_n_u16(hi, 8)), 8);
+
+    vst1q_u32(dst, vreinterpretq_u32_u8(vcombine_u8(vmovn_u16(lo), vmovn_u16(hi))));
+#else
+    for (int i = 0; i < 4; i++, alpha4 >>= 8) {
+        dst[i] = blendPixel(colors[i], alpha4 & 0xFF, dst[i]);
+    }
+#endif
+}
+
+static void fillRows(uint32_t *dst, int width, int height, uint32_t color) {
+    for (int y = 0; y < height; y++, dst += DISPLAY_WIDTH) {
+        int x = 0;
+#if defined(DISPLAY_SIMD_SSE2)
+        __m128i color4 = _mm_set1_epi32((int)color);
+        for (; x + 4 <= width; x += 4) {
+            _mm_storeu_si128((__m128i *)(dst + x), color4);
+        }
+#elif defined(DISPLAY_SIMD_NEON)
+        uint32x4_t color4 = vdupq_n_u32(color);
+        for (; x + 4 <= width; x += 4) {
+            vst1q_u32(dst + x, color4);
+        }
+#endif
+        for (; x < width; x++) {
+            dst[x] = color;
+        }
+    }
+}
+
+static void blendRows(uint32_t *dst, int width, int height, uint32_t color, uint8_t opacity) {
+    uint32_t colors[4] = { color, color, color, color };
+    uint32_t alpha4 = opacity * 0x01010101;
+
+    for (int y = 0; y < height; y++, dst += DISPLAY_WIDTH) {
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            if (isOpaque4(dst + x)) {
+                blendPixels4(colors, alpha4, dst + x);
+            } else {
+                for (int i = 0; i < 4; i++) {
+                    dst[x + i] = blendPixel(color, opacity, dst[x + i]);
+                }
+            }
+        }
+        for (; x < width; x++) {
+            dst[x] = blendPixel(color, opacity, dst[x]);
+        }
+    }
+}
+
+// source and destination can overlap in any direction
+static void copyRows(uint32_t *dst, const uint32_t *src, int width, int height) {
+    if (dst == src) {
+        return;
+    }
+
+    if (width == (int)DISPLAY_WIDTH) {
+        memmove(dst, src, width * height * sizeof(uint32_t));
+        return;
+    }
+
+    if (dst < src) {
+        for (int y = 0; y < height; y++, dst += DISPLAY_WIDTH, src += DISPLAY_WIDTH) {
+            memmove(dst, src, width * sizeof(uint32_t));
+        }
+    } else {
+        // destination is below, copy from the last row so source rows are read before they are overwritten
+        dst += (height - 1) * DISPLAY_WIDTH;
+        src += (height - 1) * DISPLAY_WIDTH;
+        for (int y = 0; y < height; y++, dst -= DISPLAY_WIDTH, src -= DISPLAY_WIDTH) {
+            memmove(dst, src, width * sizeof(uint32_t));
+        }
+    }
+}
+
+// source and destination must not overlap
+static void blendCopyRows(uint32_t *dst, const uint32_t *src, int width, int height, uint8_t opacity) {
+    uint32_t alpha4 = opacity * 0x01010101;
+
+    for (int y = 0; y < height; y++, dst += DISPLAY_WIDTH, src += DISPLAY_WIDTH) {
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            if (isOpaque4(dst + x)) {
+                blendPixels4(src + x, alpha4, dst + x);
+            } else {
+                for (int i = 0; i < 4; i++) {
+                    dst[x + i] = blendPixel(src[x + i], opacity, dst[x + i]);
+                }
+            }
+        }
+        for (; x < width; x++) {
+            dst[x] = blendPixel(src[x], opacity, dst[x]);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void rasterizeGlyph(const uint8_t *src, int srcStride, uint32_t *dst, int width, int height, uint32_t color) {
+    color |= 0xFF000000;
+    uint32_t colors[4] = { color, color, color, color };
+
+    for (int y = 0; y < height; y++, src += srcStride, dst += DISPLAY_WIDTH) {
+        int x = 0;
+
+        // 4 pixels at once, most of the glyph area is either fully transparent or fully opaque
+        for (; x + 4 <= width; x += 4) {
+            uint32_t alpha4;
+            memcpy(&alpha4, src + x, 4);
+            if (alpha4 == 0) {
+                continue;
+            }
 
-    const uint8_t *src = glyph.data + offset + iStartByte;
-    int nlSrc = glyph.width - width;
+            uint32_t *p = dst + x;
+            if (alpha4 == 0xFFFFFFFF) {
+                p[0] = color;
+                p[1] = color;
+                p[2] = color;
+                p[3] = color;
+            } else if (isOpaque4(p)) {
+                blendPixels4(colors, alpha4, p);
+            } else {
+                for (int i = 0; i < 4; i++, alpha4 >>= 8) {
+                    if (alpha4 & 0xFF) {
+                        p[i] = blendPixel(color, alpha4 & 0xFF, p[i]);
+                    }
+                }
+            }
+        }
+
+        for (; x < width; x++) {
+            uint8_t alpha = src[x];
+            if (alpha == 255) {
+                dst[x] = color;
+            } else if (alpha != 0) {
+                dst[x] = blendPixel(color, alpha, dst[x]);
+            }
+        }
+    }
+}
 
-    uint32_t *dst = g_buffer + y_glyph * DISPLAY_WIDTH + x_glyph;
-    int nlDst = DISPLAY_WIDTH - width;
+// per pixel blendColor, used only to check and measure rasterizeGlyph
+static void rasterizeGlyphReference(const uint8_t *src, int srcStride, uint32_t *dst, int width, int height, uint32_t color) {
+    uint32_t pixel = color;
+    uint8_t *pixelAlpha = ((uint8_t *)&pixel) + 3;
 
-    for (const uint8_t *srcEnd = src + height * glyph.width; src != srcEnd; src += nlSrc, dst += nlDst) {
-        for (uint32_t *dstEnd = dst + width; dst != dstEnd; src++, dst++) {
-            *pixelAlpha = *src;
-            *dst = blendColor(pixel, *dst);
+    for (int y = 0; y < height; y++, src += srcStride, dst += DISPLAY_WIDTH) {
+        for (int x = 0; x < width; x++) {
+            *pixelAlpha = src[x];
+            dst[x] = blendColor(pixel, dst[x]);
         }
     }
 }
 
-static int8_t drawGlyph(int x1, int y1, int clip_x1, int clip_y1, int clip_x2, int clip_y2, uint8_t encoding) {
+typedef void (*GlyphRasterizer)(const uint8_t *src, int srcStride, uint32_t *dst, int width, int height, uint32_t color);
+
+static int8_t drawGlyph(uint32_t *buffer, gui::font::Font &font, uint32_t color, GlyphRasterizer rasterize, int x1, int y1, int clip_x1, int clip_y1, int clip_x2, int clip_y2, uint8_t encoding) {
     gui::font::Glyph glyph;
-    g_font.getGlyph(encoding, glyph);
+    font.getGlyph(encoding, glyph);
     if (!glyph) {
         return 0;
     }
 
     int x_glyph = x1 + glyph.x;
-    int y_glyph = y1 + g_font.getAscent() - (glyph.y + glyph.height);
+    int y_glyph = y1 + font.getAscent() - (glyph.y + glyph.height);
 
     // draw glyph pixels
     int iStartByte = 0;
@@ -424,7 +715,7 @@ static int8_t drawGlyph(int x1, int y1, int clip_x1, int clip_y1, int clip_x2, i
     }
 
     if (width > 0 && height > 0) {
-        doDrawGlyph(glyph, x_glyph, y_glyph, width, height, offset, iStartByte);
+        rasterize(glyph.data + offset + iStartByte, glyph.width, buffer + y_glyph * DISPLAY_WIDTH + x_glyph, width, height, color);
     }
 
     return glyph.dx;
@@ -470,19 +761,10 @@ void fillRect(int x1, int y1, int x2, int y2, int r) {
         uint32_t *dst = g_buffer + y1 * DISPLAY_WIDTH + x1;
         int width = x2 - x1 + 1;
         int height = y2 - y1 + 1;
-        int nl = DISPLAY_WIDTH - width;
         if (g_opacity == 255) {
-            for (uint32_t *dstEnd = dst + height * DISPLAY_WIDTH; dst != dstEnd; dst += nl) {
-                for (uint32_t *lineEnd = dst + width; dst != lineEnd; dst++) {
-                    *dst = color32;
-                }
-            }
+            fillRows(dst, width, height, color32);
         } else {
-            for (uint32_t *dstEnd = dst + height * DISPLAY_WIDTH; dst != dstEnd; dst += nl) {
-                for (uint32_t *lineEnd = dst + width; dst != lineEnd; dst++) {
-                    *dst = blendColor(color32, *dst);
-                }
-            }
+            blendRows(dst, width, height, color32, g_opacity);
         }
     } else {
         // draw rounded rect
@@ -504,27 +786,13 @@ void fillRect(int x1, int y1, int x2, int y2, int r) {
 }
 
 void fillRect(void *dstBuffer, int x1, int y1, int x2, int y2) {
-    uint32_t color32 = color16to32(g_fc);
-    uint32_t *dst = (uint32_t *)dstBuffer + y1 * DISPLAY_WIDTH + x1;
-    int nl = DISPLAY_WIDTH - (x2 - x1 + 1);
-    for (int y = y1; y <= y2; y++) {
-        for (int x = x1; x <= x2; x++) {
-            *dst++ = color32;
-        }
-        dst += nl;
-    }
+    fillRows((uint32_t *)dstBuffer + y1 * DISPLAY_WIDTH + x1, x2 - x1 + 1, y2 - y1 + 1, color16to32(g_fc));
 
     markDirty(x1, y1, x2, y2);
 }
 
 void drawHLine(int x, int y, int l) {
-    uint32_t color32 = color16to32(g_fc);
-
-    uint32_t *dst = g_buffer + y * DISPLAY_WIDTH + x;
-    uint32_t *dstEnd = dst + l + 1;
-    while (dst < dstEnd) {
-        *dst++ = color32;
-    }
+    fillRows(g_buffer + y * DISPLAY_WIDTH + x, l + 1, 1, color16to32(g_fc));
 
     markDirty(x, y, x + l, y);
 }
@@ -543,21 +811,42 @@ void drawVLine(int x, int y, int l) {
     markDirty(x, y, x, y + l);
 }
 
-void bitBlt(int x1, int y1, int x2, int y2, int dstx, int dsty) {
-    int width = x2 - x1 + 1;
-    int height = y2 - y1 + 1;
+void drawVLines(int x, int y, int numLines, const int16_t *yFrom, const int16_t *yTo) {
+    uint32_t color32 = color16to32(g_fc);
 
-    uint32_t *src = g_buffer + y1 * DISPLAY_WIDTH + x1;
-    uint32_t *dst = g_buffer + dsty * DISPLAY_WIDTH + dstx;
-    int nl = DISPLAY_WIDTH - width;
+    int yMin = 0;
+    int yMax = -1;
 
-    for (int y = y1; y <= y2; y++, src += nl, dst += nl) {
-        for (uint32_t *lineEnd = dst + width; dst != lineEnd; dst++, src++) {
-            uint8_t *src8 = (uint8_t *)src;
-            *dst = color16to32(RGB_TO_COLOR(src8[2], src8[1], src8[0]));
+    for (int i = 0; i < numLines; i++) {
+        if (yFrom[i] > yTo[i]) {
+            continue;
+        }
+
+        uint32_t *dst = g_buffer + (y + yFrom[i]) * DISPLAY_WIDTH + x + i;
+        uint32_t *dstEnd = dst + (yTo[i] - yFrom[i] + 1) * DISPLAY_WIDTH;
+
+        while (dst < dstEnd) {
+            *dst = color32;
+            dst += DISPLAY_WIDTH;
+        }
+
+        if (yMin > yMax) {
+            yMin = yFrom[i];
+            yMax = yTo[i];
+        } else {
+            yMin = MIN(yMin, yFrom[i]);
+            yMax = MAX(yMax, yTo[i]);
         }
     }
 
+    if (yMin <= yMax) {
+        markDirty(x, y + yMin, x + numLines - 1, y + yMax);
+    }
+}
+
+void bitBlt(int x1, int y1, int x2, int y2, int dstx, int dsty) {
+    copyRows(g_buffer + dsty * DISPLAY_WIDTH + dstx, g_buffer + y1 * DISPLAY_WIDTH + x1, x2 - x1 + 1, y2 - y1 + 1);
+
     markDirty(dstx, dsty, dstx + x2 - x1, dsty + y2 - y1);
 }
 
@@ -567,12 +856,8 @@ void bitBlt(void *src, int x1, int y1, int x2, int y2) {
 }
 
 void bitBlt(void *src, void *dst, int x1, int y1, int x2, int y2) {
-    for (int y = y1; y <= y2; ++y) {
-        for (int x = x1; x <= x2; ++x) {
-            int i = y * DISPLAY_WIDTH + x;
-            ((uint32_t *)dst)[i] = ((uint32_t *)src)[i];
-        }
-    }
+    int offset = y1 * DISPLAY_WIDTH + x1;
+    copyRows((uint32_t *)dst + offset, (uint32_t *)src + offset, x2 - x1 + 1, y2 - y1 + 1);
 
     markDirty(x1, y1, x2, y2);
 }
@@ -582,23 +867,13 @@ void bitBlt(void *src, void *dst, int sx, int sy, int sw, int sh, int dx, int dy
         dst = g_buffer;
     }
 
+    uint32_t *dstStart = (uint32_t *)dst + dy * DISPLAY_WIDTH + dx;
+    const uint32_t *srcStart = (const uint32_t *)src + sy * DISPLAY_WIDTH + sx;
+
     if (opacity == 255) {
-        for (int y = 0; y < sh; ++y) {
-            for (int x = 0; x < sw; ++x) {
-                ((uint32_t *)dst)[(dy + y) * DISPLAY_WIDTH + dx + x] = ((uint32_t *)src)[(sy + y) * DISPLAY_WIDTH + sx + x];
-            }
-        }
+        copyRows(dstStart, srcStart, sw, sh);
     } else {
-        for (int y = 0; y < sh; ++y) {
-            for (int x = 0; x < sw; ++x) {
-                uint8_t *p = (uint8_t *)&((uint32_t *)src)[(sy + y) * DISPLAY_WIDTH + sx + x];
-                p[3] = opacity;
-                ((uint32_t *)dst)[(dy + y) * DISPLAY_WIDTH + dx + x] = blendColor(
-                    ((uint32_t *)src)[(sy + y) * DISPLAY_WIDTH + sx + x],
-                    ((uint32_t *)dst)[(dy + y) * DISPLAY_WIDTH + dx + x]
-                );
-            }
-        }
+        blendCopyRows(dstStart, srcStart, sw, sh, opacity);
     }
 }
 
@@ -649,21 +924,121 @@ void drawBitmap(Image *image, int x, int y) {
 void drawStr(const char *text, int textLength, int x, int y, int clip_x1, int clip_y1, int clip_x2, int clip_y2, gui::font::Font &font) {
     g_font = font;
 
+    uint32_t color = color16to32(g_fc);
+
     if (textLength == -1) {
         char encoding;
         while ((encoding = *text++) != 0) {
-            x += drawGlyph(x, y, clip_x1, clip_y1, clip_x2, clip_y2, encoding);
+            x += drawGlyph(g_buffer, g_font, color, rasterizeGlyph, x, y, clip_x1, clip_y1, clip_x2, clip_y2, encoding);
         }
     } else {
         for (int i = 0; i < textLength && text[i]; ++i) {
             char encoding = text[i];
-            x += drawGlyph(x, y, clip_x1, clip_y1, clip_x2, clip_y2, encoding);
+            x += drawGlyph(g_buffer, g_font, color, rasterizeGlyph, x, y, clip_x1, clip_y1, clip_x2, clip_y2, encoding);
         }
     }
 
     markDirty(clip_x1, clip_y1, clip_x2, clip_y2);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+static const int DRAW_TEXT_BENCHMARK_HEIGHT = 80;
+static uint32_t g_drawTextBenchmarkBuffers[2][DISPLAY_WIDTH * DRAW_TEXT_BENCHMARK_HEIGHT];
+
+static void drawTextBenchmarkString(uint32_t *buffer, gui::font::Font &font, GlyphRasterizer rasterize, const char *text) {
+    static const uint32_t color = 0xFFE0E0E0;
+    int x = 0;
+    for (const char *p = text; *p; p++) {
+        x += drawGlyph(buffer, font, color, rasterize, x, 0, 0, 0, DISPLAY_WIDTH - 1, DRAW_TEXT_BENCHMARK_HEIGHT - 1, *p);
+    }
+}
+
+void benchmarkDrawText(gui::font::Font &font, const char *text, int numRepeats, DrawTextBenchmarkResult &result) {
+    result.numGlyphs = 0;
+    result.numPixels = 0;
+    for (const char *p = text; *p; p++) {
+        gui::font::Glyph glyph;
+        font.getGlyph(*p, glyph);
+        if (glyph) {
+            result.numGlyphs++;
+            result.numPixels += glyph.width * glyph.height;
+        }
+    }
+    result.numGlyphs *= numRepeats;
+    result.numPixels *= numRepeats;
+
+    for (int i = 0; i < 2; i++) {
+        for (uint32_t j = 0; j < DISPLAY_WIDTH * DRAW_TEXT_BENCHMARK_HEIGHT; j++) {
+            g_drawTextBenchmarkBuffers[i][j] = 0xFF000000 | (j * 0x00010203);
+        }
+    }
+
+    drawTextBenchmarkString(g_drawTextBenchmarkBuffers[0], font, rasterizeGlyphReference, text);
+    drawTextBenchmarkString(g_drawTextBenchmarkBuffers[1], font, rasterizeGlyph, text);
+
+    result.numMismatches = 0;
+    for (uint32_t j = 0; j < DISPLAY_WIDTH * DRAW_TEXT_BENCHMARK_HEIGHT; j++) {
+        if (g_drawTextBenchmarkBuffers[0][j] != g_drawTextBenchmarkBuffers[1][j]) {
+            result.numMismatches++;
+        }
+    }
+
+    uint32_t start = micros();
+    for (int i = 0; i < numRepeats; i++) {
+        drawTextBenchmarkString(g_drawTextBenchmarkBuffers[0], font, rasterizeGlyphReference, text);
+    }
+    result.referenceTime = micros() - start;
+
+    start = micros();
+    for (int i = 0; i < numRepeats; i++) {
+        drawTextBenchmarkString(g_drawTextBenchmarkBuffers[1], font, rasterizeGlyph, text);
+    }
+    result.time = micros() - start;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const int BLIT_BENCHMARK_WIDTH = 480;
+static const int BLIT_BENCHMARK_HEIGHT = 272;
+static uint32_t g_blitBenchmarkBuffers[2][DISPLAY_WIDTH * BLIT_BENCHMARK_HEIGHT];
+
+void benchmarkBlit(int numRepeats, BlitBenchmarkResult *results) {
+    for (int i = 0; i < 2; i++) {
+        for (uint32_t j = 0; j < DISPLAY_WIDTH * BLIT_BENCHMARK_HEIGHT; j++) {
+            g_blitBenchmarkBuffers[i][j] = 0xFF000000 | (j * 0x00010203);
+        }
+    }
+
+    uint32_t *buffer1 = g_blitBenchmarkBuffers[0];
+    uint32_t *buffer2 = g_blitBenchmarkBuffers[1];
+
+    static const char *names[NUM_BLIT_BENCHMARKS] = { "fill", "fill 50%", "copy", "scroll", "copy 50%" };
+
+    for (int i = 0; i < NUM_BLIT_BENCHMARKS; i++) {
+        uint32_t start = micros();
+
+        for (int j = 0; j < numRepeats; j++) {
+            if (i == 0) {
+                fillRows(buffer1, BLIT_BENCHMARK_WIDTH, BLIT_BENCHMARK_HEIGHT, 0xFF336699);
+            } else if (i == 1) {
+                blendRows(buffer1, BLIT_BENCHMARK_WIDTH, BLIT_BENCHMARK_HEIGHT, 0xFF996633, 128);
+            } else if (i == 2) {
+                copyRows(buffer2, buffer1, BLIT_BENCHMARK_WIDTH, BLIT_BENCHMARK_HEIGHT);
+            } else if (i == 3) {
+                // overlapping, one pixel to the right as YT graph scrolls
+                copyRows(buffer1 + 1, buffer1, BLIT_BENCHMARK_WIDTH - 1, BLIT_BENCHMARK_HEIGHT);
+            } else {
+                blendCopyRows(buffer2, buffer1, BLIT_BENCHMARK_WIDTH, BLIT_BENCHMARK_HEIGHT, 128);
+            }
+        }
+
+        results[i].name = names[i];
+        results[i].numPixels = numRepeats * BLIT_BENCHMARK_WIDTH * BLIT_BENCHMARK_HEIGHT;
+        results[i].time = micros() - start;
+    }
+}
+
 } // namespace display
 } // namespace mcu
 } // namespace eez
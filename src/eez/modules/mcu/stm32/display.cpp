@@ -518,6 +518,7 @@ void finishAnimation() {
     auto oldBuffer = g_buffer;
     swapBuffers();
     bitBlt(oldBuffer, 0, 0, getDisplayWidth() - 1, getDisplayHeight() - 1);
+    resetDirty();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -666,6 +667,41 @@ void drawVLine(int x, int y, int l) {
     markDirty(x, y, x, y + l);
 }
 
+void drawVLines(int x, int y, int numLines, const int16_t *yFrom, const int16_t *yTo) {
+    // lines are short and in different columns, so it is faster
+    // to write them with CPU than to start DMA2D transfer for each line
+    DMA2D_WAIT;
+
+    int yMin = 0;
+    int yMax = -1;
+
+    for (int i = 0; i < numLines; i++) {
+        if (yFrom[i] > yTo[i]) {
+            continue;
+        }
+
+        uint16_t *dst = g_buffer + (y + yFrom[i]) * DISPLAY_WIDTH + x + i;
+        uint16_t *dstEnd = dst + (yTo[i] - yFrom[i] + 1) * DISPLAY_WIDTH;
+
+        while (dst < dstEnd) {
+            *dst = g_fc;
+            dst += DISPLAY_WIDTH;
+        }
+
+        if (yMin > yMax) {
+            yMin = yFrom[i];
+            yMax = yTo[i];
+        } else {
+            yMin = MIN(yMin, yFrom[i]);
+            yMax = MAX(yMax, yTo[i]);
+        }
+    }
+
+    if (yMin <= yMax) {
+        markDirty(x, y + yMin, x + numLines - 1, y + yMax);
+    }
+}
+
 void bitBlt(int x1, int y1, int x2, int y2, int dstx, int dsty) {
     bitBlt(g_buffer, g_buffer, x1, y1, x2-x1+1, y2-y1+1, dstx, dsty);
 
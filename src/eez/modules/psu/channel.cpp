@@ -20,6 +20,7 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include <eez/firmware.h>
@@ -259,6 +260,89 @@ YtDataGetValueFunctionPointer ChannelHistory::getChannelHistoryValueFuncs(int ch
     }
 }
 
+void ChannelHistory::getHistoryValues(int channelIndex, uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max) {
+    Channel &channel = *Channel::g_channels[channelIndex];
+    ChannelHistory *channelHistory = channel.channelHistory;
+
+    if (!channelHistory) {
+        for (uint32_t i = 0; i < numRows; i++) {
+            min[i] = NAN;
+        }
+    } else {
+        unsigned displayValue = columnIndex == 0 ? channel.flags.displayValue1 : channel.flags.displayValue2;
+
+        const float *history =
+            displayValue == DISPLAY_VALUE_VOLTAGE ? channelHistory->uHistory :
+            displayValue == DISPLAY_VALUE_CURRENT ? channelHistory->iHistory :
+            nullptr;
+
+        // copy contiguous parts of the circular buffer
+        float *dst = min;
+        while (numRows > 0) {
+            uint32_t position = rowIndex % CHANNEL_HISTORY_SIZE;
+            uint32_t n = MIN(numRows, CHANNEL_HISTORY_SIZE - position);
+
+            if (history) {
+                memcpy(dst, history + position, n * sizeof(float));
+            } else {
+                for (uint32_t i = 0; i < n; i++) {
+                    dst[i] = channelHistory->uHistory[position + i] * channelHistory->iHistory[position + i];
+                }
+            }
+
+            dst += n;
+            rowIndex += n;
+            numRows -= n;
+        }
+        
+        numRows = dst - min;
+    }
+
+    if (max) {
+        memcpy(max, min, numRows * sizeof(float));
+    }
+}
+
+void ChannelHistory::getChannel0HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max) {
+    getHistoryValues(0, rowIndex, numRows, columnIndex, min, max);
+}
+
+void ChannelHistory::getChannel1HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max) {
+    getHistoryValues(1, rowIndex, numRows, columnIndex, min, max);
+}
+
+void ChannelHistory::getChannel2HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max) {
+    getHistoryValues(2, rowIndex, numRows, columnIndex, min, max);
+}
+
+void ChannelHistory::getChannel3HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max) {
+    getHistoryValues(3, rowIndex, numRows, columnIndex, min, max);
+}
+
+void ChannelHistory::getChannel4HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max) {
+    getHistoryValues(4, rowIndex, numRows, columnIndex, min, max);
+}
+
+void ChannelHistory::getChannel5HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max) {
+    getHistoryValues(5, rowIndex, numRows, columnIndex, min, max);
+}
+
+YtDataGetValuesFunctionPointer ChannelHistory::getChannelHistoryValuesFuncs(int channelIndex) {
+    if (channelIndex == 0) {
+        return ChannelHistory::getChannel0HistoryValues;
+    } else if (channelIndex == 1) {
+        return ChannelHistory::getChannel1HistoryValues;
+    } else if (channelIndex == 2) {
+        return ChannelHistory::getChannel2HistoryValues;
+    } else if (channelIndex == 3) {
+        return ChannelHistory::getChannel3HistoryValues;
+    } else if (channelIndex == 4) {
+        return ChannelHistory::getChannel4HistoryValues;
+    } else {
+        return ChannelHistory::getChannel5HistoryValues;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void Channel::Value::init(float set_, float step_, float limit_) {
@@ -278,9 +362,13 @@ void Channel::Value::resetMonValues() {
     mon_dac_index = -1;
 
     mon_measured = false;
+
+    ++version;
 }
 
 void Channel::Value::addMonValue(float value, float prec) {
+    float previousMon = mon;
+
     if (io_pins::isInhibited()) {
         value = 0;
     }
@@ -322,9 +410,16 @@ void Channel::Value::addMonValue(float value, float prec) {
     }
 
     mon_measured = true;
+
+    if (mon != previousMon) {
+        ++version;
+    }
 }
 
 void Channel::Value::addMonDacValue(float value, float prec) {
+    float previousMon = mon;
+    float previousMonDac = mon_dac;
+
     mon_dac_last = roundPrec(value, prec);
 
     if (mon_dac_index == -1) {
@@ -355,6 +450,10 @@ void Channel::Value::addMonDacValue(float value, float prec) {
         mon_prev = mon_next;
 #endif
     }
+
+    if (mon_dac != previousMonDac || mon != previousMon) {
+        ++version;
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1234,6 +1333,7 @@ float Channel::getCalibratedVoltage(float value) {
 void Channel::doSetVoltage(float value) {
     u.set = value;
     u.mon_dac = 0;
+    ++u.version;
 
     if (prot_conf.u_level < u.set) {
         prot_conf.u_level = u.set;
@@ -1267,6 +1367,7 @@ void Channel::doSetCurrent(float value) {
 
     i.set = value;
     i.mon_dac = 0;
+    ++i.version;
 
     if (isCurrentCalibrationEnabled()) {
         value = remapValue(value, cal_conf.i[flags.currentCurrentRange]);
@@ -1384,6 +1485,7 @@ void Channel::setVoltageLimit(float limit) {
     limit = roundPrec(limit, getVoltageResolution());
 
     u.limit = limit;
+    ++u.version;
     if (u.set > u.limit) {
         setVoltage(u.limit);
     }
@@ -1400,6 +1502,7 @@ void Channel::setCurrentLimit(float limit) {
         limit = getMaxCurrentLimit();
     }
     i.limit = limit;
+    ++i.version;
     if (i.set > i.limit) {
         setCurrent(i.limit);
     }
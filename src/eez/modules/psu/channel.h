@@ -206,6 +206,7 @@ static const float RAMP_DURATION_DEF_VALUE_I = 0;
 static const float RAMP_DURATION_PREC = 0.001f;
 
 typedef float(*YtDataGetValueFunctionPointer)(uint32_t rowIndex, uint8_t columnIndex, float *max);
+typedef void(*YtDataGetValuesFunctionPointer)(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max);
 
 struct ChannelHistory {
     friend struct Channel;
@@ -216,6 +217,7 @@ struct ChannelHistory {
     void update(uint32_t tickCount);
 
     static YtDataGetValueFunctionPointer getChannelHistoryValueFuncs(int channelIndex);
+    static YtDataGetValuesFunctionPointer getChannelHistoryValuesFuncs(int channelIndex);
 
 protected:
     bool historyStarted;
@@ -233,6 +235,14 @@ private:
     static float getChannel3HistoryValue(uint32_t rowIndex, uint8_t columnIndex, float *max);
     static float getChannel4HistoryValue(uint32_t rowIndex, uint8_t columnIndex, float *max);
     static float getChannel5HistoryValue(uint32_t rowIndex, uint8_t columnIndex, float *max);
+
+    static void getHistoryValues(int channelIndex, uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max);
+    static void getChannel0HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max);
+    static void getChannel1HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max);
+    static void getChannel2HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max);
+    static void getChannel3HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max);
+    static void getChannel4HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max);
+    static void getChannel5HistoryValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max);
 };
 
 /// PSU channel.
@@ -371,6 +381,9 @@ public:
         float triggerLevel;
         float rampDuration;
 
+        /// Incremented whenever set, limit or mon values are changed.
+        uint32_t version;
+
         void init(float set_, float step_, float limit_);
         void resetMonValues();
         void addMonDacValue(float value, float precision);
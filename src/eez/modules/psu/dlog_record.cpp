@@ -17,6 +17,7 @@
 */
 
 #include <math.h>
+#include <atomic>
 
 #include <eez/index.h>
 #include <eez/system.h>
@@ -47,6 +48,8 @@ namespace dlog_record {
 #define CHUNK_SIZE 4096
 
 #define CONF_DLOG_SYNC_FILE_TIME_MS 10000
+// must be less than DLOG_RECORD_BUFFER_SIZE, see onFileWriteError
+#define CONF_DLOG_SYNC_FILE_SIZE (32 * 1024)
 
 #define CONF_WRITE_TIMEOUT_MS 1000
 #define CONF_WRITE_FLUSH_TIMEOUT_MS 10000
@@ -113,18 +116,75 @@ static uint32_t g_iSample;
 double g_currentTime;
 static double g_nextTime;
 uint32_t g_fileLength;
+
+// DLOG_RECORD_BUFFER is single producer / single consumer ring buffer:
+//   - producer (PSU thread, or SCPI thread for trace) writes at g_bufferIndex and publishes
+//     complete rows by advancing g_committedBufferIndex,
+//   - consumer (low priority thread) writes committed data directly from the ring buffer into the
+//     file and releases it by advancing g_lastSyncedBufferIndex once it is synced to the file.
+// Producer never overwrites data which is not released yet, if there is no space it skips
+// the sample and writes NaN's in its place as soon as space becomes available. Pending NaN rows
+// are written in chunks that fit into the released space, so any number of them can be written.
 static unsigned int g_bufferIndex;
+static std::atomic<uint32_t> g_committedBufferIndex;
+static uint32_t g_numPendingNanRows;
+// producer doesn't write beyond this index until the next reserveRows, see getLiveRows
+static std::atomic<uint32_t> g_reservedBufferIndex;
 
 static unsigned int g_lastSavedBufferIndex;
 static uint32_t g_lastSavedBufferTickCount;
 
-osMutexId(g_mutexId);
-osMutexDef(g_mutex);
+static File g_file;
+static std::atomic<uint32_t> g_lastSyncedBufferIndex;
+static uint32_t g_lastSyncTickCount;
+
+// file offsets are different from the buffer indexes if data is compressed (VERSION3)
+static uint32_t g_lastSavedFileOffset;
+static uint32_t g_lastSyncedFileOffset;
+static unsigned int g_lastSyncedSavedBufferIndex;
+
+WriteStatistics g_writeStatistics;
+
+// min/max pyramid levels, see "DLOG Pyramid File Format" in dlog_view.h
+struct PyramidLevel {
+    uint32_t numInputs; // number of inputs aggregated in current entry
+    uint32_t numEntries; // number of entries in block
+    dlog_view::BlockElement current[dlog_view::MAX_NUM_OF_Y_AXES];
+    dlog_view::BlockElement block[dlog_view::PYRAMID_BLOCK_NUM_ENTRIES * dlog_view::MAX_NUM_OF_Y_AXES];
+};
+
+// end of the DLOG_PYRAMID_BUFFER is used by dlog_view
+static_assert(dlog_view::PYRAMID_NUM_LEVELS * sizeof(PyramidLevel) + dlog_view::PYRAMID_BLOCK_NUM_ENTRIES * dlog_view::MAX_NUM_OF_Y_AXES * sizeof(dlog_view::BlockElement) <= DLOG_PYRAMID_BUFFER_SIZE, "DLOG_PYRAMID_BUFFER is too small");
+
+static PyramidLevel * const g_pyramidLevels = (PyramidLevel *)DLOG_PYRAMID_BUFFER;
+static File g_pyramidFile;
+static char g_pyramidFilePath[MAX_PATH_LENGTH + 1];
+static unsigned int g_pyramidBufferIndex;
+static uint32_t g_pyramidNumSamples;
+
+// VERSION3 block encoder, see "DLOG Compressed Data Format" in dlog_view.h
+struct BlockEncoder {
+    unsigned int bufferIndex; // next row to encode
+    uint32_t firstRowIndex;
+    uint32_t numRows;
+    uint32_t numBits; // used bits in block, header included
+    uint32_t encodeTime;
+    uint32_t previous[dlog_view::MAX_NUM_OF_Y_AXES];
+    uint8_t leadingZeros[dlog_view::MAX_NUM_OF_Y_AXES];
+    uint8_t meaningfulBits[dlog_view::MAX_NUM_OF_Y_AXES]; // 0 if there is no window yet
+    uint8_t block[dlog_view::DLOG_V3_BLOCK_SIZE];
+};
+
+static BlockEncoder g_blockEncoder;
 
 void abortAfterError();
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static uint32_t getRowSize() {
+    return g_recording.parameters.numYAxes * sizeof(float);
+}
+
 static float getValue(uint32_t rowIndex, uint8_t columnIndex, float *max) {
     float value = *(float *)(DLOG_RECORD_BUFFER + (g_recording.dataOffset + (rowIndex * g_recording.parameters.numYAxes + columnIndex) * 4) % DLOG_RECORD_BUFFER_SIZE);
 
@@ -137,6 +197,26 @@ static float getValue(uint32_t rowIndex, uint8_t columnIndex, float *max) {
     return value;
 }
 
+static void getValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max) {
+    uint32_t rowSize = getRowSize();
+    uint32_t address = g_recording.dataOffset + rowIndex * rowSize + columnIndex * 4;
+
+    for (uint32_t i = 0; i < numRows; i++, address += rowSize) {
+        min[i] = *(float *)(DLOG_RECORD_BUFFER + address % DLOG_RECORD_BUFFER_SIZE);
+    }
+
+    if (g_recording.parameters.yAxisScale == dlog_view::SCALE_LOGARITHMIC) {
+        float logOffset = 1 - g_recording.parameters.yAxes[columnIndex].range.min;
+        for (uint32_t i = 0; i < numRows; i++) {
+            min[i] = log10f(logOffset + min[i]);
+        }
+    }
+
+    if (max) {
+        memcpy(max, min, numRows * sizeof(float));
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 static int fileTruncate() {
@@ -158,60 +238,455 @@ static int fileTruncate() {
     return SCPI_RES_OK;
 }
 
-void getNextWriteBuffer(const uint8_t *&buffer, uint32_t &bufferSize, bool flush) {
-    static uint8_t g_saveBuffer[CHUNK_SIZE];
+// returns number of bytes to write, split in at most two contiguous buffers inside DLOG_RECORD_BUFFER
+static uint32_t getNextWriteBuffer(const uint8_t *(&buffers)[2], uint32_t (&bufferSizes)[2], bool flush) {
+    uint32_t committedBufferIndex = g_committedBufferIndex.load(std::memory_order_acquire);
+    if (g_recording.parameters.compression && committedBufferIndex > g_recording.dataOffset) {
+        // only the header is written as is, see getNextEncodedBlock,
+        // and it is written as soon as there is some data to encode
+        committedBufferIndex = g_recording.dataOffset;
+        flush = true;
+    }
 
-    buffer = nullptr;
-    bufferSize = 0;
+    uint32_t indexDiff = committedBufferIndex - g_lastSavedBufferIndex;
+    if (indexDiff == 0) {
+        return 0;
+    }
 
-    if (osMutexWait(g_mutexId, 5) == osOK) {
-        int32_t timeDiff = millis() - g_lastSavedBufferTickCount;
-        uint32_t alignedBufferIndex = (g_bufferIndex / 4) * 4;
-        uint32_t indexDiff = alignedBufferIndex - g_lastSavedBufferIndex;
-        if (indexDiff > 0 && (flush || timeDiff >= CONF_DLOG_SYNC_FILE_TIME_MS || indexDiff >= CHUNK_SIZE)) {
-            bufferSize = MIN(indexDiff, CHUNK_SIZE);
-            buffer = g_saveBuffer;
+    int32_t timeDiff = millis() - g_lastSavedBufferTickCount;
+    if (!flush && timeDiff < CONF_DLOG_SYNC_FILE_TIME_MS && indexDiff < CHUNK_SIZE) {
+        return 0;
+    }
 
-            int32_t i = g_bufferIndex - (g_lastSavedBufferIndex + DLOG_RECORD_BUFFER_SIZE);
+    uint32_t bufferSize = MIN(indexDiff, CHUNK_SIZE);
 
-            if (i <= 0) {
-                i = 0;
-            } else {
-                if ((uint32_t)i > bufferSize) {
-                    i = bufferSize;
-                }
-                
-                for (int j = 0; j < i / 4; j++) {
-                    ((float *)g_saveBuffer)[j] = NAN;
-                }
+    uint32_t tail = g_lastSavedBufferIndex % DLOG_RECORD_BUFFER_SIZE;
+
+    buffers[0] = DLOG_RECORD_BUFFER + tail;
+    if (tail + bufferSize <= DLOG_RECORD_BUFFER_SIZE) {
+        bufferSizes[0] = bufferSize;
+        bufferSizes[1] = 0;
+    } else {
+        bufferSizes[0] = DLOG_RECORD_BUFFER_SIZE - tail;
+        buffers[1] = DLOG_RECORD_BUFFER;
+        bufferSizes[1] = bufferSize - bufferSizes[0];
+    }
+
+    return bufferSize;
+}
+
+static void putUint16(uint8_t *buffer, uint16_t value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
+
+static void putUint32(uint8_t *buffer, uint32_t value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+    buffer[2] = (value >> 16) & 0xFF;
+    buffer[3] = value >> 24;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void encoderStart(unsigned int bufferIndex) {
+    g_blockEncoder.bufferIndex = bufferIndex;
+    g_blockEncoder.firstRowIndex = (bufferIndex - g_recording.dataOffset) / getRowSize();
+    g_blockEncoder.numRows = 0;
+    g_blockEncoder.numBits = dlog_view::DLOG_V3_BLOCK_HEADER_SIZE * 8;
+    g_blockEncoder.encodeTime = 0;
+    memset(g_blockEncoder.block, 0, sizeof(g_blockEncoder.block));
+}
+
+static void encoderPutBits(uint32_t value, int numBits) {
+    while (numBits > 0) {
+        uint32_t bitIndex = g_blockEncoder.numBits;
+        int numFreeBits = 8 - (bitIndex & 7);
+        int n = MIN(numFreeBits, numBits);
+        uint8_t bits = (uint8_t)((value >> (numBits - n)) & ((1 << n) - 1));
+        g_blockEncoder.block[bitIndex >> 3] |= bits << (numFreeBits - n);
+        g_blockEncoder.numBits += n;
+        numBits -= n;
+    }
+}
+
+// x must not be 0
+static int countLeadingZeros(uint32_t x) {
+    int n = 0;
+    while (!(x & 0x80000000)) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+}
+
+// x must not be 0
+static int countTrailingZeros(uint32_t x) {
+    int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+
+// returns number of bits required to encode the value, value is written only if write is true
+static int encoderValue(uint8_t columnIndex, uint32_t value, bool write) {
+    BlockEncoder &encoder = g_blockEncoder;
+
+    if (encoder.numRows == 0) {
+        if (write) {
+            encoderPutBits(value, 32);
+            encoder.previous[columnIndex] = value;
+            encoder.meaningfulBits[columnIndex] = 0;
+        }
+        return 32;
+    }
+
+    uint32_t x = value ^ encoder.previous[columnIndex];
+    if (x == 0) {
+        if (write) {
+            encoderPutBits(0, 1);
+        }
+        return 1;
+    }
+
+    int leadingZeros = countLeadingZeros(x);
+    int trailingZeros = countTrailingZeros(x);
+
+    int meaningfulBits = encoder.meaningfulBits[columnIndex];
+    if (meaningfulBits > 0 && leadingZeros >= encoder.leadingZeros[columnIndex] && trailingZeros >= 32 - encoder.leadingZeros[columnIndex] - meaningfulBits) {
+        // fits inside previous window
+        if (write) {
+            encoderPutBits(2, 2);
+            encoderPutBits(x >> (32 - encoder.leadingZeros[columnIndex] - meaningfulBits), meaningfulBits);
+            encoder.previous[columnIndex] = value;
+        }
+        return 2 + meaningfulBits;
+    }
+
+    meaningfulBits = 32 - leadingZeros - trailingZeros;
+    if (write) {
+        encoderPutBits(3, 2);
+        encoderPutBits(leadingZeros, 5);
+        encoderPutBits(meaningfulBits - 1, 5);
+        encoderPutBits(x >> trailingZeros, meaningfulBits);
+        encoder.previous[columnIndex] = value;
+        encoder.leadingZeros[columnIndex] = leadingZeros;
+        encoder.meaningfulBits[columnIndex] = meaningfulBits;
+    }
+    return 12 + meaningfulBits;
+}
+
+// encodes committed rows into the current block, returns true if block is full
+static bool encoderAddRows() {
+    uint32_t startTime = micros();
+
+    uint32_t committedBufferIndex = g_committedBufferIndex.load(std::memory_order_acquire);
+    uint8_t numYAxes = g_recording.parameters.numYAxes;
+    uint32_t rowSize = getRowSize();
+    uint32_t maxNumRows = dlog_view::DLOG_V3_BLOCK_MAX_NUM_VALUES / numYAxes;
+
+    bool full = false;
+
+    while (g_blockEncoder.bufferIndex + rowSize <= committedBufferIndex) {
+        if (g_blockEncoder.numRows == maxNumRows) {
+            full = true;
+            break;
+        }
 
-                //DebugTrace("NaN's: %d\n", i);
+        uint32_t row[dlog_view::MAX_NUM_OF_Y_AXES];
+        int numBits = 0;
+        for (uint8_t i = 0; i < numYAxes; i++) {
+            row[i] = *(uint32_t *)(DLOG_RECORD_BUFFER + (g_blockEncoder.bufferIndex + i * sizeof(float)) % DLOG_RECORD_BUFFER_SIZE);
+            numBits += encoderValue(i, row[i], false);
+        }
+
+        if (g_blockEncoder.numBits + numBits > dlog_view::DLOG_V3_BLOCK_SIZE * 8) {
+            full = true;
+            break;
+        }
+
+        for (uint8_t i = 0; i < numYAxes; i++) {
+            encoderValue(i, row[i], true);
+        }
+
+        g_blockEncoder.numRows++;
+        g_blockEncoder.bufferIndex += rowSize;
+    }
+
+    g_blockEncoder.encodeTime += micros() - startTime;
+
+    return full;
+}
+
+static void encoderFinishBlock() {
+    putUint32(g_blockEncoder.block, g_blockEncoder.firstRowIndex);
+    putUint16(g_blockEncoder.block + 4, (uint16_t)g_blockEncoder.numRows);
+    putUint16(g_blockEncoder.block + 6, (uint16_t)((g_blockEncoder.numBits + 7) / 8));
+}
+
+// returns number of bytes to write (block size or 0), partial is set if block is not full
+// and it should be written again at the same file offset when it is
+static uint32_t getNextEncodedBlock(const uint8_t *(&buffers)[2], uint32_t (&bufferSizes)[2], bool flush, bool &partial) {
+    partial = false;
+
+    if (!encoderAddRows()) {
+        if (g_blockEncoder.numRows == 0) {
+            return 0;
+        }
+
+        // last block is written when recording is finished,
+        // otherwise write it from time to time so it is not lost if something goes wrong
+        if (!flush) {
+            int32_t timeDiff = millis() - g_lastSavedBufferTickCount;
+            if (timeDiff < CONF_DLOG_SYNC_FILE_TIME_MS) {
+                return 0;
             }
+            partial = true;
+        }
+    }
 
-            if ((uint32_t)i < bufferSize) {
-                uint32_t tail = (g_lastSavedBufferIndex + i) % DLOG_RECORD_BUFFER_SIZE;
-                uint32_t head = (g_lastSavedBufferIndex + bufferSize) % DLOG_RECORD_BUFFER_SIZE;
-                if (tail < head) {
-                    memcpy(g_saveBuffer + i, DLOG_RECORD_BUFFER + tail, head - tail);
-                } else {
-                    uint32_t n = DLOG_RECORD_BUFFER_SIZE - tail;
-                    memcpy(g_saveBuffer, DLOG_RECORD_BUFFER + tail, n);
-                    if (head > 0) {
-                        memcpy(g_saveBuffer + n, DLOG_RECORD_BUFFER, head);
-                        //DebugTrace("boundary: %d\n", n);
-                    }
+    encoderFinishBlock();
+
+    buffers[0] = g_blockEncoder.block;
+    bufferSizes[0] = dlog_view::DLOG_V3_BLOCK_SIZE;
+    bufferSizes[1] = 0;
+
+    return dlog_view::DLOG_V3_BLOCK_SIZE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void pyramidAbort() {
+    if (g_pyramidFile.isOpen()) {
+        g_pyramidFile.close();
+        sd_card::deleteFile(g_pyramidFilePath, nullptr);
+    }
+}
+
+static void pyramidOpen() {
+    if (!dlog_view::getPyramidFilePath(g_recording.parameters.filePath, g_pyramidFilePath)) {
+        return;
+    }
+
+    if (!g_pyramidFile.open(g_pyramidFilePath, FILE_CREATE_ALWAYS | FILE_WRITE)) {
+        return;
+    }
+
+    // header is written when recording is finished
+    uint8_t header[dlog_view::PYRAMID_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    if (g_pyramidFile.write(header, sizeof(header)) != sizeof(header)) {
+        pyramidAbort();
+        return;
+    }
+
+    memset(g_pyramidLevels, 0, dlog_view::PYRAMID_NUM_LEVELS * sizeof(PyramidLevel));
+    g_pyramidBufferIndex = g_recording.dataOffset;
+    g_pyramidNumSamples = 0;
+}
+
+static void pyramidAggregate(dlog_view::BlockElement &element, const dlog_view::BlockElement &input, bool first) {
+    if (first || isNaN(element.min)) {
+        element = input;
+    } else {
+        if (input.min < element.min) {
+            element.min = input.min;
+        }
+        if (input.max > element.max) {
+            element.max = input.max;
+        }
+    }
+}
+
+static void pyramidWriteBlock(PyramidLevel &level) {
+    if (g_pyramidFile.isOpen()) {
+        uint32_t blockSize = dlog_view::PYRAMID_BLOCK_NUM_ENTRIES * g_recording.parameters.numYAxes * sizeof(dlog_view::BlockElement);
+        if (g_pyramidFile.write(level.block, blockSize) != blockSize) {
+            pyramidAbort();
+        }
+    }
+    level.numEntries = 0;
+}
+
+static void pyramidAddInput(int levelIndex, const dlog_view::BlockElement *input) {
+    PyramidLevel &level = g_pyramidLevels[levelIndex];
+    uint8_t numYAxes = g_recording.parameters.numYAxes;
+
+    for (uint8_t i = 0; i < numYAxes; i++) {
+        pyramidAggregate(level.current[i], input[i], level.numInputs == 0);
+    }
+
+    if (++level.numInputs < (levelIndex == 0 ? dlog_view::PYRAMID_BASE_FACTOR : dlog_view::PYRAMID_LEVEL_FACTOR)) {
+        return;
+    }
+
+    dlog_view::BlockElement *entry = level.block + level.numEntries * numYAxes;
+    memcpy(entry, level.current, numYAxes * sizeof(dlog_view::BlockElement));
+    level.numInputs = 0;
+
+    // block must be written before the blocks of the upper levels, see dlog_view::getPyramidBlockIndex
+    if (++level.numEntries == dlog_view::PYRAMID_BLOCK_NUM_ENTRIES) {
+        pyramidWriteBlock(level);
+    }
+
+    if (levelIndex + 1 < dlog_view::PYRAMID_NUM_LEVELS) {
+        pyramidAddInput(levelIndex + 1, entry);
+    }
+}
+
+// adds all the rows written to the file so far
+static void pyramidProcessRows() {
+    if (!g_pyramidFile.isOpen()) {
+        return;
+    }
+
+    uint8_t numYAxes = g_recording.parameters.numYAxes;
+    uint32_t rowSize = getRowSize();
+
+    while (g_pyramidBufferIndex + rowSize <= g_lastSavedBufferIndex) {
+        dlog_view::BlockElement row[dlog_view::MAX_NUM_OF_Y_AXES];
+        for (uint8_t i = 0; i < numYAxes; i++) {
+            row[i].min = row[i].max = *(float *)(DLOG_RECORD_BUFFER + (g_pyramidBufferIndex + i * sizeof(float)) % DLOG_RECORD_BUFFER_SIZE);
+        }
+
+        pyramidAddInput(0, row);
+
+        g_pyramidBufferIndex += rowSize;
+        g_pyramidNumSamples++;
+    }
+}
+
+static void pyramidClose() {
+    if (!g_pyramidFile.isOpen()) {
+        return;
+    }
+
+    pyramidProcessRows();
+
+    // write partial blocks, from the lowest to the highest level
+    uint8_t numYAxes = g_recording.parameters.numYAxes;
+    for (int levelIndex = 0; levelIndex < dlog_view::PYRAMID_NUM_LEVELS; levelIndex++) {
+        PyramidLevel &level = g_pyramidLevels[levelIndex];
+
+        if (level.numInputs > 0) {
+            memcpy(level.block + level.numEntries * numYAxes, level.current, numYAxes * sizeof(dlog_view::BlockElement));
+            level.numEntries++;
+
+            if (levelIndex + 1 < dlog_view::PYRAMID_NUM_LEVELS) {
+                PyramidLevel &nextLevel = g_pyramidLevels[levelIndex + 1];
+                for (uint8_t i = 0; i < numYAxes; i++) {
+                    pyramidAggregate(nextLevel.current[i], level.current[i], nextLevel.numInputs == 0);
                 }
-            } 
-            
-            // for (uint32_t i = 0; i < bufferSize; i++) {
-            //     g_saveBuffer[i] = g_lastSavedBufferIndex + i + DLOG_RECORD_BUFFER_SIZE >= g_bufferIndex ? DLOG_RECORD_BUFFER[(g_lastSavedBufferIndex + i) % DLOG_RECORD_BUFFER_SIZE] : 0;
-            // }
+                nextLevel.numInputs++;
+            }
+        }
+
+        if (level.numEntries > 0) {
+            pyramidWriteBlock(level);
+        }
+    }
+
+    uint8_t header[dlog_view::PYRAMID_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    putUint32(header, dlog_view::MAGIC1);
+    putUint32(header + 4, dlog_view::PYRAMID_MAGIC2);
+    putUint16(header + 8, dlog_view::PYRAMID_VERSION);
+    putUint16(header + 10, numYAxes);
+    putUint32(header + 12, g_pyramidNumSamples);
+    putUint32(header + 16, g_lastSavedFileOffset);
+
+    if (!g_pyramidFile.isOpen() || !g_pyramidFile.seek(0) || g_pyramidFile.write(header, sizeof(header)) != sizeof(header)) {
+        pyramidAbort();
+        return;
+    }
+
+    if (!g_pyramidFile.close()) {
+        sd_card::deleteFile(g_pyramidFilePath, nullptr);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void fileClose() {
+    if (g_file.isOpen()) {
+        g_file.close();
+    }
+}
+
+static int fileOpen() {
+    if (g_file.isOpen()) {
+        return 0;
+    }
+
+    // not opened in append mode because after error, or partial VERSION3 block,
+    // already written data is overwritten
+    if (!g_file.open(g_recording.parameters.filePath, FILE_OPEN_ALWAYS | FILE_WRITE)) {
+        return event_queue::EVENT_ERROR_DLOG_FILE_REOPEN_ERROR;
+    }
+
+    if (!g_file.seek(g_lastSavedFileOffset)) {
+        g_file.close();
+        return event_queue::EVENT_ERROR_DLOG_SEEK_ERROR;
+    }
+
+    g_writeStatistics.numOpens++;
+
+    return 0;
+}
+
+static int fileSync(bool force) {
+    uint32_t lastSyncedBufferIndex = g_lastSyncedBufferIndex.load(std::memory_order_relaxed);
+    uint32_t numBytes = g_lastSavedBufferIndex - lastSyncedBufferIndex;
+    if (numBytes == 0) {
+        return 0;
+    }
+
+    // header must reach the card before anything else, everything else is synced by time or size
+    if (!force && lastSyncedBufferIndex >= g_recording.dataOffset) {
+        int32_t timeDiff = millis() - g_lastSyncTickCount;
+        if (timeDiff < CONF_DLOG_SYNC_FILE_TIME_MS && numBytes < CONF_DLOG_SYNC_FILE_SIZE) {
+            return 0;
         }
-        osMutexRelease(g_mutexId);
     }
+
+    if (!g_file.sync()) {
+        return event_queue::EVENT_ERROR_DLOG_WRITE_ERROR;
+    }
+
+    // release synced data to the producer, but keep the row pyramid didn't process yet
+    uint32_t releaseBufferIndex = g_lastSavedBufferIndex;
+    if (g_pyramidFile.isOpen() && g_pyramidBufferIndex < releaseBufferIndex) {
+        releaseBufferIndex = g_pyramidBufferIndex;
+    }
+    g_lastSyncedBufferIndex.store(releaseBufferIndex, std::memory_order_release);
+    g_lastSyncedSavedBufferIndex = g_lastSavedBufferIndex;
+    g_lastSyncedFileOffset = g_lastSavedFileOffset;
+    g_lastSyncTickCount = millis();
+    g_writeStatistics.numSyncs++;
+
+    return 0;
+}
+
+static void onFileWriteError() {
+    //DebugTrace("write error\n");
+
+    // whatever was written after the last successful sync is not trusted,
+    // it will be written again after file is reopened (producer didn't touch it
+    // because it is released only after sync)
+    g_lastSavedBufferIndex = g_lastSyncedSavedBufferIndex;
+    g_lastSavedFileOffset = g_lastSyncedFileOffset;
+    if (g_recording.parameters.compression) {
+        encoderStart(MAX(g_lastSavedBufferIndex, g_recording.dataOffset));
+    }
+
+    fileClose();
+    sd_card::reinitialize();
+
+    g_writeStatistics.numErrors++;
 }
 
-// returns true if there is more data to write
 void fileWrite(bool flush) {
     if (g_state != STATE_EXECUTING) {
         return;
@@ -219,58 +694,108 @@ void fileWrite(bool flush) {
 
     uint32_t timeout = millis() + CONF_WRITE_TIMEOUT_MS;
     while (millis() < timeout) {
-        const uint8_t *buffer = nullptr;
-        uint32_t bufferSize = 0;
-        getNextWriteBuffer(buffer, bufferSize, flush);
-        if (!buffer) {
+        const uint8_t *buffers[2];
+        uint32_t bufferSizes[2];
+        uint32_t bufferSize;
+        bool encoded = g_recording.parameters.compression && g_lastSavedBufferIndex >= g_recording.dataOffset;
+        bool partial = false;
+        if (encoded) {
+            bufferSize = getNextEncodedBlock(buffers, bufferSizes, flush, partial);
+        } else {
+            bufferSize = getNextWriteBuffer(buffers, bufferSizes, flush);
+        }
+        if (bufferSize == 0) {
+            if (g_file.isOpen() && fileSync(flush)) {
+                onFileWriteError();
+            }
             return;
         }
 
-        int err = 0;
-
-        File file;
-        if (file.open(g_recording.parameters.filePath, FILE_OPEN_APPEND | FILE_WRITE)) {
-            if (file.seek(g_lastSavedBufferIndex)) {
-                size_t written = file.write(buffer, bufferSize);
+        uint32_t writeStartTime = micros();
 
-                if (written != bufferSize) {
-                    err = event_queue::EVENT_ERROR_DLOG_WRITE_ERROR;
-                }
+        int err = fileOpen();
+        for (int i = 0; !err && i < 2 && bufferSizes[i] > 0; i++) {
+            size_t written = g_file.write(buffers[i], bufferSizes[i]);
+            if (written != bufferSizes[i]) {
+                err = event_queue::EVENT_ERROR_DLOG_WRITE_ERROR;
+            }
+        }
 
-                if (!file.close()) {
+        if (!err) {
+            if (partial) {
+                // partial block stays in the encoder, go back to write it again later
+                if (!g_file.seek(g_lastSavedFileOffset)) {
+                    err = event_queue::EVENT_ERROR_DLOG_SEEK_ERROR;
+                } else if (!g_file.sync()) {
                     err = event_queue::EVENT_ERROR_DLOG_WRITE_ERROR;
                 }
+            } else {
+                g_lastSavedFileOffset += bufferSize;
+                if (encoded) {
+                    g_writeStatistics.numBlocks++;
+                    g_writeStatistics.numRawBytes += g_blockEncoder.bufferIndex - g_lastSavedBufferIndex;
+                    g_writeStatistics.numEncodedBytes += (g_blockEncoder.numBits + 7) / 8;
+                    g_writeStatistics.encodeTime += g_blockEncoder.encodeTime;
+                    if (g_blockEncoder.encodeTime > g_writeStatistics.maxEncodeTime) {
+                        g_writeStatistics.maxEncodeTime = g_blockEncoder.encodeTime;
+                    }
 
-                if (!err) {
+                    g_lastSavedBufferIndex = g_blockEncoder.bufferIndex;
+                    encoderStart(g_lastSavedBufferIndex);
+                } else {
                     g_lastSavedBufferIndex += bufferSize;
-                    g_lastSavedBufferTickCount = millis();
                 }
-            } else {
-                err = event_queue::EVENT_ERROR_DLOG_SEEK_ERROR;
             }
-        } else {
-            err = event_queue::EVENT_ERROR_DLOG_FILE_REOPEN_ERROR;
+        }
+
+        if (!err) {
+            if (g_recording.parameters.compression) {
+                g_fileLength = g_lastSavedFileOffset + (partial ? bufferSize : 0);
+            }
+            g_lastSavedBufferTickCount = millis();
+            pyramidProcessRows();
+            err = fileSync(flush);
         }
 
         if (err) {
-            //DebugTrace("write error\n");
-            sd_card::reinitialize();
+            onFileWriteError();
             return;
         }
+
+        uint32_t writeTime = micros() - writeStartTime;
+        g_writeStatistics.numBytesWritten += bufferSize;
+        g_writeStatistics.writeTime += writeTime;
+        if (writeTime > g_writeStatistics.maxWriteTime) {
+            g_writeStatistics.maxWriteTime = writeTime;
+        }
+    }
+}
+
+float getWriteSpeed() {
+    if (g_writeStatistics.writeTime == 0) {
+        return 0.0f;
+    }
+    return 1.0f * g_writeStatistics.numBytesWritten / g_writeStatistics.writeTime;
+}
+
+float getCompressionRatio() {
+    if (g_writeStatistics.numBlocks == 0) {
+        return 0.0f;
     }
+    return 1.0f * g_writeStatistics.numRawBytes / (g_writeStatistics.numBlocks * dlog_view::DLOG_V3_BLOCK_SIZE);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 static void flushData() {
-    //DebugTrace("flush before: %d\n", g_bufferIndex - g_lastSavedBufferIndex);
+    //DebugTrace("flush before: %d\n", g_committedBufferIndex - g_lastSavedBufferIndex);
 
     uint32_t timeout = millis() + CONF_WRITE_FLUSH_TIMEOUT_MS;
-    while (g_lastSavedBufferIndex < g_bufferIndex && millis() < timeout) {
+    while (g_lastSyncedBufferIndex.load(std::memory_order_relaxed) < g_committedBufferIndex.load(std::memory_order_relaxed) && millis() < timeout) {
         fileWrite(true);
     }
 
-    //DebugTrace("flush after: %d\n", g_bufferIndex - g_lastSavedBufferIndex);
+    //DebugTrace("flush after: %d\n", g_committedBufferIndex - g_lastSavedBufferIndex);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -278,7 +803,10 @@ static void flushData() {
 static void writeUint8(uint8_t value) {
     *(DLOG_RECORD_BUFFER + (g_bufferIndex % DLOG_RECORD_BUFFER_SIZE)) = value;
     g_bufferIndex++;
-    g_fileLength++;
+    if (!g_recording.parameters.compression) {
+        // for the compressed data file length is updated by fileWrite
+        g_fileLength++;
+    }
 }
 
 static void writeUint16(uint16_t value) {
@@ -297,6 +825,52 @@ static void writeFloat(float value) {
     writeUint32(*((uint32_t *)&value));
 }
 
+// checks if there is enough released space in the ring buffer for the given number of rows
+// and, if there is, reserves it
+static bool reserveRows(uint32_t numRows) {
+    uint32_t reservedBufferIndex = g_bufferIndex + numRows * getRowSize();
+    if (reservedBufferIndex - g_lastSyncedBufferIndex.load(std::memory_order_acquire) > DLOG_RECORD_BUFFER_SIZE) {
+        return false;
+    }
+
+    // must be visible before anything is overwritten
+    g_reservedBufferIndex.store(reservedBufferIndex, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    return true;
+}
+
+static void commitRows() {
+    g_committedBufferIndex.store(g_bufferIndex, std::memory_order_release);
+}
+
+// writes as many pending NaN rows as fits into the released space of the ring buffer,
+// returns true if there are no more pending NaN rows
+static bool writePendingNanRows() {
+    if (g_numPendingNanRows == 0) {
+        return true;
+    }
+
+    uint32_t usedSpace = g_bufferIndex - g_lastSyncedBufferIndex.load(std::memory_order_acquire);
+    uint32_t numRows = MIN(g_numPendingNanRows, (DLOG_RECORD_BUFFER_SIZE - usedSpace) / getRowSize());
+    if (numRows == 0 || !reserveRows(numRows)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < numRows; i++) {
+        for (int yAxisIndex = 0; yAxisIndex < g_recording.parameters.numYAxes; yAxisIndex++) {
+            writeFloat(NAN);
+        }
+        ++g_recording.size;
+    }
+
+    g_numPendingNanRows -= numRows;
+
+    commitRows();
+
+    return g_numPendingNanRows == 0;
+}
+
 static void writeUint8Field(uint8_t id, uint8_t value) {
     writeUint16(sizeof(uint16_t) + sizeof(uint8_t) + sizeof(uint8_t));
     writeUint8(id);
@@ -364,7 +938,16 @@ static void initRecordingStart() {
     g_nextTime = 0;
     g_fileLength = 0;
     g_bufferIndex = 0;
+    g_committedBufferIndex.store(0, std::memory_order_relaxed);
+    g_numPendingNanRows = 0;
+    g_reservedBufferIndex.store(0, std::memory_order_relaxed);
     g_lastSavedBufferIndex = 0;
+    g_lastSyncedBufferIndex.store(0, std::memory_order_relaxed);
+    g_lastSavedFileOffset = 0;
+    g_lastSyncedFileOffset = 0;
+    g_lastSyncedSavedBufferIndex = 0;
+
+    memset(&g_writeStatistics, 0, sizeof(g_writeStatistics));
 
     memcpy(&g_recording.parameters, &g_parameters, sizeof(dlog_view::Parameters));
 
@@ -381,13 +964,14 @@ static void initRecordingStart() {
     dlog_view::initDlogValues(g_recording);
 
     g_recording.getValue = getValue;
+    g_recording.getValues = getValues;
 }
 
 static void writeFileHeaderAndMetaFields() {
     // header
     writeUint32(dlog_view::MAGIC1);
     writeUint32(dlog_view::MAGIC2);
-    writeUint16(dlog_view::VERSION2);
+    writeUint16(g_recording.parameters.compression ? dlog_view::VERSION3 : dlog_view::VERSION2);
     writeUint16(g_recording.parameters.numYAxes);
     uint32_t savedBufferIndex = g_bufferIndex;
     writeUint32(0);
@@ -457,6 +1041,8 @@ static void writeFileHeaderAndMetaFields() {
     g_bufferIndex = savedBufferIndex;
     writeUint32(g_recording.dataOffset);
     g_bufferIndex = g_recording.dataOffset;
+
+    commitRows();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -495,29 +1081,17 @@ static void log(uint32_t tickCount) {
     }
 
     if (g_currentTime >= g_nextTime) {
-        if (osMutexWait(g_mutexId, 5) == osOK) {
-            while (1) {
-                g_nextTime = ++g_iSample * g_recording.parameters.period;
-                if (g_currentTime < g_nextTime || g_nextTime > g_recording.parameters.time) {
-                    break;
-                }
-
-                // we missed a sample, write NAN's
-                for (int i = 0; i < CH_NUM; ++i) {
-                    if (g_recording.parameters.logVoltage[i]) {
-                        writeFloat(NAN);
-                    }
-                    if (g_recording.parameters.logCurrent[i]) {
-                        writeFloat(NAN);
-                    }
-                    if (g_recording.parameters.logPower[i]) {
-                        writeFloat(NAN);
-                    }
-                }
-
-                ++g_recording.size;
+        while (1) {
+            g_nextTime = ++g_iSample * g_recording.parameters.period;
+            if (g_currentTime < g_nextTime || g_nextTime > g_recording.parameters.time) {
+                break;
             }
 
+            // we missed a sample, write NAN's
+            ++g_numPendingNanRows;
+        }
+
+        if (writePendingNanRows() && reserveRows(1)) {
             // write sample
             for (int i = 0; i < CH_NUM; ++i) {
                 Channel &channel = Channel::get(i);
@@ -545,11 +1119,14 @@ static void log(uint32_t tickCount) {
                     writeFloat(uMon * iMon);
                 }
             }
-            
+
             ++g_recording.size;
 
-            osMutexRelease(g_mutexId);
-        }        
+            commitRows();
+        } else {
+            // no space in the ring buffer, file writer is too slow
+            ++g_numPendingNanRows;
+        }
 
         if (g_nextTime > g_recording.parameters.time) {
             stateTransition(EVENT_FINISH);
@@ -574,7 +1151,14 @@ static int doStartImmediately() {
 
     writeFileHeaderAndMetaFields();
 
+    if (g_recording.parameters.compression) {
+        encoderStart(g_recording.dataOffset);
+    }
+
+    pyramidOpen();
+
     g_lastSavedBufferTickCount = millis();
+    g_lastSyncTickCount = g_lastSavedBufferTickCount;
 
     setState(STATE_EXECUTING);
 
@@ -582,10 +1166,6 @@ static int doStartImmediately() {
 }
 
 static int doInitiate(bool traceInitiated) {
-    if (!g_mutexId) {
-        g_mutexId = osMutexCreate(osMutex(g_mutex));
-    }
-
     int err;
 
     g_traceInitiated = traceInitiated;
@@ -617,6 +1197,12 @@ static void resetParameters() {
 static void doFinish(bool afterError) {
     if (!afterError) {
         flushData();
+        pyramidClose();
+    } else {
+        pyramidAbort();
+    }
+    fileClose();
+    if (!afterError) {
         onSdCardFileChangeHook(g_parameters.filePath);
     }
     resetParameters();
@@ -813,15 +1399,67 @@ void tick(uint32_t tickCount) {
 
 void log(float *values) {
     if (g_state == STATE_EXECUTING) {
-        for (int yAxisIndex = 0; yAxisIndex < dlog_record::g_recording.parameters.numYAxes; yAxisIndex++) {
+        if (!writePendingNanRows() || !reserveRows(1)) {
+            ++g_numPendingNanRows;
+            return;
+        }
+
+        for (int yAxisIndex = 0; yAxisIndex < g_recording.parameters.numYAxes; yAxisIndex++) {
             writeFloat(values[yAxisIndex]);
         }
         ++g_recording.size;
+
+        commitRows();
     }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// rows before the returned one could be overwritten by the producer at any moment
+static uint32_t getFirstIntactRowIndex() {
+    uint32_t reservedBufferIndex = g_reservedBufferIndex.load(std::memory_order_relaxed);
+    if (reservedBufferIndex <= g_recording.dataOffset + DLOG_RECORD_BUFFER_SIZE) {
+        return 0;
+    }
+    uint32_t rowSize = getRowSize();
+    return (reservedBufferIndex - DLOG_RECORD_BUFFER_SIZE - g_recording.dataOffset + rowSize - 1) / rowSize;
+}
+
+uint32_t getLiveRows(uint32_t &rowIndex, uint8_t *buffer, uint32_t maxNumRows) {
+    uint32_t rowSize = getRowSize();
+
+    uint32_t committedBufferIndex = g_committedBufferIndex.load(std::memory_order_acquire);
+    uint32_t numRows = committedBufferIndex > g_recording.dataOffset ? (committedBufferIndex - g_recording.dataOffset) / rowSize : 0;
+
+    rowIndex = MAX(rowIndex, getFirstIntactRowIndex());
+    rowIndex = MIN(rowIndex, numRows);
+
+    uint32_t n = MIN(numRows - rowIndex, maxNumRows);
+
+    uint32_t tail = (g_recording.dataOffset + rowIndex * rowSize) % DLOG_RECORD_BUFFER_SIZE;
+    uint32_t size = n * rowSize;
+    if (tail + size <= DLOG_RECORD_BUFFER_SIZE) {
+        memcpy(buffer, DLOG_RECORD_BUFFER + tail, size);
+    } else {
+        memcpy(buffer, DLOG_RECORD_BUFFER + tail, DLOG_RECORD_BUFFER_SIZE - tail);
+        memcpy(buffer + DLOG_RECORD_BUFFER_SIZE - tail, DLOG_RECORD_BUFFER, size - (DLOG_RECORD_BUFFER_SIZE - tail));
+    }
+
+    // drop the rows producer started to overwrite while they were copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t firstIntactRowIndex = getFirstIntactRowIndex();
+    if (rowIndex < firstIntactRowIndex) {
+        uint32_t numLostRows = MIN(firstIntactRowIndex - rowIndex, n);
+        memmove(buffer, buffer + numLostRows * rowSize, (n - numLostRows) * rowSize);
+        rowIndex += numLostRows;
+        n -= numLostRows;
+    }
+
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 const char *getLatestFilePath() {
     return g_recording.parameters.filePath[0] != 0 ? g_recording.parameters.filePath : nullptr;
 }
@@ -73,8 +73,37 @@ void tick(uint32_t tick_usec);
 void log(float *values);
 
 void fileWrite(bool flush = false);
+
+struct WriteStatistics {
+    uint32_t numBytesWritten;
+    uint64_t writeTime; // total time spent in write and sync, in microseconds
+    uint32_t maxWriteTime; // worst single chunk write and sync latency, in microseconds
+    uint32_t numOpens;
+    uint32_t numSyncs;
+    uint32_t numErrors;
+    // compression (VERSION3) only
+    uint32_t numBlocks;
+    uint32_t numRawBytes; // size of the rows encoded in blocks
+    uint32_t numEncodedBytes; // used bytes in blocks
+    uint64_t encodeTime; // in microseconds
+    uint32_t maxEncodeTime; // worst single block, in microseconds
+};
+
+extern WriteStatistics g_writeStatistics;
+
+// achieved write speed in MB/s
+float getWriteSpeed();
+
+// raw data size / file data size
+float getCompressionRatio();
+
 void stateTransition(int event, int *perr = nullptr);
 
+// Copies up to maxNumRows rows, starting from rowIndex, from the ring buffer while recording.
+// If some of the requested rows are not in the ring buffer anymore rowIndex is moved
+// to the first available row. Returns number of rows copied.
+uint32_t getLiveRows(uint32_t &rowIndex, uint8_t *buffer, uint32_t maxNumRows);
+
 const char *getLatestFilePath();
 
 } // namespace dlog_record
@@ -53,15 +53,17 @@ bool g_showLatest = true;
 char g_filePath[MAX_PATH_LENGTH + 1];
 Recording g_recording;
 
+#define CONF_NUM_PREFETCH_BLOCKS_AHEAD 2
+#define CONF_NUM_PREFETCH_BLOCKS_BEHIND 1
+
+// cache block is identified by the (scale, startAddress) pair,
+// blocks are replaced in LRU order
 struct CacheBlock {
     unsigned valid: 1;
     uint32_t loadedValues;
     uint32_t startAddress;
-};
-
-struct BlockElement {
-    float min;
-    float max;
+    float scale;
+    uint32_t lastUsed;
 };
 
 static const uint32_t NUM_ELEMENTS_PER_BLOCKS = 480 * MAX_NUM_OF_Y_VALUES;
@@ -74,9 +76,31 @@ static bool g_isLoading;
 static bool g_interruptLoading;
 static uint32_t g_blockIndexToLoad;
 static float g_loadScale;
+static uint32_t g_lastUsedCounter;
+static uint32_t g_lastUsedBlockIndex;
+static int g_scrollDirection = 1;
 static bool g_refreshed;
 static bool g_wasExecuting;
 
+static bool g_pyramidAvailable;
+static uint32_t g_pyramidNumSamples;
+// holds one pyramid level block, recorder is using the beginning of the DLOG_PYRAMID_BUFFER
+static BlockElement * const g_pyramidBlock = (BlockElement *)(DLOG_PYRAMID_BUFFER + DLOG_PYRAMID_BUFFER_SIZE) - PYRAMID_BLOCK_NUM_ENTRIES * MAX_NUM_OF_Y_AXES;
+
+// VERSION3 data block is decoded at once, see "DLOG Compressed Data Format" in dlog_view.h
+struct DecodedBlock {
+    bool valid;
+    uint32_t blockIndex;
+    uint32_t firstRowIndex;
+    uint32_t numRows;
+};
+
+static DecodedBlock g_decodedBlock;
+static uint32_t g_numDataBlocks;
+static uint8_t * const g_decodeBlockData = DLOG_DECODE_BUFFER;
+static uint32_t * const g_decodedValues = (uint32_t *)(DLOG_DECODE_BUFFER + DLOG_V3_BLOCK_SIZE);
+static_assert(DLOG_V3_BLOCK_SIZE + DLOG_V3_BLOCK_MAX_NUM_VALUES * sizeof(float) <= DLOG_DECODE_BUFFER_SIZE, "DLOG_DECODE_BUFFER is too small");
+
 State getState() {
     if (g_showLatest) {
         if (g_wasExecuting) {
@@ -137,11 +161,430 @@ void invalidateAllBlocks() {
     }
 }
 
+inline float getLoadScale() {
+    return g_recording.xAxisDiv / g_recording.xAxisDivMin;
+}
+
+inline bool isCacheBlock(unsigned blockIndex, uint32_t blockStartAddress, float scale) {
+    return g_cacheBlocks[blockIndex].valid && g_cacheBlocks[blockIndex].startAddress == blockStartAddress && g_cacheBlocks[blockIndex].scale == scale;
+}
+
+// returns cache block for the given (start address, scale), if not already in cache
+// least recently used block is replaced (but never the one currently loading)
+static unsigned getCacheBlockIndex(uint32_t blockStartAddress, float scale) {
+    unsigned blockIndex = g_lastUsedBlockIndex;
+
+    if (!isCacheBlock(blockIndex, blockStartAddress, scale)) {
+        unsigned lruBlockIndex = NUM_BLOCKS;
+
+        for (blockIndex = 0; blockIndex < NUM_BLOCKS; blockIndex++) {
+            if (isCacheBlock(blockIndex, blockStartAddress, scale)) {
+                break;
+            }
+
+            if (g_isLoading && blockIndex == g_blockIndexToLoad) {
+                continue;
+            }
+
+            // difference is signed, so the order is kept when g_lastUsedCounter wraps around
+            if (lruBlockIndex == NUM_BLOCKS || !g_cacheBlocks[blockIndex].valid ||
+                (g_cacheBlocks[lruBlockIndex].valid && (int32_t)(g_cacheBlocks[blockIndex].lastUsed - g_cacheBlocks[lruBlockIndex].lastUsed) < 0)) {
+                lruBlockIndex = blockIndex;
+            }
+        }
+
+        if (blockIndex == NUM_BLOCKS) {
+            blockIndex = lruBlockIndex;
+
+            BlockElement *blockElements = getCacheBlock(blockIndex);
+            for (unsigned i = 0; i < NUM_ELEMENTS_PER_BLOCKS; i++) {
+                blockElements[i].min = NAN;
+                blockElements[i].max = NAN;
+            }
+
+            g_cacheBlocks[blockIndex].valid = 1;
+            g_cacheBlocks[blockIndex].loadedValues = 0;
+            g_cacheBlocks[blockIndex].startAddress = blockStartAddress;
+            g_cacheBlocks[blockIndex].scale = scale;
+        }
+    }
+
+    g_cacheBlocks[blockIndex].lastUsed = ++g_lastUsedCounter;
+    g_lastUsedBlockIndex = blockIndex;
+
+    return blockIndex;
+}
+
+// returns true if block is completely loaded
+static bool requestCacheBlock(unsigned blockIndex) {
+    if (g_cacheBlocks[blockIndex].loadedValues >= NUM_ELEMENTS_PER_BLOCKS) {
+        return true;
+    }
+
+    if (!g_isLoading) {
+        g_isLoading = true;
+        g_interruptLoading = false;
+        g_blockIndexToLoad = blockIndex;
+        g_loadScale = g_cacheBlocks[blockIndex].scale;
+
+        sendMessageToLowPriorityThread(THREAD_MESSAGE_DLOG_LOAD_BLOCK);
+    }
+
+    return false;
+}
+
+// make sure visible blocks are loaded, after that load the neighbouring blocks in the scroll direction
+static void prefetchBlocks() {
+    if (g_state != STATE_READY || g_isLoading || &getRecording() != &g_recording || g_recording.size == 0) {
+        return;
+    }
+
+    uint32_t rowSize = getNumElementsPerRow() * sizeof(BlockElement);
+    uint32_t position = getPosition(g_recording);
+    int firstBlock = position * rowSize / BLOCK_SIZE;
+    int lastBlock = ((position + g_recording.pageSize) * rowSize - 1) / BLOCK_SIZE;
+    int numBlocks = (g_recording.size * rowSize + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    float scale = getLoadScale();
+
+    for (int blockIndex = firstBlock; blockIndex <= lastBlock && blockIndex < numBlocks; blockIndex++) {
+        if (!requestCacheBlock(getCacheBlockIndex(blockIndex * BLOCK_SIZE, scale))) {
+            return;
+        }
+    }
+
+    for (int i = 1; i <= CONF_NUM_PREFETCH_BLOCKS_AHEAD + CONF_NUM_PREFETCH_BLOCKS_BEHIND; i++) {
+        int blockIndex;
+        if (i <= CONF_NUM_PREFETCH_BLOCKS_AHEAD) {
+            blockIndex = g_scrollDirection > 0 ? lastBlock + i : firstBlock - i;
+        } else {
+            int j = i - CONF_NUM_PREFETCH_BLOCKS_AHEAD;
+            blockIndex = g_scrollDirection > 0 ? firstBlock - j : lastBlock + j;
+        }
+
+        if (blockIndex >= 0 && blockIndex < numBlocks) {
+            if (!requestCacheBlock(getCacheBlockIndex(blockIndex * BLOCK_SIZE, scale))) {
+                return;
+            }
+        }
+    }
+}
+
+static bool decoderGetBits(uint32_t &bitIndex, uint32_t endBitIndex, int numBits, uint32_t &value) {
+    if (bitIndex + numBits > endBitIndex) {
+        return false;
+    }
+
+    value = 0;
+    while (numBits > 0) {
+        int numAvailableBits = 8 - (bitIndex & 7);
+        int n = MIN(numAvailableBits, numBits);
+        uint8_t bits = (g_decodeBlockData[bitIndex >> 3] >> (numAvailableBits - n)) & ((1 << n) - 1);
+        value = (value << n) | bits;
+        bitIndex += n;
+        numBits -= n;
+    }
+
+    return true;
+}
+
+static bool decodeDataBlock(File &file, uint32_t blockIndex) {
+    if (g_decodedBlock.valid && g_decodedBlock.blockIndex == blockIndex) {
+        return true;
+    }
+
+    g_decodedBlock.valid = false;
+
+    if (!file.seek(g_recording.dataOffset + blockIndex * DLOG_V3_BLOCK_SIZE) || file.read(g_decodeBlockData, DLOG_V3_BLOCK_SIZE) != DLOG_V3_BLOCK_SIZE) {
+        return false;
+    }
+
+    uint32_t offset = 0;
+    uint32_t firstRowIndex = readUint32(g_decodeBlockData, offset);
+    uint32_t numRows = readUint16(g_decodeBlockData, offset);
+    uint32_t numUsedBytes = readUint16(g_decodeBlockData, offset);
+
+    uint8_t numYAxes = g_recording.parameters.numYAxes;
+    if (numRows * numYAxes > DLOG_V3_BLOCK_MAX_NUM_VALUES || numUsedBytes < DLOG_V3_BLOCK_HEADER_SIZE || numUsedBytes > DLOG_V3_BLOCK_SIZE) {
+        return false;
+    }
+
+    uint32_t bitIndex = DLOG_V3_BLOCK_HEADER_SIZE * 8;
+    uint32_t endBitIndex = numUsedBytes * 8;
+
+    uint32_t previous[MAX_NUM_OF_Y_AXES];
+    uint32_t leadingZeros[MAX_NUM_OF_Y_AXES];
+    uint32_t meaningfulBits[MAX_NUM_OF_Y_AXES];
+
+    uint32_t *values = g_decodedValues;
+
+    for (uint32_t rowIndex = 0; rowIndex < numRows; rowIndex++) {
+        for (uint8_t k = 0; k < numYAxes; k++) {
+            uint32_t value;
+
+            if (rowIndex == 0) {
+                if (!decoderGetBits(bitIndex, endBitIndex, 32, value)) {
+                    return false;
+                }
+                meaningfulBits[k] = 0;
+            } else {
+                uint32_t controlBit;
+                if (!decoderGetBits(bitIndex, endBitIndex, 1, controlBit)) {
+                    return false;
+                }
+
+                if (controlBit == 0) {
+                    value = previous[k];
+                } else {
+                    if (!decoderGetBits(bitIndex, endBitIndex, 1, controlBit)) {
+                        return false;
+                    }
+
+                    if (controlBit == 1) {
+                        // new window
+                        uint32_t length;
+                        if (!decoderGetBits(bitIndex, endBitIndex, 5, leadingZeros[k]) || !decoderGetBits(bitIndex, endBitIndex, 5, length)) {
+                            return false;
+                        }
+                        meaningfulBits[k] = length + 1;
+                        if (leadingZeros[k] + meaningfulBits[k] > 32) {
+                            return false;
+                        }
+                    } else if (meaningfulBits[k] == 0) {
+                        return false;
+                    }
+
+                    uint32_t x;
+                    if (!decoderGetBits(bitIndex, endBitIndex, meaningfulBits[k], x)) {
+                        return false;
+                    }
+
+                    value = previous[k] ^ (x << (32 - leadingZeros[k] - meaningfulBits[k]));
+                }
+            }
+
+            previous[k] = value;
+            *values++ = value;
+        }
+    }
+
+    g_decodedBlock.valid = true;
+    g_decodedBlock.blockIndex = blockIndex;
+    g_decodedBlock.firstRowIndex = firstRowIndex;
+    g_decodedBlock.numRows = numRows;
+
+    return true;
+}
+
+inline bool isRowInDecodedBlock(uint32_t rowIndex) {
+    return g_decodedBlock.valid && rowIndex >= g_decodedBlock.firstRowIndex && rowIndex < g_decodedBlock.firstRowIndex + g_decodedBlock.numRows;
+}
+
+// decodes data block with the given row
+static bool findDataBlock(File &file, uint32_t rowIndex) {
+    if (isRowInDecodedBlock(rowIndex)) {
+        return true;
+    }
+
+    uint32_t lo = 0;
+    uint32_t hi = g_numDataBlocks;
+
+    if (g_decodedBlock.valid) {
+        if (rowIndex >= g_decodedBlock.firstRowIndex) {
+            // sequential access, try the next block first
+            if (g_decodedBlock.blockIndex + 1 < g_numDataBlocks) {
+                if (!decodeDataBlock(file, g_decodedBlock.blockIndex + 1)) {
+                    return false;
+                }
+                if (isRowInDecodedBlock(rowIndex)) {
+                    return true;
+                }
+            }
+            lo = g_decodedBlock.blockIndex;
+        } else {
+            hi = g_decodedBlock.blockIndex;
+        }
+    }
+
+    // binary search by the first row index in the block header
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+
+        uint8_t buffer[4];
+        if (!file.seek(g_recording.dataOffset + mid * DLOG_V3_BLOCK_SIZE) || file.read(buffer, sizeof(buffer)) != sizeof(buffer)) {
+            return false;
+        }
+
+        uint32_t offset = 0;
+        if (readUint32(buffer, offset) <= rowIndex) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return decodeDataBlock(file, lo) && isRowInDecodedBlock(rowIndex);
+}
+
+// reads numRows rows starting from rowIndex, returns number of rows read
+static uint32_t readRows(File &file, uint32_t rowIndex, float *values, uint32_t numRows) {
+    uint8_t numYAxes = g_recording.parameters.numYAxes;
+    uint32_t rowSize = numYAxes * sizeof(float);
+
+    if (!g_recording.parameters.compression) {
+        if (!file.seek(g_recording.dataOffset + rowIndex * rowSize)) {
+            return 0;
+        }
+        return file.read(values, numRows * rowSize) / rowSize;
+    }
+
+    uint32_t numRowsRead = 0;
+    while (numRowsRead < numRows && findDataBlock(file, rowIndex + numRowsRead)) {
+        uint32_t i = rowIndex + numRowsRead - g_decodedBlock.firstRowIndex;
+        uint32_t n = MIN(numRows - numRowsRead, g_decodedBlock.numRows - i);
+        memcpy(values + numRowsRead * numYAxes, g_decodedValues + i * numYAxes, n * rowSize);
+        numRowsRead += n;
+    }
+    return numRowsRead;
+}
+
+static bool openPyramid(File &dlogFile) {
+    char pyramidFilePath[MAX_PATH_LENGTH + 1];
+    if (!getPyramidFilePath(g_filePath, pyramidFilePath)) {
+        return false;
+    }
+
+    File file;
+    if (!file.open(pyramidFilePath, FILE_OPEN_EXISTING | FILE_READ)) {
+        return false;
+    }
+
+    uint8_t buffer[PYRAMID_HEADER_SIZE];
+    uint32_t read = file.read(buffer, PYRAMID_HEADER_SIZE);
+    file.close();
+    if (read != PYRAMID_HEADER_SIZE) {
+        return false;
+    }
+
+    uint32_t offset = 0;
+    uint32_t magic1 = readUint32(buffer, offset);
+    uint32_t magic2 = readUint32(buffer, offset);
+    uint16_t version = readUint16(buffer, offset);
+    uint16_t numColumns = readUint16(buffer, offset);
+    uint32_t numSamples = readUint32(buffer, offset);
+    uint32_t dlogFileSize = readUint32(buffer, offset);
+
+    // pyramid is valid only if it matches DLOG file exactly
+    if (magic1 != MAGIC1 || magic2 != PYRAMID_MAGIC2 || version != PYRAMID_VERSION ||
+        numColumns != g_recording.parameters.numYAxes || numSamples != g_recording.numSamples ||
+        dlogFileSize != dlogFile.size()) {
+        return false;
+    }
+
+    g_pyramidNumSamples = numSamples;
+
+    return true;
+}
+
+static void loadBlockFromPyramid(unsigned numSamplesPerValue) {
+    char pyramidFilePath[MAX_PATH_LENGTH + 1];
+    getPyramidFilePath(g_filePath, pyramidFilePath);
+
+    File file;
+    if (!file.open(pyramidFilePath, FILE_OPEN_EXISTING | FILE_READ)) {
+        // fallback to the DLOG file
+        g_pyramidAvailable = false;
+        return;
+    }
+
+    // find the coarsest level with at least one entry per value
+    int levelIndex = 0;
+    while (levelIndex + 1 < PYRAMID_NUM_LEVELS && getPyramidLevelFactor(levelIndex + 1) <= numSamplesPerValue) {
+        levelIndex++;
+    }
+
+    uint32_t levelFactor = getPyramidLevelFactor(levelIndex);
+    uint32_t numLevelEntries = (g_pyramidNumSamples + levelFactor - 1) / levelFactor;
+    uint32_t numYAxes = g_recording.parameters.numYAxes;
+    uint32_t levelBlockSize = PYRAMID_BLOCK_NUM_ENTRIES * numYAxes * sizeof(BlockElement);
+    uint32_t loadedLevelBlockIndex = 0xFFFFFFFF;
+
+    auto numElementsPerRow = getNumElementsPerRow();
+
+    BlockElement *blockElements = getCacheBlock(g_blockIndexToLoad);
+
+    uint32_t totalBytesRead = 0;
+
+    uint32_t i = g_cacheBlocks[g_blockIndexToLoad].loadedValues;
+    while (i < NUM_ELEMENTS_PER_BLOCKS) {
+        if (g_interruptLoading) {
+            break;
+        }
+
+        uint32_t sampleIndex = (uint32_t)ceilf((g_cacheBlocks[g_blockIndexToLoad].startAddress / sizeof(BlockElement) + i) / numElementsPerRow * g_loadScale);
+        uint32_t entryStart = sampleIndex / levelFactor;
+        uint32_t entryEnd = MIN((sampleIndex + numSamplesPerValue + levelFactor - 1) / levelFactor, numLevelEntries);
+        if (entryStart >= entryEnd) {
+            i = NUM_ELEMENTS_PER_BLOCKS;
+            break;
+        }
+
+        for (uint32_t entryIndex = entryStart; entryIndex < entryEnd; entryIndex++) {
+            uint32_t levelBlockIndex = entryIndex / PYRAMID_BLOCK_NUM_ENTRIES;
+            if (levelBlockIndex != loadedLevelBlockIndex) {
+                uint32_t filePosition = PYRAMID_HEADER_SIZE + getPyramidBlockIndex(levelIndex, levelBlockIndex, g_pyramidNumSamples) * levelBlockSize;
+                if (!file.seek(filePosition) || file.read(g_pyramidBlock, levelBlockSize) != levelBlockSize) {
+                    i = NUM_ELEMENTS_PER_BLOCKS;
+                    goto closeFile;
+                }
+                totalBytesRead += levelBlockSize;
+                loadedLevelBlockIndex = levelBlockIndex;
+            }
+
+            BlockElement *entry = g_pyramidBlock + (entryIndex % PYRAMID_BLOCK_NUM_ENTRIES) * numYAxes;
+
+            for (unsigned k = 0; k < numElementsPerRow && i + k < NUM_ELEMENTS_PER_BLOCKS; k++) {
+                BlockElement *blockElement = blockElements + i + k;
+                if (entryIndex == entryStart) {
+                    *blockElement = entry[k];
+                } else {
+                    if (entry[k].min < blockElement->min) {
+                        blockElement->min = entry[k].min;
+                    }
+                    if (entry[k].max > blockElement->max) {
+                        blockElement->max = entry[k].max;
+                    }
+                }
+            }
+        }
+
+        i += numElementsPerRow;
+
+        if (totalBytesRead > NUM_ELEMENTS_PER_BLOCKS * sizeof(BlockElement)) {
+            break;
+        }
+
+        g_refreshed = true;
+    }
+
+closeFile:
+    g_cacheBlocks[g_blockIndexToLoad].loadedValues = i;
+    file.close();
+}
+
 void loadBlock() {
     static const int NUM_VALUES_ROWS = 16;
     float values[18 * NUM_VALUES_ROWS];
 
     auto numSamplesPerValue = (unsigned)round(g_loadScale);
+    if (g_pyramidAvailable && numSamplesPerValue >= PYRAMID_BASE_FACTOR) {
+        loadBlockFromPyramid(numSamplesPerValue);
+        if (g_pyramidAvailable) {
+            g_isLoading = false;
+            g_refreshed = true;
+            return;
+        }
+    }
+
     if (numSamplesPerValue > 0) {
         File file;
         if (file.open(g_filePath, FILE_OPEN_EXISTING | FILE_READ)) {
@@ -153,15 +596,9 @@ void loadBlock() {
 
             uint32_t i = g_cacheBlocks[g_blockIndexToLoad].loadedValues;
             while (i < NUM_ELEMENTS_PER_BLOCKS) {
-                auto offset = (uint32_t)roundf((g_blockIndexToLoad * NUM_ELEMENTS_PER_BLOCKS + i) / numElementsPerRow * g_loadScale * g_recording.parameters.numYAxes);
+                auto offset = (uint32_t)roundf((g_cacheBlocks[g_blockIndexToLoad].startAddress / sizeof(BlockElement) + i) / numElementsPerRow * g_loadScale * g_recording.parameters.numYAxes);
 
-                offset = g_recording.parameters.numYAxes *((offset + g_recording.parameters.numYAxes - 1) / g_recording.parameters.numYAxes);
-
-                size_t filePosition = g_recording.dataOffset + offset * sizeof(float);
-                if (!file.seek(filePosition)) {
-                    i = NUM_ELEMENTS_PER_BLOCKS;
-                    goto closeFile;
-                }
+                uint32_t rowIndex = (offset + g_recording.parameters.numYAxes - 1) / g_recording.parameters.numYAxes;
 
                 unsigned iStart = i;
 
@@ -172,19 +609,21 @@ void loadBlock() {
 
                     if (valuesRow == 0) {
                         if (g_interruptLoading) {
-                            i = NUM_ELEMENTS_PER_BLOCKS;
+                            // partially loaded value is loaded again next time
+                            i = iStart;
                             goto closeFile;
                         }
 
                         // read up to NUM_VALUES_ROWS
-                        uint32_t bytesToRead = MIN(NUM_VALUES_ROWS, numSamplesPerValue - j) * g_recording.parameters.numYAxes * sizeof(float);
-                        uint32_t bytesRead = file.read(values, bytesToRead);
-                        if (bytesToRead != bytesRead) {
+                        uint32_t numRowsToRead = MIN(NUM_VALUES_ROWS, numSamplesPerValue - j);
+                        uint32_t numRowsRead = readRows(file, rowIndex, values, numRowsToRead);
+                        if (numRowsToRead != numRowsRead) {
                             i = NUM_ELEMENTS_PER_BLOCKS;
                             goto closeFile;
                         }
 
-                        totalBytesRead += bytesRead;
+                        rowIndex += numRowsRead;
+                        totalBytesRead += numRowsRead * g_recording.parameters.numYAxes * sizeof(float);
                     }
 
                     unsigned valuesOffset = valuesRow * g_recording.parameters.numYAxes;
@@ -230,6 +669,10 @@ void stateManagment() {
     }
     g_wasExecuting = isExecuting;
 
+    if (psu::gui::isPageOnStack(PAGE_ID_DLOG_VIEW)) {
+        prefetchBlocks();
+    }
+
     if (g_refreshed) {
         ++g_recording.refreshCounter;
         g_refreshed = false;
@@ -239,32 +682,13 @@ void stateManagment() {
 float getValue(uint32_t rowIndex, uint8_t columnIndex, float *max) {
     uint32_t blockElementAddress = (rowIndex * getNumElementsPerRow() + columnIndex) * sizeof(BlockElement);
 
-    uint32_t blockIndex = blockElementAddress / BLOCK_SIZE;
-    uint32_t blockStartAddress = blockIndex * BLOCK_SIZE;
+    uint32_t blockStartAddress = (blockElementAddress / BLOCK_SIZE) * BLOCK_SIZE;
 
-    blockIndex %= NUM_BLOCKS;
+    unsigned blockIndex = getCacheBlockIndex(blockStartAddress, getLoadScale());
 
     BlockElement *blockElements = getCacheBlock(blockIndex);
 
-    if (!(g_cacheBlocks[blockIndex].valid && g_cacheBlocks[blockIndex].startAddress == blockStartAddress)) {
-        for (unsigned i = 0; i < NUM_ELEMENTS_PER_BLOCKS; i++) {
-            blockElements[i].min = NAN;
-            blockElements[i].max = NAN;
-        }
-
-        g_cacheBlocks[blockIndex].valid = 1;
-        g_cacheBlocks[blockIndex].loadedValues = 0;
-        g_cacheBlocks[blockIndex].startAddress = blockStartAddress;
-    }
-
-    if (g_cacheBlocks[blockIndex].loadedValues < NUM_ELEMENTS_PER_BLOCKS && !g_isLoading) {
-        g_isLoading = true;
-        g_interruptLoading = false;
-        g_blockIndexToLoad = blockIndex;
-        g_loadScale = g_recording.xAxisDiv / g_recording.xAxisDivMin;
-
-        sendMessageToLowPriorityThread(THREAD_MESSAGE_DLOG_LOAD_BLOCK);
-    }
+    requestCacheBlock(blockIndex);
 
     uint32_t blockElementIndex = (blockElementAddress % BLOCK_SIZE) / sizeof(BlockElement);
 
@@ -280,6 +704,46 @@ float getValue(uint32_t rowIndex, uint8_t columnIndex, float *max) {
     return blockElement->min;
 }
 
+void getValues(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max) {
+    unsigned numElementsPerRow = getNumElementsPerRow();
+    float loadScale = getLoadScale();
+
+    // consecutive rows are mostly in the same cache block,
+    // so block lookup is done only when block start address changes
+    uint32_t currentBlockStartAddress = 0xFFFFFFFF;
+    BlockElement *blockElements = nullptr;
+
+    for (uint32_t i = 0; i < numRows; i++) {
+        uint32_t blockElementAddress = ((rowIndex + i) * numElementsPerRow + columnIndex) * sizeof(BlockElement);
+
+        uint32_t blockStartAddress = (blockElementAddress / BLOCK_SIZE) * BLOCK_SIZE;
+
+        if (blockStartAddress != currentBlockStartAddress) {
+            unsigned blockIndex = getCacheBlockIndex(blockStartAddress, loadScale);
+            blockElements = getCacheBlock(blockIndex);
+            requestCacheBlock(blockIndex);
+            currentBlockStartAddress = blockStartAddress;
+        }
+
+        BlockElement *blockElement = blockElements + (blockElementAddress % BLOCK_SIZE) / sizeof(BlockElement);
+
+        min[i] = blockElement->min;
+        if (max) {
+            max[i] = blockElement->max;
+        }
+    }
+
+    if (g_recording.parameters.yAxisScale == SCALE_LOGARITHMIC) {
+        float logOffset = 1 - g_recording.parameters.yAxes[columnIndex].range.min;
+        for (uint32_t i = 0; i < numRows; i++) {
+            min[i] = log10f(logOffset + min[i]);
+            if (max) {
+                max[i] = log10f(logOffset + max[i]);
+            }
+        }
+    }
+}
+
 void adjustXAxisOffset(Recording &recording) {
     auto duration = getDuration(recording);
     if (recording.xAxisOffset + recording.pageSize * recording.parameters.period > duration) {
@@ -317,6 +781,7 @@ void changeXAxisOffset(Recording &recording, float xAxisOffset) {
     if (&dlog_view::g_recording == &recording) {
         float newXAxisOffset = xAxisOffset;
         if (newXAxisOffset != recording.xAxisOffset) {
+            g_scrollDirection = newXAxisOffset > recording.xAxisOffset ? 1 : -1;
             recording.xAxisOffset = newXAxisOffset;
             adjustXAxisOffset(recording);
         }
@@ -339,7 +804,9 @@ void changeXAxisDiv(Recording &recording, float xAxisDiv) {
         
         adjustXAxisOffset(recording);
 
-        invalidateAllBlocks();
+        // blocks loaded at other scales stay in the cache,
+        // just stop loading the block which is not visible anymore
+        g_interruptLoading = true;
     }
 }
 
@@ -584,7 +1051,7 @@ bool openFile(const char *filePath, int *err) {
             uint32_t magic2 = readUint32(buffer, offset);
             uint16_t version = readUint16(buffer, offset);
 
-            if (magic1 == MAGIC1 && magic2 == MAGIC2 && (version == VERSION1 || version == VERSION2)) {
+            if (magic1 == MAGIC1 && magic2 == MAGIC2 && (version == VERSION1 || version == VERSION2 || version == VERSION3)) {
                 bool invalidHeader = false;
 
                 if (version == VERSION1) {
@@ -723,7 +1190,18 @@ bool openFile(const char *filePath, int *err) {
 
                     g_recording.pageSize = VIEW_WIDTH;
 
-                    g_recording.numSamples = (file.size() - g_recording.dataOffset) / (g_recording.parameters.numYAxes * sizeof(float));
+                    g_recording.parameters.compression = version == VERSION3;
+                    g_decodedBlock.valid = false;
+                    if (g_recording.parameters.compression) {
+                        // number of samples is taken from the last block
+                        g_numDataBlocks = (file.size() - g_recording.dataOffset) / DLOG_V3_BLOCK_SIZE;
+                        g_recording.numSamples = 0;
+                        if (g_numDataBlocks > 0 && decodeDataBlock(file, g_numDataBlocks - 1)) {
+                            g_recording.numSamples = g_decodedBlock.firstRowIndex + g_decodedBlock.numRows;
+                        }
+                    } else {
+                        g_recording.numSamples = (file.size() - g_recording.dataOffset) / (g_recording.parameters.numYAxes * sizeof(float));
+                    }
                     g_recording.xAxisDivMin = g_recording.pageSize * g_recording.parameters.period / dlog_view::NUM_HORZ_DIVISIONS;
                     g_recording.xAxisDivMax = MAX(g_recording.numSamples, g_recording.pageSize) * g_recording.parameters.period / dlog_view::NUM_HORZ_DIVISIONS;
 
@@ -735,8 +1213,11 @@ bool openFile(const char *filePath, int *err) {
                     g_recording.cursorOffset = VIEW_WIDTH / 2;
 
                     g_recording.getValue = getValue;
+                    g_recording.getValues = getValues;
                     g_isLoading = false;
 
+                    g_pyramidAvailable = openPyramid(file);
+
                     if (isMulipleValuesOverlayHeuristic(g_recording)) {
                         autoScale(g_recording);
                     }
@@ -811,6 +1292,54 @@ void uploadFile() {
     psu::scpi::mmemUpload(g_filePath, context, &err);
 }
 
+bool getPyramidFilePath(const char *filePath, char *pyramidFilePath) {
+    const char *ext = strrchr(filePath, '.');
+    const char *sep = strrchr(filePath, '/');
+    size_t len = ext && (!sep || ext > sep) ? ext - filePath : strlen(filePath);
+    if (len + strlen(PYRAMID_EXT) > MAX_PATH_LENGTH) {
+        return false;
+    }
+    memcpy(pyramidFilePath, filePath, len);
+    strcpy(pyramidFilePath + len, PYRAMID_EXT);
+    return true;
+}
+
+uint32_t getPyramidLevelFactor(int levelIndex) {
+    uint32_t factor = PYRAMID_BASE_FACTOR;
+    for (int i = 0; i < levelIndex; i++) {
+        factor *= PYRAMID_LEVEL_FACTOR;
+    }
+    return factor;
+}
+
+uint32_t getPyramidBlockIndex(int levelIndex, uint32_t blockIndex, uint32_t numSamples) {
+    uint32_t index = 0;
+
+    // block is completed when this many samples are recorded
+    uint32_t numBlockSamples = PYRAMID_BLOCK_NUM_ENTRIES * getPyramidLevelFactor(levelIndex);
+    uint32_t completedAt = (blockIndex + 1) * numBlockSamples;
+
+    if (completedAt <= numSamples) {
+        // count all the blocks completed before this one, blocks completed at the same
+        // time are written from the lowest to the highest level
+        for (int i = 0; i < PYRAMID_NUM_LEVELS; i++) {
+            index += (completedAt - 1) / (PYRAMID_BLOCK_NUM_ENTRIES * getPyramidLevelFactor(i));
+        }
+        index += levelIndex;
+    } else {
+        // partial block, they are written at the end from the lowest to the highest level
+        for (int i = 0; i < PYRAMID_NUM_LEVELS; i++) {
+            uint32_t numLevelBlockSamples = PYRAMID_BLOCK_NUM_ENTRIES * getPyramidLevelFactor(i);
+            index += numSamples / numLevelBlockSamples;
+            if (i < levelIndex && numSamples % numLevelBlockSamples) {
+                index++;
+            }
+        }
+    }
+
+    return index;
+}
+
 } // namespace dlog_view
 } // namespace psu
 } // namespace eez
@@ -23,6 +23,8 @@
 #include <eez/modules/psu/trigger.h>
 #include <eez/modules/psu/dlog_view.h>
 
+#define PYRAMID_EXT ".dlx"
+
 /* DLOG File Format
 
 OFFSET    TYPE    WIDTH    DESCRIPTION
@@ -53,6 +55,61 @@ OFFSET    TYPE    WIDTH    DESCRIPTION
 28+(n*N+m)*4    Float   4        n-th row and m-th column value, N - number of columns
 */
 
+/* DLOG Compressed Data Format (VERSION3)
+
+Header and meta fields are the same as in VERSION2. Data, starting at data offset, is split
+in fixed size blocks of DLOG_V3_BLOCK_SIZE bytes, so block b is at data offset + b * DLOG_V3_BLOCK_SIZE
+and, since every block starts with the index of its first row, blocks headers are used as index
+for the random access (binary search). Only the last block can be partial. Each block is decoded
+independently of the other blocks.
+
+OFFSET    TYPE    WIDTH    DESCRIPTION
+----------------------------------------------------------------------
+0               U32     4        Index of the first row in block
+
+4               U16     2        R - number of rows in block
+
+6               U16     2        Number of used bytes in block (header included)
+
+8               Bits    ...      Values, bit stream (MSB first), row by row:
+                                 first row - 32 bits for each column value,
+                                 other rows - for each column, XOR with the previous value in the same column:
+                                    '0'  - XOR is 0, i.e. same value
+                                    '10' - meaningful bits of XOR fit inside previous window,
+                                           followed by the meaningful bits
+                                    '11' - new window: 5 bits number of leading zeros,
+                                           5 bits number of meaningful bits minus 1,
+                                           followed by the meaningful bits
+*/
+
+/* DLOG Pyramid File Format
+
+Sidecar file (same name as DLOG file but with PYRAMID_EXT extension) with multi-resolution
+min/max levels, written by dlog_record while recording. Level k has one entry per
+PYRAMID_BASE_FACTOR * PYRAMID_LEVEL_FACTOR^k samples, entry is min/max pair (2 x Float)
+for each of N columns. Each level is split in blocks of PYRAMID_BLOCK_NUM_ENTRIES entries,
+blocks are stored in the order they were completed while recording (see getPyramidBlockIndex),
+the last (partial) block of each level is at the end of the file.
+
+OFFSET    TYPE    WIDTH    DESCRIPTION
+----------------------------------------------------------------------
+0               U32     4        MAGIC1 = 0x2D5A4545L
+
+4               U32     4        PYRAMID_MAGIC2 = 0x52594D50L
+
+8               U16     2        PYRAMID_VERSION = 0x0001L
+
+10              U16     2        N - number of columns
+
+12              U32     4        Number of samples
+
+16              U32     4        DLOG file size
+
+20              U32     12       Reserved
+
+32+b*B*N*8      Float   B*N*8    b-th block, B - PYRAMID_BLOCK_NUM_ENTRIES
+*/
+
 namespace eez {
 namespace psu {
 namespace dlog_view {
@@ -61,8 +118,21 @@ static const uint32_t MAGIC1 = 0x2D5A4545;
 static const uint32_t MAGIC2 = 0x474F4C44;
 static const uint16_t VERSION1 = 1;
 static const uint16_t VERSION2 = 2;
+static const uint16_t VERSION3 = 3;
 static const uint32_t DLOG_VERSION1_HEADER_SIZE = 28;
 
+static const uint32_t DLOG_V3_BLOCK_SIZE = 512;
+static const uint32_t DLOG_V3_BLOCK_HEADER_SIZE = 8;
+static const uint32_t DLOG_V3_BLOCK_MAX_NUM_VALUES = 2048; // max. number of rows * number of columns in one block
+
+static const uint32_t PYRAMID_MAGIC2 = 0x52594D50;
+static const uint16_t PYRAMID_VERSION = 1;
+static const uint32_t PYRAMID_HEADER_SIZE = 32;
+static const int PYRAMID_NUM_LEVELS = 8;
+static const uint32_t PYRAMID_BASE_FACTOR = 16;
+static const uint32_t PYRAMID_LEVEL_FACTOR = 4;
+static const uint32_t PYRAMID_BLOCK_NUM_ENTRIES = 32;
+
 static const int VIEW_WIDTH = 480;
 static const int VIEW_HEIGHT = 240;
 
@@ -127,6 +197,11 @@ struct Range {
     float max;
 };
 
+struct BlockElement {
+    float min;
+    float max;
+};
+
 static const int MAX_LABEL_LENGTH = 32;
 
 enum Scale {
@@ -167,6 +242,7 @@ struct Parameters {
     float period;
     float time;
     trigger::Source triggerSource;
+    bool compression; // use VERSION3 file format
 };
 
 struct DlogValueParams {
@@ -191,6 +267,7 @@ struct Recording {
     uint32_t cursorOffset;
 
     float (*getValue)(uint32_t rowIndex, uint8_t columnIndex, float *max);
+    void (*getValues)(uint32_t rowIndex, uint32_t numRows, uint8_t columnIndex, float *min, float *max);
 
     uint32_t refreshCounter;
 
@@ -242,6 +319,14 @@ float roundValue(float value);
 
 void uploadFile();
 
+bool getPyramidFilePath(const char *filePath, char *pyramidFilePath);
+
+// number of samples covered by one entry of the pyramid level
+uint32_t getPyramidLevelFactor(int levelIndex);
+
+// position of the level block inside pyramid file, in blocks
+uint32_t getPyramidBlockIndex(int levelIndex, uint32_t blockIndex, uint32_t numSamples);
+
 } // namespace dlog_view
 } // namespace psu
 } // namespace eez
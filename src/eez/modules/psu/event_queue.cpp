@@ -16,6 +16,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+
 #include <eez/modules/psu/psu.h>
 
 #include <scpi/scpi.h>
@@ -55,11 +57,11 @@ static const int EVENTS_PER_PAGE = 8;
 static const int CONF_EVENT_LINE_WIDTH_PX = 448;
 
 static const char *LOG_FILE_NAME = "log.txt";
+static const char *LOG_RECORDS_FILE_NAME = "log.bin";
+static const char *LOG_INDEX_FILE_NAME = "log.idx";
 
-static const char *LOG_DEBUG_INDEX_FILE_NAME   = "index1";
-static const char *LOG_INFO_INDEX_FILE_NAME    = "index2";
-static const char *LOG_WARNING_INDEX_FILE_NAME = "index3";
-static const char *LOG_ERROR_INDEX_FILE_NAME   = "index4";
+// index files used by the older firmware versions, see importTextLog
+static const char *OLD_LOG_INDEX_FILE_NAMES[] = { "index1", "index2", "index3", "index4" };
 
 static const char *EVENT_TYPE_NAMES[] = {
     "NONE",
@@ -69,23 +71,55 @@ static const char *EVENT_TYPE_NAMES[] = {
     "ERROR"
 };
 
-static const int WRITE_QUEUE_MAX_SIZE = 50;
+static const uint32_t WRITE_QUEUE_SIZE = 256; // must be power of 2
 static const size_t EVENT_MESSAGE_MAX_SIZE = 256;
 
+// without SD card write queue is the only storage, so the oldest events are
+// dropped to keep this many slots free for the new events
+static const uint32_t WRITE_QUEUE_NUM_FREE_SLOTS_WITHOUT_SD_CARD = 16;
+
+static const int NUM_DEBUG_TRACE_MESSAGES = 16;
+static const uint8_t NO_DEBUG_TRACE_MESSAGE = 0xFF;
+
 ////////////////////////////////////////////////////////////////////////////////
+// Write queue
+//
+// Bounded lock-free multiple producers / single consumer queue (D. Vyukov algorithm).
+// Events are pushed from any thread (PSU thread during protection handling, SCPI, GUI ...)
+// and the low priority thread is the only consumer. Every slot has a sequence number:
+// slot at the position P is free for the producer when sequence == P and it holds
+// the published event when sequence == P + 1. If queue is full the new event is dropped.
+//
+// Only the debug trace has the message text, it is stored in one of
+// NUM_DEBUG_TRACE_MESSAGES buffers allocated with the atomic bit mask.
 
 struct QueueEvent {
     uint32_t dateTime;
     int16_t eventId;
-    int16_t channelIndex;
-    char message[EVENT_MESSAGE_MAX_SIZE];
+    int8_t channelIndex;
+    uint8_t messageIndex;
 };
-static QueueEvent g_writeQueue[WRITE_QUEUE_MAX_SIZE];
-static uint8_t g_writeQueueHead = 0;
-static uint8_t g_writeQueueTail = 0;
-static bool g_writeQueueFull;
-osMutexId(g_writeQueueMutexId);
-osMutexDef(g_writeQueueMutex);
+
+struct QueueSlot {
+    std::atomic<uint32_t> sequence;
+    QueueEvent event;
+};
+
+static QueueSlot g_writeQueue[WRITE_QUEUE_SIZE];
+static std::atomic<uint32_t> g_writeQueueEnqueuePosition;
+static std::atomic<uint32_t> g_writeQueueDequeuePosition;
+
+static char g_debugTraceMessages[NUM_DEBUG_TRACE_MESSAGES][EVENT_MESSAGE_MAX_SIZE];
+static std::atomic<uint32_t> g_debugTraceMessagesAllocated;
+
+static std::atomic<uint32_t> g_numDroppedEvents;
+static std::atomic<uint32_t> g_writeQueueHighWaterMark;
+
+// updated only by the consumer
+static uint32_t g_numLoggedDroppedEvents;
+static uint32_t g_numCollapsedEvents;
+static uint32_t g_numBatches;
+static uint32_t g_maxBatchSize;
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -116,10 +150,10 @@ static int g_selectedEventIndex = -1;
 ////////////////////////////////////////////////////////////////////////////////
 
 static void addEventToWriteQueue(int16_t eventId, char *message, int channelIndex);
-static bool getEventFromWriteQueue(QueueEvent *queueEvent);
+static bool dequeueEvent(QueueEvent &queueEvent);
+static void freeDebugTraceMessage(uint8_t messageIndex);
 
-static void getIndexFilePath(int indexType, char *filePath);
-static void getLogFilePath(char *filePath);
+static void getLogFilePath(const char *fileName, char *filePath);
 
 static int getEventType(int16_t eventId);
 
@@ -127,7 +161,10 @@ static void setDisplayFromPosition(uint32_t position);
 
 static void refreshEvents();
 
-static void writeEvent(QueueEvent *event);
+static void invalidateIndex();
+static bool importTextLog();
+static bool writeRecord(File &logFile, File &indexFile, uint32_t &logOffset, const QueueEvent &event, const char *debugMessage, uint16_t eventCount, int eventType);
+static bool writeEvents();
 static void readEvents(uint32_t fromPosition);
 
 static Event *getEvent(uint32_t eventIndex);
@@ -136,22 +173,41 @@ static Event *getEvent(uint32_t eventIndex);
 
 void init() {
     g_refreshEvents = true;
-    g_writeQueueMutexId = osMutexCreate(osMutex(g_writeQueueMutex));
+
+    for (uint32_t i = 0; i < WRITE_QUEUE_SIZE; i++) {
+        g_writeQueue[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    g_writeQueueEnqueuePosition.store(0, std::memory_order_relaxed);
+    g_writeQueueDequeuePosition.store(0, std::memory_order_release);
 }
 
 void tick() {
     bool isSdCardMounted = sd_card::isMounted(nullptr);
     if (isSdCardMounted != g_isSdCardMounted) {
         g_refreshEvents = true;
+
+        // it could be a different card
+        invalidateIndex();
+        memset(g_events, 0, sizeof(g_events));
     }
     g_isSdCardMounted = isSdCardMounted;
 
     if (g_isSdCardMounted) {
-        QueueEvent queueEvent;
-        if (getEventFromWriteQueue(&queueEvent)) {
-            writeEvent(&queueEvent);
+        if (writeEvents()) {
             g_previousDisplayFromPosition = -1;
         }
+    } else {
+        // events are only displayed from the write queue, discard the oldest ones
+        // so there is always room for the new events
+        uint32_t dequeuePosition = g_writeQueueDequeuePosition.load(std::memory_order_relaxed);
+        while (g_writeQueueEnqueuePosition.load(std::memory_order_relaxed) - dequeuePosition > WRITE_QUEUE_SIZE - WRITE_QUEUE_NUM_FREE_SLOTS_WITHOUT_SD_CARD) {
+            QueueEvent queueEvent;
+            if (!dequeueEvent(queueEvent)) {
+                break;
+            }
+            freeDebugTraceMessage(queueEvent.messageIndex);
+            dequeuePosition++;
+        }
     }
 
 #if OPTION_DISPLAY
@@ -170,10 +226,17 @@ void tick() {
 }
 
 void shutdownSave() {
-    QueueEvent queueEvent;
-    while (getEventFromWriteQueue(&queueEvent)) {
-        writeEvent(&queueEvent);
-    }
+    writeEvents();
+}
+
+void getWriteQueueStatistics(WriteQueueStatistics &statistics) {
+    statistics.size = WRITE_QUEUE_SIZE;
+    statistics.numQueued = g_writeQueueEnqueuePosition.load(std::memory_order_relaxed) - g_writeQueueDequeuePosition.load(std::memory_order_relaxed);
+    statistics.highWaterMark = g_writeQueueHighWaterMark.load(std::memory_order_relaxed);
+    statistics.numDropped = g_numDroppedEvents.load(std::memory_order_relaxed);
+    statistics.numCollapsed = g_numCollapsedEvents;
+    statistics.numBatches = g_numBatches;
+    statistics.maxBatchSize = g_maxBatchSize;
 }
 
 int16_t getLastErrorEventId() {
@@ -335,77 +398,121 @@ void onEncoder(int counter) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-static bool getEventFromWriteQueue(QueueEvent *queueEvent) {
-    bool result = false;
+static uint8_t allocDebugTraceMessage(const char *message) {
+    uint32_t allocated = g_debugTraceMessagesAllocated.load(std::memory_order_relaxed);
+    for (;;) {
+        int messageIndex;
+        for (messageIndex = 0; messageIndex < NUM_DEBUG_TRACE_MESSAGES; messageIndex++) {
+            if (!(allocated & (1 << messageIndex))) {
+                break;
+            }
+        }
+
+        if (messageIndex == NUM_DEBUG_TRACE_MESSAGES) {
+            return NO_DEBUG_TRACE_MESSAGE;
+        }
 
-    if (osMutexWait(g_writeQueueMutexId, 5) == osOK) {
-		if (g_writeQueueFull || g_writeQueueTail != g_writeQueueHead) {
-			memcpy(queueEvent, &g_writeQueue[g_writeQueueTail], sizeof(QueueEvent));
-			g_writeQueueTail = (g_writeQueueTail + 1) % WRITE_QUEUE_MAX_SIZE;
-			g_writeQueueFull = false;
-			result = true;
-		}
+        if (g_debugTraceMessagesAllocated.compare_exchange_weak(allocated, allocated | (1 << messageIndex), std::memory_order_acquire, std::memory_order_relaxed)) {
+            strncpy(g_debugTraceMessages[messageIndex], message, EVENT_MESSAGE_MAX_SIZE - 1);
+            g_debugTraceMessages[messageIndex][EVENT_MESSAGE_MAX_SIZE - 1] = 0;
+            return (uint8_t)messageIndex;
+        }
+    }
+}
 
-		osMutexRelease(g_writeQueueMutexId);
+static void freeDebugTraceMessage(uint8_t messageIndex) {
+    if (messageIndex != NO_DEBUG_TRACE_MESSAGE) {
+        g_debugTraceMessagesAllocated.fetch_and(~(1 << messageIndex), std::memory_order_release);
     }
+}
 
-    return result;
+static const char *getDebugTraceMessage(const QueueEvent &queueEvent) {
+    return queueEvent.messageIndex != NO_DEBUG_TRACE_MESSAGE ? g_debugTraceMessages[queueEvent.messageIndex] : "";
 }
 
-static void addEventToWriteQueue(int16_t eventId, char *message, int channelIndex) {
-    if (osMutexWait(g_writeQueueMutexId, 5) == osOK) {
-        g_writeQueue[g_writeQueueHead].dateTime = datetime::now();
-        g_writeQueue[g_writeQueueHead].eventId = eventId;
-        g_writeQueue[g_writeQueueHead].channelIndex = channelIndex;
+static void updateWriteQueueHighWaterMark(uint32_t numQueued) {
+    uint32_t highWaterMark = g_writeQueueHighWaterMark.load(std::memory_order_relaxed);
+    while (numQueued > highWaterMark && !g_writeQueueHighWaterMark.compare_exchange_weak(highWaterMark, numQueued, std::memory_order_relaxed)) {
+    }
+}
 
-        if (message) {
-            strcpy(g_writeQueue[g_writeQueueHead].message, message);
+static bool enqueueEvent(const QueueEvent &queueEvent) {
+    uint32_t position = g_writeQueueEnqueuePosition.load(std::memory_order_relaxed);
+
+    QueueSlot *slot;
+    for (;;) {
+        slot = &g_writeQueue[position & (WRITE_QUEUE_SIZE - 1)];
+        uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(sequence - position);
+        if (diff == 0) {
+            if (g_writeQueueEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // queue is full
+            return false;
         } else {
-            g_writeQueue[g_writeQueueHead].message[0] = 0;
-        }
-
-        if (g_writeQueueFull) {
-            g_writeQueueTail = (g_writeQueueTail + 1) % WRITE_QUEUE_MAX_SIZE;    
+            position = g_writeQueueEnqueuePosition.load(std::memory_order_relaxed);
         }
+    }
 
-        g_writeQueueHead = (g_writeQueueHead + 1) % WRITE_QUEUE_MAX_SIZE;
+    slot->event = queueEvent;
+    slot->sequence.store(position + 1, std::memory_order_release);
 
-        if (g_writeQueueHead == g_writeQueueTail) {
-            g_writeQueueFull = true;
-        }
+    updateWriteQueueHighWaterMark(position + 1 - g_writeQueueDequeuePosition.load(std::memory_order_relaxed));
 
-        if (!g_isSdCardMounted) {
-            g_refreshEvents = true;
-        }
+    return true;
+}
 
-        osMutexRelease(g_writeQueueMutexId);
+// must be called only from the low priority thread
+static bool dequeueEvent(QueueEvent &queueEvent) {
+    uint32_t position = g_writeQueueDequeuePosition.load(std::memory_order_relaxed);
+    QueueSlot &slot = g_writeQueue[position & (WRITE_QUEUE_SIZE - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+        return false;
     }
 
-    if (isLowPriorityThread()) {
-        tick();
-    }
+    queueEvent = slot.event;
+
+    slot.sequence.store(position + WRITE_QUEUE_SIZE, std::memory_order_release);
+    g_writeQueueDequeuePosition.store(position + 1, std::memory_order_relaxed);
+
+    return true;
 }
 
-static void getIndexFilePath(int indexType, char *filePath) {
-    strcpy(filePath, LOGS_DIR);
+// Returns event at the given queue position without removing it, if it is published.
+// Must be called only from the low priority thread.
+static const QueueEvent *peekEvent(uint32_t position) {
+    const QueueSlot &slot = g_writeQueue[position & (WRITE_QUEUE_SIZE - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+        return nullptr;
+    }
+    return &slot.event;
+}
 
-    strcat(filePath, PATH_SEPARATOR);
+static void addEventToWriteQueue(int16_t eventId, char *message, int channelIndex) {
+    QueueEvent queueEvent;
+    queueEvent.dateTime = datetime::now();
+    queueEvent.eventId = eventId;
+    queueEvent.channelIndex = (int8_t)channelIndex;
+    queueEvent.messageIndex = message ? allocDebugTraceMessage(message) : NO_DEBUG_TRACE_MESSAGE;
+
+    if ((message && queueEvent.messageIndex == NO_DEBUG_TRACE_MESSAGE) || !enqueueEvent(queueEvent)) {
+        freeDebugTraceMessage(queueEvent.messageIndex);
+        g_numDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+    } else if (!g_isSdCardMounted) {
+        g_refreshEvents = true;
+    }
 
-    if (indexType == EVENT_TYPE_DEBUG) {
-        strcat(filePath, LOG_DEBUG_INDEX_FILE_NAME);
-    } else if (indexType == EVENT_TYPE_INFO) {
-        strcat(filePath, LOG_INFO_INDEX_FILE_NAME);
-    } else if (indexType == EVENT_TYPE_WARNING) {
-        strcat(filePath, LOG_WARNING_INDEX_FILE_NAME);
-    } else {
-        strcat(filePath, LOG_ERROR_INDEX_FILE_NAME);
+    if (isLowPriorityThread()) {
+        tick();
     }
 }
 
-static void getLogFilePath(char *filePath) {
+static void getLogFilePath(const char *fileName, char *filePath) {
     strcpy(filePath, LOGS_DIR);
     strcat(filePath, PATH_SEPARATOR);
-    strcat(filePath, LOG_FILE_NAME);
+    strcat(filePath, fileName);
 }
 
 static int getFilter() {
@@ -472,253 +579,814 @@ static void setDisplayFromPosition(uint32_t position) {
     }
 }
 
-static void refreshEvents() {
-    g_filter = persist_conf::devConf.eventQueueFilter;
-    if (g_filter < EVENT_TYPE_DEBUG || g_filter > EVENT_TYPE_ERROR) {
-        g_filter = EVENT_TYPE_INFO;
-    }
+////////////////////////////////////////////////////////////////////////////////
+// Event log storage
+//
+// Events are stored as binary records (LogRecord) appended to log.bin.
+// Text line for every event is also appended to log.txt, but only for humans,
+// it is read back only by importTextLog.
+//
+// log.idx is a two level index into log.bin, split in blocks of INDEX_BLOCK_SIZE bytes.
+// Every block starts with the number of events, for each filter level, in all the
+// previous blocks, followed by one entry per event with the record offset and
+// the event type. K-th event for the filter is found with a binary search
+// over the block headers and then by scanning a single block. Both files are
+// append only. Last (tail) block is always kept in RAM and few other blocks are cached.
+//
+// Repeated identical events from the same batch are collapsed into a single record,
+// count is the number of the collapsed events.
+//
+// Events logged by the older firmware versions exist only as text lines in log.txt,
+// they are imported once as IMPORTED_EVENT_ID records, see importTextLog.
+//
+// Both log.bin and log.idx start with LogFileHeader. If any of them is missing or has
+// unknown magic or version, both are moved to *.old and a new empty log is started,
+// see checkLogFiles.
+
+struct LogFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+};
 
-    g_displayFromPosition = 0;
-    g_previousDisplayFromPosition = -1;
-    g_selectedEventIndex = -1;
+static const uint32_t LOG_RECORDS_FILE_MAGIC = 0x424C5145; // "EQLB"
+static const uint32_t LOG_INDEX_FILE_MAGIC = 0x494C5145; // "EQLI"
+static const uint16_t LOG_FILE_VERSION = 1;
 
-    if (g_isSdCardMounted) {
-        char filePath[MAX_PATH_LENGTH];
-        getIndexFilePath(g_filter, filePath);
+static const uint32_t LOG_FILE_HEADER_SIZE = sizeof(LogFileHeader);
 
-        File file;
-        if (file.open(filePath, FILE_OPEN_EXISTING | FILE_READ)) {
-            g_numEvents = file.size() / 4;
-            file.close();
+// event type and the message text are stored in the record
+static const int16_t IMPORTED_EVENT_ID = EVENT_TYPE_NONE;
+
+struct LogRecord {
+    uint32_t dateTime;
+    int16_t eventId;
+    int8_t channelIndex;
+    uint8_t messageLength; // debug trace or imported message follows the record
+    uint16_t count;
+    uint8_t eventType;
+    uint8_t reserved;
+};
+
+static const int NUM_FILTER_LEVELS = EVENT_TYPE_ERROR - EVENT_TYPE_DEBUG + 1;
+
+static const uint32_t INDEX_BLOCK_SIZE = 256;
+static const uint32_t INDEX_BLOCK_HEADER_SIZE = NUM_FILTER_LEVELS * sizeof(uint32_t);
+static const uint32_t INDEX_BLOCK_NUM_ENTRIES = (INDEX_BLOCK_SIZE - INDEX_BLOCK_HEADER_SIZE) / sizeof(uint32_t);
+
+static const uint32_t MAX_LOG_OFFSET = 0x3FFFFFFF;
+
+#define INDEX_ENTRY(LOG_OFFSET, EVENT_TYPE) ((((uint32_t)(EVENT_TYPE) - EVENT_TYPE_DEBUG) << 30) | (LOG_OFFSET))
+#define INDEX_ENTRY_LOG_OFFSET(ENTRY) ((ENTRY) & MAX_LOG_OFFSET)
+#define INDEX_ENTRY_EVENT_TYPE(ENTRY) ((int)((ENTRY) >> 30) + EVENT_TYPE_DEBUG)
+
+struct IndexBlock {
+    uint32_t numEventsBefore[NUM_FILTER_LEVELS];
+    uint32_t entries[INDEX_BLOCK_NUM_ENTRIES];
+};
+
+static const int INDEX_BLOCK_CACHE_SIZE = 4;
+static const uint32_t INVALID_BLOCK_INDEX = 0xFFFFFFFF;
+
+struct IndexBlockCacheEntry {
+    uint32_t blockIndex;
+    uint32_t lastUsed;
+    IndexBlock block;
+};
+static IndexBlockCacheEntry g_indexBlockCache[INDEX_BLOCK_CACHE_SIZE];
+static uint32_t g_indexBlockCacheCounter;
+
+static bool g_indexLoaded;
+static uint32_t g_numIndexBlocks; // including the tail block
+static uint32_t g_tailBlockNumEntries;
+static IndexBlock g_tailBlock;
+
+static uint32_t getNumEventsInBlock(const IndexBlock &block, uint32_t numEntries, int filter) {
+    uint32_t numEvents = 0;
+    for (uint32_t i = 0; i < numEntries; i++) {
+        if (INDEX_ENTRY_EVENT_TYPE(block.entries[i]) >= filter) {
+            numEvents++;
         }
+    }
+    return numEvents;
+}
 
-        g_refreshEvents = false;
-    } else {
-        g_numEvents = 0;
-        if (osMutexWait(g_writeQueueMutexId, 5) == osOK) {
-            if (g_writeQueueFull || g_writeQueueTail != g_writeQueueHead) {
-                int i = g_writeQueueFull ? (g_writeQueueHead + 1) % WRITE_QUEUE_MAX_SIZE : g_writeQueueHead;
-                do {
-                    if (i > 0) {
-                        i--;
-                    } else {
-                        i = WRITE_QUEUE_MAX_SIZE - 1;
-                    }
-
-                    if (getEventType(g_writeQueue[i].eventId) >= g_filter) {
-                        g_numEvents++;
-                    }
-
-                } while (i != g_writeQueueTail);
-            }
+static void invalidateIndex() {
+    g_indexLoaded = false;
 
-            g_refreshEvents = false;
-            osMutexRelease(g_writeQueueMutexId);
-        }        
+    for (int i = 0; i < INDEX_BLOCK_CACHE_SIZE; i++) {
+        g_indexBlockCache[i].blockIndex = INVALID_BLOCK_INDEX;
     }
 }
 
-static bool writeToLog(QueueEvent *event, uint32_t &logOffset, int &eventType) {
+static bool createLogFile(const char *fileName, uint32_t magic, File &file) {
     char filePath[MAX_PATH_LENGTH];
-    getLogFilePath(filePath);
+    getLogFilePath(fileName, filePath);
 
-    File file;
-    if (!file.open(filePath, FILE_OPEN_APPEND | FILE_WRITE)) {
+    if (!file.open(filePath, FILE_CREATE_ALWAYS | FILE_WRITE)) {
         return false;
     }
 
-    logOffset = file.size();
+    LogFileHeader header;
+    header.magic = magic;
+    header.version = LOG_FILE_VERSION;
+    header.reserved = 0;
 
-    using namespace sd_card;
-    BufferedFileWrite bufferedFile(file);
+    if (file.write(&header, sizeof(header)) != sizeof(header)) {
+        file.close();
+        return false;
+    }
 
-    int year, month, day, hour, minute, second;
-    datetime::breakTime(event->dateTime, year, month, day, hour, minute, second);
+    return true;
+}
 
-    eventType = getEventType(event->eventId);
+// returns false only if file exists but can't be read,
+// missing file or file with the wrong header is reported through isValid
+static bool checkLogFileHeader(const char *fileName, uint32_t magic, bool &isValid) {
+    char filePath[MAX_PATH_LENGTH];
+    getLogFilePath(fileName, filePath);
 
-    char dateTimeAndEventTypeStr[32];
-    sprintf(dateTimeAndEventTypeStr, "%04d-%02d-%02d %02d:%02d:%02d %s ", year, month, day, hour, minute, second, EVENT_TYPE_NAMES[eventType]);
-    bool result = bufferedFile.write((const uint8_t *)dateTimeAndEventTypeStr, strlen(dateTimeAndEventTypeStr));
+    isValid = false;
 
-    if (result) {
-        if (event->eventId == EVENT_DEBUG_TRACE) {
-            result = bufferedFile.write((const uint8_t *)event->message, strlen(event->message));
-        } else {
-            const char *message = getEventMessage(event->eventId);
-            if (event->channelIndex != -1) {
-                char buffer[128];
-                sprintf(buffer, message, event->channelIndex + 1);
-                result = bufferedFile.write((const uint8_t *)buffer, strlen(buffer));
-            } else {
-                result = bufferedFile.write((const uint8_t *)message, strlen(message));
-            }
-        }
+    if (!sd_card::exists(filePath, nullptr)) {
+        return true;
+    }
 
-        if (result) {
-            result = bufferedFile.write((const uint8_t *)"\n", 1);
-            if (result) {
-                result = bufferedFile.flush();
-            }
-        }
+    File file;
+    if (!file.open(filePath, FILE_OPEN_EXISTING | FILE_READ)) {
+        return false;
     }
 
+    LogFileHeader header;
+    isValid = file.read(&header, sizeof(header)) == sizeof(header) && header.magic == magic && header.version == LOG_FILE_VERSION;
+
     file.close();
 
-    return result;
+    return true;
+}
+
+static bool moveToOldLogFile(const char *fileName) {
+    char filePath[MAX_PATH_LENGTH];
+    getLogFilePath(fileName, filePath);
+
+    if (!sd_card::exists(filePath, nullptr)) {
+        return true;
+    }
+
+    char oldFilePath[MAX_PATH_LENGTH];
+    snprintf(oldFilePath, sizeof(oldFilePath), "%s.old", filePath);
+    oldFilePath[sizeof(oldFilePath) - 1] = 0;
+
+    if (sd_card::exists(oldFilePath, nullptr) && !sd_card::deleteFile(oldFilePath, nullptr)) {
+        return false;
+    }
+
+    return sd_card::moveFile(filePath, oldFilePath, nullptr);
+}
+
+static bool checkLogFiles() {
+    bool isLogFileValid;
+    bool isIndexFileValid;
+    if (
+        !checkLogFileHeader(LOG_RECORDS_FILE_NAME, LOG_RECORDS_FILE_MAGIC, isLogFileValid) ||
+        !checkLogFileHeader(LOG_INDEX_FILE_NAME, LOG_INDEX_FILE_MAGIC, isIndexFileValid)
+    ) {
+        return false;
+    }
+
+    if (isLogFileValid && isIndexFileValid) {
+        return true;
+    }
+
+    // existing files are never overwritten, if they can't be moved log is not used
+    if (!moveToOldLogFile(LOG_RECORDS_FILE_NAME) || !moveToOldLogFile(LOG_INDEX_FILE_NAME)) {
+        return false;
+    }
+
+    File logFile;
+    if (!createLogFile(LOG_RECORDS_FILE_NAME, LOG_RECORDS_FILE_MAGIC, logFile)) {
+        return false;
+    }
+    logFile.close();
+
+    File indexFile;
+    if (!createLogFile(LOG_INDEX_FILE_NAME, LOG_INDEX_FILE_MAGIC, indexFile)) {
+        return false;
+    }
+    indexFile.close();
+
+    return true;
 }
 
-static void writeToIndex(int indexType, uint32_t logOffset) {
+static bool loadIndex() {
+    if (g_indexLoaded) {
+        return true;
+    }
+
+    invalidateIndex();
+
+    g_numIndexBlocks = 0;
+    g_tailBlockNumEntries = 0;
+
+    if (!importTextLog() || !checkLogFiles()) {
+        return false;
+    }
+
     char filePath[MAX_PATH_LENGTH];
-    getIndexFilePath(indexType, filePath);
+    getLogFilePath(LOG_INDEX_FILE_NAME, filePath);
 
     File file;
-    if (file.open(filePath, FILE_OPEN_APPEND | FILE_WRITE)) {
-        file.write((const uint8_t *)&logOffset, sizeof(uint32_t));
+    if (file.open(filePath, FILE_OPEN_EXISTING | FILE_READ)) {
+        uint32_t indexSize = file.size() - LOG_FILE_HEADER_SIZE;
+
+        uint32_t numBlocks = (indexSize + INDEX_BLOCK_SIZE - 1) / INDEX_BLOCK_SIZE;
+        uint32_t tailBlockSize = indexSize - (numBlocks > 0 ? (numBlocks - 1) * INDEX_BLOCK_SIZE : 0);
+
+        // skip partially written tail block header or entry
+        if (numBlocks > 0 && tailBlockSize < INDEX_BLOCK_HEADER_SIZE + sizeof(uint32_t)) {
+            numBlocks--;
+            tailBlockSize = numBlocks > 0 ? INDEX_BLOCK_SIZE : 0;
+        } else {
+            tailBlockSize -= (tailBlockSize - INDEX_BLOCK_HEADER_SIZE) % sizeof(uint32_t);
+        }
+
+        if (numBlocks > 0) {
+            if (!file.seek(LOG_FILE_HEADER_SIZE + (numBlocks - 1) * INDEX_BLOCK_SIZE) || file.read(&g_tailBlock, tailBlockSize) != tailBlockSize) {
+                file.close();
+                return false;
+            }
+        }
+
         file.close();
+
+        uint32_t validIndexSize = numBlocks > 0 ? (numBlocks - 1) * INDEX_BLOCK_SIZE + tailBlockSize : 0;
+        if (validIndexSize != indexSize) {
+            // new entries are appended, so skipped part must be removed
+            if (!file.open(filePath, FILE_OPEN_ALWAYS | FILE_WRITE)) {
+                return false;
+            }
+            bool result = file.truncate(LOG_FILE_HEADER_SIZE + validIndexSize);
+            file.close();
+            if (!result) {
+                return false;
+            }
+        }
+
+        if (numBlocks > 0) {
+            g_numIndexBlocks = numBlocks;
+            g_tailBlockNumEntries = (tailBlockSize - INDEX_BLOCK_HEADER_SIZE) / sizeof(uint32_t);
+        }
     }
+
+    g_indexLoaded = true;
+    return true;
 }
 
-static void writeEvent(QueueEvent *event) {
-    uint32_t logOffset;
-    int eventType;
-    if (!writeToLog(event, logOffset, eventType)) {
-        return;
+static uint32_t getNumEvents(int filter) {
+    if (!loadIndex() || g_numIndexBlocks == 0) {
+        return 0;
     }
 
-    if (eventType >= g_filter) {
-        g_refreshEvents = true;
+    return g_tailBlock.numEventsBefore[filter - EVENT_TYPE_DEBUG] + getNumEventsInBlock(g_tailBlock, g_tailBlockNumEntries, filter);
+}
+
+static const IndexBlock *getIndexBlock(File &indexFile, uint32_t blockIndex) {
+    if (blockIndex == g_numIndexBlocks - 1) {
+        return &g_tailBlock;
     }
 
-    writeToIndex(EVENT_TYPE_DEBUG, logOffset);
+    int lruCacheEntryIndex = 0;
+    for (int i = 0; i < INDEX_BLOCK_CACHE_SIZE; i++) {
+        if (g_indexBlockCache[i].blockIndex == blockIndex) {
+            g_indexBlockCache[i].lastUsed = ++g_indexBlockCacheCounter;
+            return &g_indexBlockCache[i].block;
+        }
+        // signed difference keeps the order when g_indexBlockCacheCounter wraps around
+        if ((int32_t)(g_indexBlockCache[i].lastUsed - g_indexBlockCache[lruCacheEntryIndex].lastUsed) < 0) {
+            lruCacheEntryIndex = i;
+        }
+    }
+
+    auto &cacheEntry = g_indexBlockCache[lruCacheEntryIndex];
 
-    if (eventType == EVENT_TYPE_DEBUG) {
-        return;
+    if (
+        !indexFile.isOpen() ||
+        !indexFile.seek(LOG_FILE_HEADER_SIZE + blockIndex * INDEX_BLOCK_SIZE) ||
+        indexFile.read(&cacheEntry.block, INDEX_BLOCK_SIZE) != INDEX_BLOCK_SIZE
+    ) {
+        cacheEntry.blockIndex = INVALID_BLOCK_INDEX;
+        return nullptr;
     }
 
-    writeToIndex(EVENT_TYPE_INFO, logOffset);
+    cacheEntry.blockIndex = blockIndex;
+    cacheEntry.lastUsed = ++g_indexBlockCacheCounter;
+    return &cacheEntry.block;
+}
 
-    if (eventType == EVENT_TYPE_INFO) {
-        return;
+// finds index entry of the k-th (from the oldest) event with the type >= filter
+static bool findIndexEntry(File &indexFile, int filter, uint32_t k, uint32_t &entry) {
+    if (g_numIndexBlocks == 0) {
+        return false;
     }
 
-    writeToIndex(EVENT_TYPE_WARNING, logOffset);
+    int level = filter - EVENT_TYPE_DEBUG;
+
+    // find the last block with numEventsBefore <= k, usually it is the tail block
+    uint32_t blockIndex = g_numIndexBlocks - 1;
+    if (k < g_tailBlock.numEventsBefore[level]) {
+        uint32_t low = 0;
+        uint32_t high = g_numIndexBlocks - 2;
+        while (low < high) {
+            uint32_t mid = (low + high + 1) / 2;
+            const IndexBlock *block = getIndexBlock(indexFile, mid);
+            if (!block) {
+                return false;
+            }
+            if (block->numEventsBefore[level] <= k) {
+                low = mid;
+            } else {
+                high = mid - 1;
+            }
+        }
+        blockIndex = low;
+    }
 
-    if (eventType == EVENT_TYPE_WARNING) {
-        return;
+    const IndexBlock *block = getIndexBlock(indexFile, blockIndex);
+    if (!block) {
+        return false;
     }
 
-    writeToIndex(EVENT_TYPE_ERROR, logOffset);
+    uint32_t numEntries = blockIndex == g_numIndexBlocks - 1 ? g_tailBlockNumEntries : INDEX_BLOCK_NUM_ENTRIES;
+    uint32_t n = k - block->numEventsBefore[level];
+
+    for (uint32_t i = 0; i < numEntries; i++) {
+        if (INDEX_ENTRY_EVENT_TYPE(block->entries[i]) >= filter) {
+            if (n == 0) {
+                entry = block->entries[i];
+                return true;
+            }
+            n--;
+        }
+    }
+
+    return false;
 }
 
-static void getEventInfoText(Event *e, char *text, int count) {
-    int year, month, day, hour, minute, second;
-    datetime::breakTime(getEventDateTime(e), year, month, day, hour, minute, second);
+static bool appendIndexEntry(File &indexFile, uint32_t entry) {
+    if (g_numIndexBlocks == 0 || g_tailBlockNumEntries == INDEX_BLOCK_NUM_ENTRIES) {
+        // start a new block
+        uint32_t buffer[NUM_FILTER_LEVELS + 1];
+        for (int level = 0; level < NUM_FILTER_LEVELS; level++) {
+            buffer[level] = g_numIndexBlocks == 0 ? 0 :
+                g_tailBlock.numEventsBefore[level] + getNumEventsInBlock(g_tailBlock, g_tailBlockNumEntries, level + EVENT_TYPE_DEBUG);
+        }
+        buffer[NUM_FILTER_LEVELS] = entry;
 
-    int yearNow, monthNow, dayNow, hourNow, minuteNow, secondNow;
-    datetime::breakTime(datetime::now(), yearNow, monthNow, dayNow, hourNow, minuteNow, secondNow);
+        if (indexFile.write(buffer, sizeof(buffer)) != sizeof(buffer)) {
+            return false;
+        }
 
-    if (yearNow == year && monthNow == month && dayNow == day) {
-        if (persist_conf::devConf.dateTimeFormat == datetime::FORMAT_DMY_24 || persist_conf::devConf.dateTimeFormat == datetime::FORMAT_MDY_24) {
-            snprintf(text, count - 1, "%c [%02d:%02d:%02d] %s", 127 + getEventType(e) - EVENT_TYPE_DEBUG, hour, minute, second, getEventMessage(e));
-        } else {
-            bool am;
-            datetime::convertTime24to12(hour, am);
-            snprintf(text, count - 1, "%c [%02d:%02d:%02d %s] %s", 127 + getEventType(e) - EVENT_TYPE_DEBUG, hour, minute, second, am ? "AM" : "PM", getEventMessage(e));
+        memcpy(g_tailBlock.numEventsBefore, buffer, INDEX_BLOCK_HEADER_SIZE);
+        g_tailBlock.entries[0] = entry;
+        g_tailBlockNumEntries = 1;
+        g_numIndexBlocks++;
+    } else {
+        if (indexFile.write(&entry, sizeof(entry)) != sizeof(entry)) {
+            return false;
         }
+
+        g_tailBlock.entries[g_tailBlockNumEntries++] = entry;
+    }
+
+    return true;
+}
+
+static void getEventText(int16_t eventId, int channelIndex, const char *debugMessage, uint16_t eventCount, char *text, size_t count) {
+    if (eventId == EVENT_DEBUG_TRACE) {
+        strncpy(text, debugMessage, count - 1);
     } else {
-        if (persist_conf::devConf.dateTimeFormat == datetime::FORMAT_DMY_24 || persist_conf::devConf.dateTimeFormat == datetime::FORMAT_DMY_12) {
-            snprintf(text, count - 1, "%c [%02d-%02d-%02d] %s", 127 + getEventType(e) - EVENT_TYPE_DEBUG, day, month, year % 100, getEventMessage(e));
+        const char *message = getEventMessage(eventId);
+        if (!message) {
+            message = "";
+        }
+        if (channelIndex != -1) {
+            snprintf(text, count - 1, message, channelIndex + 1);
         } else {
-            snprintf(text, count - 1, "%c [%02d-%02d-%02d] %s", 127 + getEventType(e) - EVENT_TYPE_DEBUG, month, day, year % 100, getEventMessage(e));
+            strncpy(text, message, count - 1);
         }
     }
-
     text[count - 1] = 0;
+
+    if (eventCount > 1) {
+        size_t length = strlen(text);
+        snprintf(text + length, count - length, " x%d", (int)eventCount);
+    }
 }
 
-static void updateIsLongMessageText(Event &event) {
-    char text[256];
-    getEventInfoText(&event, text, sizeof(text));
-    eez::gui::font::Font font(getFontData(FONT_ID_OSWALD14));
-    event.isLongMessageText = mcu::display::measureStr(text, -1, font) > CONF_EVENT_LINE_WIDTH_PX;
+static bool writeTextLine(sd_card::BufferedFileWrite &bufferedFile, const QueueEvent &event, const char *debugMessage, uint16_t eventCount, int eventType) {
+    int year, month, day, hour, minute, second;
+    datetime::breakTime(event.dateTime, year, month, day, hour, minute, second);
+
+    char line[32 + EVENT_MESSAGE_MAX_SIZE];
+    sprintf(line, "%04d-%02d-%02d %02d:%02d:%02d %s ", year, month, day, hour, minute, second, EVENT_TYPE_NAMES[eventType]);
+
+    size_t length = strlen(line);
+    getEventText(event.eventId, event.channelIndex, debugMessage, eventCount, line + length, sizeof(line) - length - 1);
+    strcat(line, "\n");
+
+    return bufferedFile.write((const uint8_t *)line, strlen(line));
 }
 
-static bool readEvent(File &indexFile, File &logFile, int eventIndex, Event &event) {
-    indexFile.seek(4 * (g_numEvents - 1 - eventIndex));
-    uint32_t logOffset;
-    if (indexFile.read(&logOffset, sizeof(uint32_t)) != sizeof(uint32_t)) {
+// parses "YYYY-MM-DD hh:mm:ss TYPE message" line from log.txt
+static bool readTextLine(sd_card::BufferedFileRead &bufferedFile, uint32_t &dateTime, int &eventType, char *message, size_t messageSize) {
+    using namespace sd_card;
+
+    unsigned int year;
+    unsigned int month;
+    unsigned int day;
+    unsigned int hour;
+    unsigned int minute;
+    unsigned int second;
+    if (
+        !match(bufferedFile, year) || !match(bufferedFile, '-') ||
+        !match(bufferedFile, month) || !match(bufferedFile, '-') ||
+        !match(bufferedFile, day) ||
+        !match(bufferedFile, hour) || !match(bufferedFile, ':') ||
+        !match(bufferedFile, minute) || !match(bufferedFile, ':') ||
+        !match(bufferedFile, second)
+    ) {
         return false;
     }
 
-    logFile.seek(logOffset);
-    using namespace sd_card;
-    BufferedFileRead bufferedFile(logFile, 64);
+    matchZeroOrMoreSpaces(bufferedFile);
 
-    unsigned int year;
-    if (!match(bufferedFile, year)) {
+    char eventTypeStr[9];
+    if (!matchUntil(bufferedFile, ' ', eventTypeStr, sizeof(eventTypeStr) - 1)) {
         return false;
     }
-    if (!match(bufferedFile, '-')) {
+
+    eventType = EVENT_TYPE_NONE;
+    for (int i = EVENT_TYPE_DEBUG; i <= EVENT_TYPE_ERROR; i++) {
+        if (strcmp(eventTypeStr, EVENT_TYPE_NAMES[i]) == 0) {
+            eventType = i;
+            break;
+        }
+    }
+    if (eventType == EVENT_TYPE_NONE) {
         return false;
     }
-    unsigned int month;
-    if (!match(bufferedFile, month)) {
+
+    if (!matchUntil(bufferedFile, '\n', message, messageSize - 1)) {
         return false;
     }
-    if (!match(bufferedFile, '-')) {
+
+    dateTime = datetime::makeTime(year, month, day, hour, minute, second);
+
+    return true;
+}
+
+// Events logged by the older firmware versions are only in log.txt, indexed by index1..index4 files.
+// If index1 exists, all the events it refers to are imported into the new log.bin/log.idx and
+// the old index files are removed, so this is done only once. log.txt is left as it is.
+static bool importTextLog() {
+    char filePath[MAX_PATH_LENGTH];
+    getLogFilePath(OLD_LOG_INDEX_FILE_NAMES[0], filePath);
+    if (!sd_card::exists(filePath, nullptr)) {
+        return true;
+    }
+
+    // index1 has the offsets of all the events, the last one is the last event to import
+    File oldIndexFile;
+    if (!oldIndexFile.open(filePath, FILE_OPEN_EXISTING | FILE_READ)) {
         return false;
     }
-    unsigned int day;
-    if (!match(bufferedFile, day)) {
+    uint32_t numOldEvents = oldIndexFile.size() / sizeof(uint32_t);
+    uint32_t lastTextLogOffset = 0;
+    bool result = numOldEvents == 0 || (
+        oldIndexFile.seek((numOldEvents - 1) * sizeof(uint32_t)) &&
+        oldIndexFile.read(&lastTextLogOffset, sizeof(uint32_t)) == sizeof(uint32_t)
+    );
+    oldIndexFile.close();
+    if (!result) {
         return false;
     }
 
-    unsigned int hour;
-    if (!match(bufferedFile, hour)) {
+    // import starts from scratch, events written after the failed import (if any) are lost
+    File logFile;
+    if (!createLogFile(LOG_RECORDS_FILE_NAME, LOG_RECORDS_FILE_MAGIC, logFile)) {
         return false;
     }
-    if (!match(bufferedFile, ':')) {
+
+    File indexFile;
+    if (!createLogFile(LOG_INDEX_FILE_NAME, LOG_INDEX_FILE_MAGIC, indexFile)) {
+        logFile.close();
         return false;
     }
-    unsigned int minute;
-    if (!match(bufferedFile, minute)) {
+
+    g_numIndexBlocks = 0;
+    g_tailBlockNumEntries = 0;
+
+    if (numOldEvents > 0) {
+        getLogFilePath(LOG_FILE_NAME, filePath);
+        File textFile;
+        if (textFile.open(filePath, FILE_OPEN_EXISTING | FILE_READ)) {
+            sd_card::BufferedFileRead bufferedFile(textFile);
+
+            uint32_t logOffset = LOG_FILE_HEADER_SIZE;
+
+            while (result && bufferedFile.available() && bufferedFile.tell() <= lastTextLogOffset) {
+                QueueEvent event;
+                event.eventId = IMPORTED_EVENT_ID;
+                event.channelIndex = -1;
+                event.messageIndex = NO_DEBUG_TRACE_MESSAGE;
+
+                int eventType;
+                char message[EVENT_MESSAGE_MAX_SIZE];
+                if (readTextLine(bufferedFile, event.dateTime, eventType, message, sizeof(message))) {
+                    result = writeRecord(logFile, indexFile, logOffset, event, message, 1, eventType);
+                } else {
+                    // skip malformed line
+                    sd_card::skipUntilEOL(bufferedFile);
+                }
+            }
+
+            textFile.close();
+        }
+    }
+
+    indexFile.close();
+    logFile.close();
+
+    g_numIndexBlocks = 0;
+    g_tailBlockNumEntries = 0;
+
+    if (!result) {
         return false;
     }
-    if (!match(bufferedFile, ':')) {
+
+    for (size_t i = 0; i < sizeof(OLD_LOG_INDEX_FILE_NAMES) / sizeof(OLD_LOG_INDEX_FILE_NAMES[0]); i++) {
+        getLogFilePath(OLD_LOG_INDEX_FILE_NAMES[i], filePath);
+        if (sd_card::exists(filePath, nullptr)) {
+            sd_card::deleteFile(filePath, nullptr);
+        }
+    }
+
+    return true;
+}
+
+static bool writeRecord(File &logFile, File &indexFile, uint32_t &logOffset, const QueueEvent &event, const char *debugMessage, uint16_t eventCount, int eventType) {
+    if (logOffset > MAX_LOG_OFFSET) {
         return false;
     }
-    unsigned int second;
-    if (!match(bufferedFile, second)) {
+
+    uint8_t buffer[sizeof(LogRecord) + EVENT_MESSAGE_MAX_SIZE];
+    LogRecord &record = *(LogRecord *)buffer;
+
+    record.dateTime = event.dateTime;
+    record.eventId = event.eventId;
+    record.channelIndex = event.channelIndex;
+    record.messageLength = 0;
+    record.count = eventCount;
+    record.eventType = (uint8_t)eventType;
+    record.reserved = 0;
+
+    if (event.eventId == EVENT_DEBUG_TRACE || event.eventId == IMPORTED_EVENT_ID) {
+        size_t messageLength = strlen(debugMessage);
+        if (messageLength > 255) {
+            messageLength = 255;
+        }
+        record.messageLength = (uint8_t)messageLength;
+        memcpy(buffer + sizeof(LogRecord), debugMessage, messageLength);
+    }
+
+    size_t recordSize = sizeof(LogRecord) + record.messageLength;
+    if (logFile.write(buffer, recordSize) != recordSize) {
         return false;
     }
 
-    matchZeroOrMoreSpaces(bufferedFile);
+    if (!appendIndexEntry(indexFile, INDEX_ENTRY(logOffset, eventType))) {
+        return false;
+    }
 
-    char eventTypeStr[9];
-    matchUntil(bufferedFile, ' ', eventTypeStr, sizeof(eventTypeStr) - 1);
-    eventTypeStr[sizeof(eventTypeStr) - 1] = 0;
+    logOffset += recordSize;
+    return true;
+}
 
-    int eventType = EVENT_TYPE_NONE;
+static bool isSameEvent(const QueueEvent &event1, const QueueEvent &event2) {
+    if (event1.eventId != event2.eventId || event1.channelIndex != event2.channelIndex) {
+        return false;
+    }
+    if (event1.messageIndex == NO_DEBUG_TRACE_MESSAGE || event2.messageIndex == NO_DEBUG_TRACE_MESSAGE) {
+        return event1.messageIndex == event2.messageIndex;
+    }
+    return strcmp(g_debugTraceMessages[event1.messageIndex], g_debugTraceMessages[event2.messageIndex]) == 0;
+}
 
-    for (int i = EVENT_TYPE_DEBUG; i <= EVENT_TYPE_ERROR; i++) {
-        if (strcmp(eventTypeStr, EVENT_TYPE_NAMES[i]) == 0) {
-            eventType = i;
-            break;
+// Drains the write queue in a single batch: files are opened only once and
+// repeated identical events are collapsed into a single record.
+// Returns true if there was something to write.
+static bool writeEvents() {
+    QueueEvent pendingEvent;
+    bool hasPendingEvent = dequeueEvent(pendingEvent);
+
+    uint32_t numDroppedEvents = g_numDroppedEvents.load(std::memory_order_relaxed);
+
+    if (!hasPendingEvent && numDroppedEvents == g_numLoggedDroppedEvents) {
+        return false;
+    }
+
+    char filePath[MAX_PATH_LENGTH];
+
+    // if index can't be loaded, events are only written to the text log
+    bool indexLoaded = loadIndex();
+
+    getLogFilePath(LOG_RECORDS_FILE_NAME, filePath);
+    File logFile;
+    bool logFileOpened = indexLoaded && logFile.open(filePath, FILE_OPEN_APPEND | FILE_WRITE);
+
+    getLogFilePath(LOG_INDEX_FILE_NAME, filePath);
+    File indexFile;
+    bool indexFileOpened = indexLoaded && indexFile.open(filePath, FILE_OPEN_APPEND | FILE_WRITE);
+
+    getLogFilePath(LOG_FILE_NAME, filePath);
+    File textFile;
+    bool textFileOpened = textFile.open(filePath, FILE_OPEN_APPEND | FILE_WRITE);
+
+    sd_card::BufferedFileWrite bufferedTextFile(textFile);
+
+    uint32_t logOffset = logFileOpened ? logFile.size() : 0;
+
+    auto writeEvent = [&](const QueueEvent &event, uint16_t eventCount) {
+        int eventType = getEventType(event.eventId);
+        const char *debugMessage = getDebugTraceMessage(event);
+
+        if (logFileOpened && indexFileOpened) {
+            if (!writeRecord(logFile, indexFile, logOffset, event, debugMessage, eventCount, eventType)) {
+                // reload index, because the last entry could be partially written
+                invalidateIndex();
+                logFileOpened = false;
+            }
+        }
+
+        if (textFileOpened) {
+            textFileOpened = writeTextLine(bufferedTextFile, event, debugMessage, eventCount, eventType);
+        }
+
+        if (eventType >= g_filter) {
+            g_refreshEvents = true;
+        }
+    };
+
+    uint32_t batchSize = 0;
+
+    if (hasPendingEvent) {
+        batchSize++;
+        uint16_t eventCount = 1;
+
+        for (;;) {
+            // batch is limited, so producers can't keep the writer here forever
+            QueueEvent queueEvent;
+            bool hasEvent = batchSize < WRITE_QUEUE_SIZE && dequeueEvent(queueEvent);
+
+            if (hasEvent) {
+                batchSize++;
+                if (eventCount < 0xFFFF && isSameEvent(pendingEvent, queueEvent)) {
+                    eventCount++;
+                    g_numCollapsedEvents++;
+                    freeDebugTraceMessage(queueEvent.messageIndex);
+                    continue;
+                }
+            }
+
+            writeEvent(pendingEvent, eventCount);
+            freeDebugTraceMessage(pendingEvent.messageIndex);
+
+            if (!hasEvent) {
+                break;
+            }
+
+            pendingEvent = queueEvent;
+            eventCount = 1;
         }
     }
 
-    if (eventType == EVENT_TYPE_NONE) {
+    if (numDroppedEvents != g_numLoggedDroppedEvents) {
+        // events dropped because the queue was full are logged as a single record
+        uint32_t numNewDroppedEvents = numDroppedEvents - g_numLoggedDroppedEvents;
+
+        QueueEvent queueEvent;
+        queueEvent.dateTime = datetime::now();
+        queueEvent.eventId = EVENT_ERROR_TOO_MANY_LOG_EVENTS;
+        queueEvent.channelIndex = -1;
+        queueEvent.messageIndex = NO_DEBUG_TRACE_MESSAGE;
+        writeEvent(queueEvent, (uint16_t)MIN(numNewDroppedEvents, 0xFFFF));
+
+        g_numLoggedDroppedEvents = numDroppedEvents;
+    }
+
+    g_numBatches++;
+    if (batchSize > g_maxBatchSize) {
+        g_maxBatchSize = batchSize;
+    }
+
+    if (textFileOpened) {
+        bufferedTextFile.flush();
+    }
+
+    if (textFile.isOpen()) {
+        textFile.close();
+    }
+    if (indexFile.isOpen()) {
+        indexFile.close();
+    }
+    if (logFile.isOpen()) {
+        logFile.close();
+    }
+
+    return true;
+}
+
+static void refreshEvents() {
+    g_filter = persist_conf::devConf.eventQueueFilter;
+    if (g_filter < EVENT_TYPE_DEBUG || g_filter > EVENT_TYPE_ERROR) {
+        g_filter = EVENT_TYPE_INFO;
+    }
+
+    g_displayFromPosition = 0;
+    g_previousDisplayFromPosition = -1;
+    g_selectedEventIndex = -1;
+
+    if (g_isSdCardMounted) {
+        g_numEvents = getNumEvents(g_filter);
+        g_refreshEvents = false;
+    } else {
+        // refresh flag is cleared first, so an event pushed while counting is not missed
+        g_refreshEvents = false;
+
+        g_numEvents = 0;
+        uint32_t enqueuePosition = g_writeQueueEnqueuePosition.load(std::memory_order_relaxed);
+        for (uint32_t position = g_writeQueueDequeuePosition.load(std::memory_order_relaxed); position != enqueuePosition; position++) {
+            const QueueEvent *queueEvent = peekEvent(position);
+            if (queueEvent && getEventType(queueEvent->eventId) >= g_filter) {
+                g_numEvents++;
+            }
+        }
+    }
+}
+
+static void getEventInfoText(Event *e, char *text, int count) {
+    int year, month, day, hour, minute, second;
+    datetime::breakTime(getEventDateTime(e), year, month, day, hour, minute, second);
+
+    int yearNow, monthNow, dayNow, hourNow, minuteNow, secondNow;
+    datetime::breakTime(datetime::now(), yearNow, monthNow, dayNow, hourNow, minuteNow, secondNow);
+
+    if (yearNow == year && monthNow == month && dayNow == day) {
+        if (persist_conf::devConf.dateTimeFormat == datetime::FORMAT_DMY_24 || persist_conf::devConf.dateTimeFormat == datetime::FORMAT_MDY_24) {
+            snprintf(text, count - 1, "%c [%02d:%02d:%02d] %s", 127 + getEventType(e) - EVENT_TYPE_DEBUG, hour, minute, second, getEventMessage(e));
+        } else {
+            bool am;
+            datetime::convertTime24to12(hour, am);
+            snprintf(text, count - 1, "%c [%02d:%02d:%02d %s] %s", 127 + getEventType(e) - EVENT_TYPE_DEBUG, hour, minute, second, am ? "AM" : "PM", getEventMessage(e));
+        }
+    } else {
+        if (persist_conf::devConf.dateTimeFormat == datetime::FORMAT_DMY_24 || persist_conf::devConf.dateTimeFormat == datetime::FORMAT_DMY_12) {
+            snprintf(text, count - 1, "%c [%02d-%02d-%02d] %s", 127 + getEventType(e) - EVENT_TYPE_DEBUG, day, month, year % 100, getEventMessage(e));
+        } else {
+            snprintf(text, count - 1, "%c [%02d-%02d-%02d] %s", 127 + getEventType(e) - EVENT_TYPE_DEBUG, month, day, year % 100, getEventMessage(e));
+        }
+    }
+
+    text[count - 1] = 0;
+}
+
+static void updateIsLongMessageText(Event &event) {
+    char text[256];
+    getEventInfoText(&event, text, sizeof(text));
+    eez::gui::font::Font font(getFontData(FONT_ID_OSWALD14));
+    event.isLongMessageText = mcu::display::measureStr(text, -1, font) > CONF_EVENT_LINE_WIDTH_PX;
+}
+
+static bool readRecord(File &logFile, uint32_t logOffset, Event &event) {
+    LogRecord record;
+    if (!logFile.seek(logOffset) || logFile.read(&record, sizeof(LogRecord)) != sizeof(LogRecord)) {
         return false;
     }
 
-    char message[EVENT_MESSAGE_MAX_SIZE];
-    matchUntil(bufferedFile, '\n', message, sizeof(message) - 1);
-    message[sizeof(message) - 1] = 0;
+    event.dateTime = record.dateTime;
+    event.eventType = record.eventId == IMPORTED_EVENT_ID ? record.eventType : getEventType(record.eventId);
 
-    event.dateTime = datetime::makeTime(year, month, day, hour, minute, second);
-    event.eventType = eventType;
-    strcpy(event.message, message);
+    if (record.eventId == EVENT_DEBUG_TRACE || record.eventId == IMPORTED_EVENT_ID) {
+        if (logFile.read(event.message, record.messageLength) != record.messageLength) {
+            return false;
+        }
+        event.message[record.messageLength] = 0;
+        if (record.count > 1) {
+            snprintf(event.message + record.messageLength, sizeof(event.message) - record.messageLength, " x%d", (int)record.count);
+        }
+    } else {
+        getEventText(record.eventId, record.channelIndex, nullptr, record.count, event.message, sizeof(event.message));
+    }
 
     updateIsLongMessageText(event);
 
@@ -727,66 +1395,104 @@ static bool readEvent(File &indexFile, File &logFile, int eventIndex, Event &eve
     return true;
 }
 
+// When page is scrolled, some of the events are already decoded, just move them to the new place.
+static void reuseDecodedEvents(const uint32_t *logOffsets, const bool *isValid) {
+    for (int shift = 1; shift < EVENTS_PER_PAGE; shift++) {
+        if (isValid[0] && g_events[shift].eventType != EVENT_TYPE_NONE && g_events[shift].logOffset == logOffsets[0]) {
+            memmove(&g_events[0], &g_events[shift], (EVENTS_PER_PAGE - shift) * sizeof(Event));
+            return;
+        }
+
+        if (isValid[shift] && g_events[0].eventType != EVENT_TYPE_NONE && g_events[0].logOffset == logOffsets[shift]) {
+            memmove(&g_events[shift], &g_events[0], (EVENTS_PER_PAGE - shift) * sizeof(Event));
+            return;
+        }
+    }
+}
+
 static void readEvents(uint32_t fromPosition) {
     if (g_isSdCardMounted) {
         char filePath[MAX_PATH_LENGTH];
-        getIndexFilePath(g_filter, filePath);
+
+        // index file is not needed if all the events are in the tail block
+        getLogFilePath(LOG_INDEX_FILE_NAME, filePath);
         File indexFile;
-        if (indexFile.open(filePath, FILE_OPEN_EXISTING | FILE_READ)) {
-            getLogFilePath(filePath);
-            File logFile;
-            if (logFile.open(filePath, FILE_OPEN_EXISTING | FILE_READ)) {
-                for (int i = 0; i < EVENTS_PER_PAGE; i++) {
-                    auto &event = g_events[i];
-                    if (fromPosition + i < g_numEvents) {
-                        if (readEvent(indexFile, logFile, fromPosition + i, event)) {
-                            continue;
-                        }
-                    }
-                    memset(&event, 0, sizeof(event));
+        indexFile.open(filePath, FILE_OPEN_EXISTING | FILE_READ);
+
+        uint32_t logOffsets[EVENTS_PER_PAGE];
+        bool isValid[EVENTS_PER_PAGE];
+
+        for (int i = 0; i < EVENTS_PER_PAGE; i++) {
+            uint32_t entry;
+            isValid[i] = fromPosition + i < g_numEvents && findIndexEntry(indexFile, g_filter, g_numEvents - 1 - (fromPosition + i), entry);
+            logOffsets[i] = isValid[i] ? INDEX_ENTRY_LOG_OFFSET(entry) : 0;
+        }
+
+        if (indexFile.isOpen()) {
+            indexFile.close();
+        }
+
+        reuseDecodedEvents(logOffsets, isValid);
+
+        getLogFilePath(LOG_RECORDS_FILE_NAME, filePath);
+        File logFile;
+        bool logFileOpened = false;
+
+        for (int i = 0; i < EVENTS_PER_PAGE; i++) {
+            auto &event = g_events[i];
+
+            if (isValid[i]) {
+                if (event.eventType != EVENT_TYPE_NONE && event.logOffset == logOffsets[i]) {
+                    continue;
+                }
+
+                if (!logFileOpened) {
+                    logFileOpened = logFile.open(filePath, FILE_OPEN_EXISTING | FILE_READ);
+                }
+
+                if (logFileOpened && readRecord(logFile, logOffsets[i], event)) {
+                    continue;
                 }
-                logFile.close();
             }
-            indexFile.close();
+
+            memset(&event, 0, sizeof(event));
+        }
+
+        if (logFileOpened) {
+            logFile.close();
         }
     } else {
-        if (osMutexWait(g_writeQueueMutexId, 5) == osOK) {
-            uint32_t j = 0;
-            uint32_t k = 0;
-            if (g_writeQueueFull || g_writeQueueTail != g_writeQueueHead) {
-                int i = g_writeQueueFull ? (g_writeQueueHead + 1) % WRITE_QUEUE_MAX_SIZE : g_writeQueueHead;
-                do {
-                    if (i > 0) {
-                        i--;
-                    } else {
-                        i = WRITE_QUEUE_MAX_SIZE - 1;
-                    }
-
-                    int eventType = getEventType(g_writeQueue[i].eventId);
-                    if (eventType >= g_filter) {
-                        if (j >= fromPosition + k) {
-                            auto &event = g_events[k];
-                            event.dateTime = g_writeQueue[i].dateTime;
-                            event.eventType = eventType;
-                            if (g_writeQueue[i].channelIndex == -1 || g_writeQueue[i].message) {
-                                strcpy(event.message, eventType == EVENT_DEBUG_TRACE ? g_writeQueue[i].message : getEventMessage(g_writeQueue[i].eventId));
-                            } else {
-                                sprintf(event.message, getEventMessage(g_writeQueue[i].eventId), g_writeQueue[i].channelIndex + 1);
-                            }
-                            updateIsLongMessageText(event);
-                            event.logOffset = i;
-                            if (++k == EVENTS_PER_PAGE) {
-                                break;
-                            }
-                        }
-                        j++;
-                    }
-
-                } while (i != g_writeQueueTail);
+        // newest events first
+        uint32_t j = 0;
+        uint32_t k = 0;
+        uint32_t dequeuePosition = g_writeQueueDequeuePosition.load(std::memory_order_relaxed);
+        uint32_t position = g_writeQueueEnqueuePosition.load(std::memory_order_relaxed);
+        while (position != dequeuePosition && k < EVENTS_PER_PAGE) {
+            position--;
+
+            const QueueEvent *queueEvent = peekEvent(position);
+            if (!queueEvent) {
+                continue;
+            }
+
+            int eventType = getEventType(queueEvent->eventId);
+            if (eventType >= g_filter) {
+                if (j >= fromPosition + k) {
+                    auto &event = g_events[k];
+                    event.dateTime = queueEvent->dateTime;
+                    event.eventType = eventType;
+                    getEventText(queueEvent->eventId, queueEvent->channelIndex, getDebugTraceMessage(*queueEvent), 1, event.message, sizeof(event.message));
+                    updateIsLongMessageText(event);
+                    event.logOffset = position;
+                    k++;
+                }
+                j++;
             }
+        }
 
-            osMutexRelease(g_writeQueueMutexId);
-        }                
+        for (; k < EVENTS_PER_PAGE; k++) {
+            memset(&g_events[k], 0, sizeof(Event));
+        }
     }
 }
 
@@ -202,6 +202,18 @@ void init();
 void tick();
 void shutdownSave();
 
+struct WriteQueueStatistics {
+    uint32_t size;
+    uint32_t numQueued;
+    uint32_t highWaterMark;
+    uint32_t numDropped; // queue was full
+    uint32_t numCollapsed; // repeated identical events written as a single record
+    uint32_t numBatches;
+    uint32_t maxBatchSize;
+};
+
+void getWriteQueueStatistics(WriteQueueStatistics &statistics);
+
 int16_t getLastErrorEventId();
 int16_t getLastErrorEventChannelIndex();
 
@@ -4877,6 +4877,8 @@ void data_is_show_live_recording(DataOperationEnum operation, Cursor cursor, Val
 void data_channel_history_values(DataOperationEnum operation, Cursor cursor, Value &value) {
     if (operation == DATA_OPERATION_YT_DATA_GET_GET_VALUE_FUNC) {
         value = ChannelHistory::getChannelHistoryValueFuncs(cursor);
+    } else if (operation == DATA_OPERATION_YT_DATA_GET_GET_VALUES_FUNC) {
+        value = ChannelHistory::getChannelHistoryValuesFuncs(cursor);
     } else if (operation == DATA_OPERATION_YT_DATA_GET_REFRESH_COUNTER) {
         value = Value(0, VALUE_TYPE_UINT32);
     } else if (operation == DATA_OPERATION_YT_DATA_GET_SIZE) {
@@ -5009,6 +5011,10 @@ void data_recording(DataOperationEnum operation, Cursor cursor, Value &value) {
         value = Value(recording.refreshCounter, VALUE_TYPE_UINT32);
     } else if (operation == DATA_OPERATION_YT_DATA_GET_GET_VALUE_FUNC) {
         value = recording.getValue;
+    } else if (operation == DATA_OPERATION_YT_DATA_GET_GET_VALUES_FUNC) {
+        if (recording.getValues) {
+            value = recording.getValues;
+        }
     } else if (operation == DATA_OPERATION_YT_DATA_VALUE_IS_VISIBLE) {
         value = Value(recording.dlogValues[value.getUInt8()].isVisible);
     } else if (operation == DATA_OPERATION_YT_DATA_GET_SHOW_LABELS) {
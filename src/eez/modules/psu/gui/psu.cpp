@@ -19,6 +19,7 @@
 #if OPTION_DISPLAY
 
 #include <assert.h>
+#include <string.h>
 
 #if defined(EEZ_PLATFORM_STM32)
 #include <usbh_hid_keybd.h>
@@ -35,6 +36,7 @@
 #include <eez/modules/psu/channel_dispatcher.h>
 #include <eez/modules/psu/devices.h>
 #include <eez/modules/psu/event_queue.h>
+#include <eez/modules/psu/io_pins.h>
 #include <eez/modules/psu/temperature.h>
 #include <eez/modules/psu/trigger.h>
 #include <eez/modules/psu/dlog_view.h>
@@ -1391,7 +1393,7 @@ void isEnabledFocusCursorStep(const WidgetCursor &widgetCursor) {
 
 bool isEnabledFocusCursor(Cursor cursor, int16_t dataId) {
     g_focusCursorIsEnabled = false;
-    enumWidgets(&g_psuAppContext, isEnabledFocusCursorStep);
+    enumInteractiveWidgets(&g_psuAppContext, isEnabledFocusCursorStep);
     return g_focusCursorIsEnabled;
 }
 
@@ -1404,7 +1406,7 @@ void isEncoderEnabledInActivePageCheckWidget(const WidgetCursor &widgetCursor) {
 bool isEncoderEnabledInActivePage() {
     // encoder is enabled if active page contains widget with "edit" action
     g_isEncoderEnabledInActivePage = false;
-    enumWidgets(&g_psuAppContext, isEncoderEnabledInActivePageCheckWidget);
+    enumInteractiveWidgets(&g_psuAppContext, isEncoderEnabledInActivePageCheckWidget);
     return g_isEncoderEnabledInActivePage;
 }
 
@@ -1672,7 +1674,7 @@ void findNextFocusCursor(const WidgetCursor &widgetCursor) {
 
 static void moveToNextFocusCursor() {
     g_findNextFocusCursorState = 0;
-    enumWidgets(&g_psuAppContext, findNextFocusCursor);
+    enumInteractiveWidgets(&g_psuAppContext, findNextFocusCursor);
     if (g_findNextFocusCursorState > 0) {
         g_focusCursor = g_nextFocusCursor;
         g_focusDataId = g_nextFocusDataId;
@@ -2227,6 +2229,158 @@ uint16_t overrideActiveStyleColorHook(const WidgetCursor &widgetCursor, const St
     return style->active_color;
 }
 
+bool isVersionedDataHook(int16_t dataId) {
+    return
+        dataId == DATA_ID_CHANNEL_STATUS ||
+        dataId == DATA_ID_CHANNEL_OUTPUT_STATE ||
+        dataId == DATA_ID_CHANNEL_IS_CC ||
+        dataId == DATA_ID_CHANNEL_IS_CV ||
+        dataId == DATA_ID_CHANNEL_U_SET ||
+        dataId == DATA_ID_CHANNEL_U_MON ||
+        dataId == DATA_ID_CHANNEL_U_MON_DAC ||
+        dataId == DATA_ID_CHANNEL_U_LIMIT ||
+        dataId == DATA_ID_CHANNEL_U_EDIT ||
+        dataId == DATA_ID_CHANNEL_I_SET ||
+        dataId == DATA_ID_CHANNEL_I_MON ||
+        dataId == DATA_ID_CHANNEL_I_MON_DAC ||
+        dataId == DATA_ID_CHANNEL_I_LIMIT ||
+        dataId == DATA_ID_CHANNEL_I_EDIT ||
+        dataId == DATA_ID_CHANNEL_P_MON;
+}
+
+// Global state shown by the versioned data widgets, compared once per frame.
+struct DataVersionState {
+    int activePageId;
+    Cursor focusCursor;
+    int16_t focusDataId;
+    uint8_t couplingType;
+    bool powerUp;
+    bool frontPanelLocked;
+    bool encoderEnabled;
+    bool dlogIdle;
+};
+
+struct ChannelDataVersion {
+    uint32_t frame;
+    uint32_t valuesVersion;
+    uint32_t flags[2];
+    uint8_t dlogFlags;
+    bool ok;
+    uint32_t version;
+    uint32_t changeTime;
+    uint32_t result;
+};
+
+static uint32_t g_dataVersionFrame;
+static bool g_dataVersionDisabled;
+static DataVersionState g_dataVersionState;
+static uint32_t g_dataVersionStateVersion;
+static ChannelDataVersion g_channelDataVersions[CH_MAX];
+
+static void updateDataVersionState() {
+    using namespace psu;
+    using namespace psu::gui;
+
+    // blinking, keypad text and value edited with encoder are not covered by the version
+    g_dataVersionDisabled =
+        io_pins::isInhibited() ||
+        g_focusEditValue.getType() != VALUE_TYPE_NONE ||
+        getActivePageId() == PAGE_ID_EDIT_MODE_KEYPAD ||
+        g_psuAppContext.isPageOnStack(PAGE_ID_CH_SETTINGS_LISTS);
+
+    DataVersionState state;
+    memset(&state, 0, sizeof(state));
+    state.activePageId = getActivePageId();
+    state.focusCursor = g_focusCursor;
+    state.focusDataId = g_focusDataId;
+    state.couplingType = (uint8_t)channel_dispatcher::getCouplingType();
+    state.powerUp = isPowerUp();
+    state.frontPanelLocked = isFrontPanelLocked();
+    state.encoderEnabled = isEncoderEnabledInActivePage();
+    state.dlogIdle = dlog_record::isIdle();
+
+    if (memcmp(&state, &g_dataVersionState, sizeof(state)) != 0) {
+        memcpy(&g_dataVersionState, &state, sizeof(state));
+        g_dataVersionStateVersion++;
+    }
+}
+
+static uint32_t getChannelFlags(psu::Channel &channel) {
+    static_assert(sizeof(channel.flags) == sizeof(uint32_t), "Channel::Flags must fit in 32 bits");
+    uint32_t flags;
+    memcpy(&flags, &channel.flags, sizeof(flags));
+    return flags;
+}
+
+uint32_t getDataVersionHook(Cursor cursor) {
+    using namespace psu;
+    using namespace psu::gui;
+
+    if (g_dataVersionFrame != g_skipWidgetsFrame) {
+        g_dataVersionFrame = g_skipWidgetsFrame;
+        updateDataVersionState();
+    }
+
+    if (g_dataVersionDisabled) {
+        return 0;
+    }
+
+    int iChannel = cursor >= 0 ? cursor : (g_channel ? g_channel->channelIndex : 0);
+    if (iChannel < 0 || iChannel >= CH_NUM) {
+        return 0;
+    }
+
+    ChannelDataVersion &dataVersion = g_channelDataVersions[iChannel];
+    if (dataVersion.frame == g_skipWidgetsFrame) {
+        return dataVersion.result;
+    }
+    dataVersion.frame = g_skipWidgetsFrame;
+
+    Channel &channel = Channel::get(iChannel);
+
+    // values are versioned by the channel itself, see Channel::Value::version
+    uint32_t valuesVersion = channel.u.version + channel.i.version + g_dataVersionStateVersion;
+    uint32_t flags[2] = { getChannelFlags(channel), 0 };
+    if (iChannel < 2 && CH_NUM >= 2 && channel_dispatcher::getCouplingType() != channel_dispatcher::COUPLING_TYPE_NONE) {
+        // coupled channel values are combined with the other channel
+        Channel &otherChannel = Channel::get(1 - iChannel);
+        valuesVersion += otherChannel.u.version + otherChannel.i.version;
+        flags[1] = getChannelFlags(otherChannel);
+    }
+    bool ok = channel.isOk();
+    uint8_t dlogFlags =
+        (dlog_record::g_recording.parameters.logVoltage[iChannel] ? 1 : 0) |
+        (dlog_record::g_recording.parameters.logCurrent[iChannel] ? 2 : 0) |
+        (dlog_record::g_recording.parameters.logPower[iChannel] ? 4 : 0);
+
+    uint32_t currentTime = millis();
+
+    if (
+        dataVersion.version == 0 ||
+        dataVersion.valuesVersion != valuesVersion ||
+        dataVersion.flags[0] != flags[0] ||
+        dataVersion.flags[1] != flags[1] ||
+        dataVersion.ok != ok ||
+        dataVersion.dlogFlags != dlogFlags
+    ) {
+        dataVersion.valuesVersion = valuesVersion;
+        dataVersion.flags[0] = flags[0];
+        dataVersion.flags[1] = flags[1];
+        dataVersion.ok = ok;
+        dataVersion.dlogFlags = dlogFlags;
+        if (++dataVersion.version == 0) {
+            dataVersion.version = 1;
+        }
+        dataVersion.changeTime = currentTime;
+    }
+
+    // display data widget can postpone showing the new value up to the
+    // refresh rate, so wait until every changed value is shown
+    dataVersion.result = currentTime - dataVersion.changeTime > channel.params.MON_REFRESH_RATE_MS ? dataVersion.version : 0;
+
+    return dataVersion.result;
+}
+
 int16_t getAppContextId(AppContext *pAppContext) {
 #if defined(EEZ_PLATFORM_SIMULATOR)
     if (pAppContext == &g_frontPanelAppContext) {
@@ -19,6 +19,8 @@
 #include <eez/modules/psu/psu.h>
 
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include <scpi/scpi.h>
 
@@ -507,6 +509,58 @@ bool saveList(int iChannel, const char *filePath, int *err) {
     );
 }
 
+void fillBenchmarkList(float *dwellList, float *voltageList, float *currentList) {
+    // different number of significant digits (up to 4 decimals, as saved)
+    for (int i = 0; i < MAX_LIST_LENGTH; i++) {
+        dwellList[i] = ((i * 7919) % 100000) / 1000.0f;
+        voltageList[i] = ((i * 104729) % 400000) / 10000.0f;
+        currentList[i] = ((i * 1299709) % 50000) / 10000.0f;
+    }
+}
+
+bool benchmarkLoadList(const char *filePath, int numRepeats, uint32_t &loadTime, uint32_t &numMismatches, int *err) {
+    float dwellList[MAX_LIST_LENGTH];
+    float voltageList[MAX_LIST_LENGTH];
+    float currentList[MAX_LIST_LENGTH];
+    fillBenchmarkList(dwellList, voltageList, currentList);
+
+    uint16_t dwellListLength = MAX_LIST_LENGTH;
+    uint16_t voltageListLength = MAX_LIST_LENGTH;
+    uint16_t currentListLength = MAX_LIST_LENGTH;
+    if (!saveList(filePath, dwellList, dwellListLength, voltageList, voltageListLength, currentList, currentListLength, false, err)) {
+        return false;
+    }
+
+    uint32_t startTime = micros();
+    for (int i = 0; i < numRepeats; i++) {
+        if (!loadList(filePath, dwellList, dwellListLength, voltageList, voltageListLength, currentList, currentListLength, false, err)) {
+            return false;
+        }
+    }
+    loadTime = micros() - startTime;
+
+    // compare with the C library conversion of the same text
+    float expectedDwellList[MAX_LIST_LENGTH];
+    float expectedVoltageList[MAX_LIST_LENGTH];
+    float expectedCurrentList[MAX_LIST_LENGTH];
+    fillBenchmarkList(expectedDwellList, expectedVoltageList, expectedCurrentList);
+
+    numMismatches = 0;
+    for (int i = 0; i < MAX_LIST_LENGTH; i++) {
+        const float values[] = { dwellList[i], voltageList[i], currentList[i] };
+        const float expectedValues[] = { expectedDwellList[i], expectedVoltageList[i], expectedCurrentList[i] };
+        for (int j = 0; j < 3; j++) {
+            char text[32];
+            sprintf(text, "%.4f", expectedValues[j]);
+            if (values[j] != strtof(text, nullptr)) {
+                numMismatches++;
+            }
+        }
+    }
+
+    return dwellListLength == MAX_LIST_LENGTH && voltageListLength == MAX_LIST_LENGTH && currentListLength == MAX_LIST_LENGTH;
+}
+
 void updateChannelsWithVisibleCountersList();
 
 void setActive(bool active, bool forceUpdate = false) {
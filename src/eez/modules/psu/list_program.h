@@ -99,6 +99,10 @@ bool saveList(
 );
 bool saveList(int iChannel, const char *filePath, int *err);
 
+// used by DEBUg:PARSe?
+void fillBenchmarkList(float *dwellList, float *voltageList, float *currentList);
+bool benchmarkLoadList(const char *filePath, int numRepeats, uint32_t &loadTime, uint32_t &numMismatches, int *err);
+
 void executionStart(Channel &channel);
 
 int maxListsSize(Channel &channel);
@@ -20,6 +20,7 @@
 
 #include <eez/file_type.h>
 #include <eez/hmi.h>
+#include <eez/memory.h>
 
 #include <eez/modules/psu/psu.h>
 #include <eez/modules/psu/channel_dispatcher.h>
@@ -75,13 +76,17 @@ static void resetProfileToDefaults(Parameters &profile);
 static void saveState(Parameters &profile, List *lists);
 static bool recallState(Parameters &profile, List *lists, int recallOptions, int *err);
 
-static bool saveProfileToFile(const char *filePath, Parameters &profile, List *lists, bool showProgress, int *err);
+enum {
+    SAVE_PROFILE_TO_FILE_OPTION_BINARY = 0x01
+};
+static bool saveProfileToFile(const char *filePath, Parameters &profile, List *lists, int options, bool showProgress, int *err);
 static void saveStateToProfile0(bool merge);
 
 enum {
     LOAD_PROFILE_FROM_FILE_OPTION_ONLY_NAME = 0x01
 };
 static bool loadProfileFromFile(const char *filePath, Parameters &profile, List *lists, int options, bool showProgress, int *err);
+static bool profileReadCallback(ReadContext &ctx, Parameters &parameters, List *lists);
 
 static bool doSaveToLastLocation(int *err);
 static bool doRecallFromLastLocation(int *err);
@@ -223,7 +228,7 @@ bool saveToLocation(int location, const char *name, bool showProgress, int *err)
         strcpy(profile.name, name);
     }
 
-    if (!saveProfileToFile(filePath, profile, nullptr, showProgress, err)) {
+    if (!saveProfileToFile(filePath, profile, nullptr, SAVE_PROFILE_TO_FILE_OPTION_BINARY, showProgress, err)) {
         return false;
     }
 
@@ -237,25 +242,43 @@ bool saveToFile(const char *filePath, bool showProgress, int *err) {
     Parameters profile;
     memset(&profile, 0, sizeof(Parameters));
     saveState(profile, nullptr);
-    return saveProfileToFile(filePath, profile, nullptr, showProgress, err);
+    return saveProfileToFile(filePath, profile, nullptr, 0, showProgress, err);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 bool importFileToLocation(const char *filePath, int location, bool showProgress, int *err) {
+    // file is converted to the binary format used for the locations
+    Parameters profile;
+    resetProfileToDefaults(profile);
+    memset(g_listsProfile0, 0, CH_MAX * sizeof(List));
+    if (!loadProfileFromFile(filePath, profile, g_listsProfile0, 0, showProgress, err)) {
+        return false;
+    }
+
     char profileFilePath[MAX_PATH_LENGTH];
     getProfileFilePath(location, profileFilePath);
-    if (sd_card::copyFile(filePath, profileFilePath, true, err)) {
-        loadProfileParametersToCache(location);
-        return true;
+    if (!saveProfileToFile(profileFilePath, profile, g_listsProfile0, SAVE_PROFILE_TO_FILE_OPTION_BINARY, showProgress, err)) {
+        return false;
     }
-    return false;
+
+    loadProfileParametersToCache(location);
+    return true;
 }
 
 bool exportLocationToFile(int location, const char *filePath, bool showProgress, int *err) {
+    // location is exported in text format so it can be edited
     char profileFilePath[MAX_PATH_LENGTH];
     getProfileFilePath(location, profileFilePath);
-    return sd_card::copyFile(profileFilePath, filePath, true, err);
+
+    Parameters profile;
+    resetProfileToDefaults(profile);
+    memset(g_listsProfile0, 0, CH_MAX * sizeof(List));
+    if (!loadProfileFromFile(profileFilePath, profile, g_listsProfile0, 0, showProgress, err)) {
+        return false;
+    }
+
+    return saveProfileToFile(filePath, profile, g_listsProfile0, 0, showProgress, err);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -352,7 +375,7 @@ bool setName(int location, const char *name, bool showProgress, int *err) {
                 strcpy(profile.name, name);
             }
 
-            if (!saveProfileToFile(filePath, profile, g_listsProfile10, showProgress, err)) {
+            if (!saveProfileToFile(filePath, profile, g_listsProfile10, SAVE_PROFILE_TO_FILE_OPTION_BINARY, showProgress, err)) {
                 return false;
             }
 
@@ -408,6 +431,11 @@ void loadProfileParametersToCache(int location) {
     } else {
         char filePath[MAX_PATH_LENGTH];
         getProfileFilePath(location, filePath);
+
+        // fields missing in the file are left at the default values
+        resetProfileToDefaults(g_profilesCache[location]);
+        g_profilesCache[location].loadStatus = LOAD_STATUS_LOADING;
+
         int err;
         if (!loadProfileFromFile(filePath, g_profilesCache[location], nullptr, 0, false, &err)) {
             if (err != SCPI_ERROR_FILE_NOT_FOUND && err != SCPI_ERROR_MISSING_MASS_MEDIA) {
@@ -805,6 +833,15 @@ bool WriteContext::flush() {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static bool writeChannelProperties(WriteContext &ctx, const ChannelParameters &channel, int channelIndex) {
+    ctx.group("ch", channelIndex + 1);
+
+    WRITE_PROPERTY("moduleType", channel.moduleType);
+    WRITE_PROPERTY("moduleRevision", channel.moduleRevision);
+
+    return getModule(channel.moduleType)->writeProfileProperties(ctx, (uint8_t *)channel.parameters);
+}
+
 static bool profileWrite(WriteContext &ctx, const Parameters &parameters, List *lists, bool showProgress) {
 #if OPTION_DISPLAY
     size_t processedSoFar = 0;
@@ -840,12 +877,7 @@ static bool profileWrite(WriteContext &ctx, const Parameters &parameters, List *
     for (int channelIndex = 0; channelIndex < CH_MAX; channelIndex++) {
         auto &channel = parameters.channels[channelIndex];
         if (channel.parametersAreValid) {
-            ctx.group("ch", channelIndex + 1);
-
-            WRITE_PROPERTY("moduleType", channel.moduleType);
-            WRITE_PROPERTY("moduleRevision", channel.moduleRevision);
-
-            if (!getModule(channel.moduleType)->writeProfileProperties(ctx, (uint8_t *)channel.parameters)) {
+            if (!writeChannelProperties(ctx, channel, channelIndex)) {
                 return false;
             }
 
@@ -927,7 +959,533 @@ static bool profileWrite(WriteContext &ctx, const Parameters &parameters, List *
     return true;
 }
 
-static bool saveProfileToFile(const char *filePath, Parameters &profile, List *lists, bool showProgress, int *err) {
+////////////////////////////////////////////////////////////////////////////////
+
+// Binary profile format, used for the profile locations.
+//
+// File starts with the header and the section table. System section and channel
+// sections follow, together they form the header block, i.e. everything needed to
+// fill Parameters. List sections are stored after the header block so they are
+// read only when lists are requested.
+//
+// All the fields are stored explicitly, little endian, with fixed widths. Channel
+// parameters are owned by the module, so channel section holds the same [chN] group
+// as the text format, written and read by the module profile properties functions.
+//
+// Format can only be extended: new fields are appended at the end of the section and
+// new section types are added. Reader ignores unknown sections and trailing fields,
+// and leaves the fields missing in the shorter (older) sections at the default values.
+
+static const uint32_t BINARY_PROFILE_MAGIC = 0x505A4545; // "EEZP"
+static const uint16_t BINARY_PROFILE_VERSION = 1;
+
+enum BinaryProfileSectionType {
+    BINARY_PROFILE_SECTION_SYSTEM = 1,
+    BINARY_PROFILE_SECTION_CHANNEL = 2,
+    BINARY_PROFILE_SECTION_LIST = 3
+};
+
+static const int BINARY_PROFILE_MAX_SECTIONS = 1 + 2 * CH_MAX;
+
+// magic, version, numSections, headerBlockSize
+static const uint32_t BINARY_PROFILE_HEADER_SIZE = 4 + 2 + 2 + 4;
+// type, index, offset, size
+static const uint32_t BINARY_PROFILE_SECTION_ENTRY_SIZE = 2 + 2 + 4 + 4;
+// dwellListLength, voltageListLength, currentListLength, reserved
+static const uint32_t BINARY_PROFILE_LIST_HEADER_SIZE = 2 + 2 + 2 + 2;
+
+static const uint32_t BINARY_PROFILE_SYSTEM_SECTION_MAX_SIZE = 256;
+
+struct BinaryProfileSection {
+    uint16_t type;
+    uint16_t index;
+    uint32_t offset;
+    uint32_t size;
+};
+
+static void putUint8(uint8_t *&p, uint8_t value) {
+    *p++ = value;
+}
+
+static void putUint16(uint8_t *&p, uint16_t value) {
+    putUint8(p, value & 0xFF);
+    putUint8(p, value >> 8);
+}
+
+static void putUint32(uint8_t *&p, uint32_t value) {
+    putUint16(p, value & 0xFFFF);
+    putUint16(p, value >> 16);
+}
+
+static void putFloat(uint8_t *&p, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(float));
+    putUint32(p, bits);
+}
+
+// Reads fields from the section buffer, all get functions return false
+// (and leave the value unchanged) after the end of the section.
+class BinaryReader {
+public:
+    BinaryReader(const uint8_t *buffer, uint32_t size)
+        : p(buffer)
+        , end(buffer + size)
+    {
+    }
+
+    bool getUint8(uint8_t &value) {
+        if (p + 1 > end) {
+            p = end;
+            return false;
+        }
+        value = *p++;
+        return true;
+    }
+
+    bool getUint16(uint16_t &value) {
+        if (p + 2 > end) {
+            p = end;
+            return false;
+        }
+        value = p[0] | (p[1] << 8);
+        p += 2;
+        return true;
+    }
+
+    bool getUint32(uint32_t &value) {
+        if (p + 4 > end) {
+            p = end;
+            return false;
+        }
+        value = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+        p += 4;
+        return true;
+    }
+
+    bool getFloat(float &value) {
+        uint32_t bits;
+        if (!getUint32(bits)) {
+            return false;
+        }
+        memcpy(&value, &bits, sizeof(float));
+        return true;
+    }
+
+private:
+    const uint8_t *p;
+    const uint8_t *end;
+};
+
+static void writeSectionEntry(uint8_t *&p, const BinaryProfileSection &section) {
+    putUint16(p, section.type);
+    putUint16(p, section.index);
+    putUint32(p, section.offset);
+    putUint32(p, section.size);
+}
+
+static uint32_t encodeSystemSection(const Parameters &parameters, uint8_t *buffer) {
+    uint8_t *p = buffer;
+
+    putUint8(p, (parameters.flags.powerIsUp ? 0x01 : 0) | (parameters.flags.triggerContinuousInitializationEnabled ? 0x02 : 0));
+    putUint8(p, parameters.flags.couplingType);
+
+    uint8_t nameLength = 0;
+    while (nameLength < PROFILE_NAME_MAX_LENGTH && parameters.name[nameLength]) {
+        nameLength++;
+    }
+    putUint8(p, nameLength);
+    memcpy(p, parameters.name, nameLength);
+    p += nameLength;
+
+    putUint16(p, parameters.triggerSource);
+    putFloat(p, parameters.triggerDelay);
+
+    putUint8(p, 4);
+    for (int i = 0; i < 4; i++) {
+        putUint8(p, parameters.ioPins[i].function);
+        putUint8(p, parameters.ioPins[i].polarity);
+    }
+
+    putUint8(p, temp_sensor::MAX_NUM_TEMP_SENSORS);
+    for (int i = 0; i < temp_sensor::MAX_NUM_TEMP_SENSORS; i++) {
+        putFloat(p, parameters.tempProt[i].delay);
+        putFloat(p, parameters.tempProt[i].level);
+        putUint8(p, parameters.tempProt[i].state ? 1 : 0);
+    }
+
+    return p - buffer;
+}
+
+static void decodeSystemSection(BinaryReader &reader, Parameters &parameters, int options) {
+    uint8_t flags;
+    if (!reader.getUint8(flags)) {
+        return;
+    }
+
+    uint8_t couplingType;
+    if (!reader.getUint8(couplingType)) {
+        return;
+    }
+
+    uint8_t nameLength;
+    if (!reader.getUint8(nameLength)) {
+        return;
+    }
+    int i;
+    for (i = 0; i < nameLength; i++) {
+        uint8_t ch;
+        if (!reader.getUint8(ch)) {
+            break;
+        }
+        if (i < PROFILE_NAME_MAX_LENGTH) {
+            parameters.name[i] = ch;
+        }
+    }
+    parameters.name[MIN(i, PROFILE_NAME_MAX_LENGTH)] = 0;
+
+    if (options & LOAD_PROFILE_FROM_FILE_OPTION_ONLY_NAME) {
+        return;
+    }
+
+    parameters.flags.powerIsUp = flags & 0x01 ? 1 : 0;
+    parameters.flags.triggerContinuousInitializationEnabled = flags & 0x02 ? 1 : 0;
+    parameters.flags.couplingType = couplingType;
+
+    if (!reader.getUint16(parameters.triggerSource) || !reader.getFloat(parameters.triggerDelay)) {
+        return;
+    }
+
+    uint8_t numIoPins;
+    if (!reader.getUint8(numIoPins)) {
+        return;
+    }
+    for (i = 0; i < numIoPins; i++) {
+        uint8_t function;
+        uint8_t polarity;
+        if (!reader.getUint8(function) || !reader.getUint8(polarity)) {
+            return;
+        }
+        if (i < 4) {
+            parameters.ioPins[i].function = function;
+            parameters.ioPins[i].polarity = polarity;
+        }
+    }
+
+    uint8_t numTempSensors;
+    if (!reader.getUint8(numTempSensors)) {
+        return;
+    }
+    for (i = 0; i < numTempSensors; i++) {
+        float delay;
+        float level;
+        uint8_t state;
+        if (!reader.getFloat(delay) || !reader.getFloat(level) || !reader.getUint8(state)) {
+            return;
+        }
+        if (i < temp_sensor::MAX_NUM_TEMP_SENSORS) {
+            parameters.tempProt[i].delay = delay;
+            parameters.tempProt[i].level = level;
+            parameters.tempProt[i].state = state ? true : false;
+        }
+    }
+}
+
+static void getChannelLists(int channelIndex, List *lists, uint16_t *listLengths, float **listValues) {
+    if (lists) {
+        auto &list = lists[channelIndex];
+        listValues[0] = list.dwellList;
+        listLengths[0] = list.dwellListLength;
+        listValues[1] = list.voltageList;
+        listLengths[1] = list.voltageListLength;
+        listValues[2] = list.currentList;
+        listLengths[2] = list.currentListLength;
+    } else {
+        auto &channel = Channel::get(channelIndex);
+        listValues[0] = list::getDwellList(channel, &listLengths[0]);
+        listValues[1] = list::getVoltageList(channel, &listLengths[1]);
+        listValues[2] = list::getCurrentList(channel, &listLengths[2]);
+    }
+}
+
+static bool writeBinaryList(sd_card::BufferedFileWrite &bufferedFile, const uint16_t *listLengths, float **listValues) {
+    uint8_t buffer[BINARY_PROFILE_LIST_HEADER_SIZE];
+    uint8_t *p = buffer;
+    for (int i = 0; i < 3; i++) {
+        putUint16(p, listLengths[i]);
+    }
+    putUint16(p, 0);
+    if (!bufferedFile.write(buffer, sizeof(buffer))) {
+        return false;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < listLengths[i]; j++) {
+            p = buffer;
+            putFloat(p, listValues[i][j]);
+            if (!bufferedFile.write(buffer, sizeof(float))) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Header and section table are written last, when the section offsets and sizes are known.
+static bool profileWriteBinary(File &file, const Parameters &parameters, List *lists, bool showProgress) {
+    BinaryProfileSection sections[BINARY_PROFILE_MAX_SECTIONS];
+    int numSections = 1;
+    for (int channelIndex = 0; channelIndex < CH_MAX; channelIndex++) {
+        if (parameters.channels[channelIndex].parametersAreValid) {
+            numSections += 2;
+        }
+    }
+
+    uint8_t buffer[BINARY_PROFILE_SYSTEM_SECTION_MAX_SIZE];
+    static_assert(BINARY_PROFILE_HEADER_SIZE + BINARY_PROFILE_MAX_SECTIONS * BINARY_PROFILE_SECTION_ENTRY_SIZE <= sizeof(buffer), "buffer is too small");
+
+    sd_card::BufferedFileWrite bufferedFile(file);
+
+    // placeholder for the header and section table
+    uint32_t tableEnd = BINARY_PROFILE_HEADER_SIZE + numSections * BINARY_PROFILE_SECTION_ENTRY_SIZE;
+    memset(buffer, 0, tableEnd);
+    if (!bufferedFile.write(buffer, tableEnd)) {
+        return false;
+    }
+
+    int sectionIndex = 0;
+
+    // system section
+    sections[sectionIndex].type = BINARY_PROFILE_SECTION_SYSTEM;
+    sections[sectionIndex].index = 0;
+    sections[sectionIndex].offset = tableEnd;
+    sections[sectionIndex].size = encodeSystemSection(parameters, buffer);
+    if (!bufferedFile.write(buffer, sections[sectionIndex].size) || !bufferedFile.flush()) {
+        return false;
+    }
+    sectionIndex++;
+
+    // channel sections
+    for (int channelIndex = 0; channelIndex < CH_MAX; channelIndex++) {
+        auto &channel = parameters.channels[channelIndex];
+        if (channel.parametersAreValid) {
+            sections[sectionIndex].type = BINARY_PROFILE_SECTION_CHANNEL;
+            sections[sectionIndex].index = channelIndex;
+            sections[sectionIndex].offset = file.tell();
+
+            WriteContext ctx(file);
+            if (!writeChannelProperties(ctx, channel, channelIndex) || !ctx.flush()) {
+                return false;
+            }
+
+            sections[sectionIndex].size = file.tell() - sections[sectionIndex].offset;
+            sectionIndex++;
+        }
+    }
+
+    uint32_t headerBlockSize = file.tell();
+
+    // list sections
+    for (int channelIndex = 0; channelIndex < CH_MAX; channelIndex++) {
+        if (parameters.channels[channelIndex].parametersAreValid) {
+            uint16_t listLengths[3];
+            float *listValues[3];
+            getChannelLists(channelIndex, lists, listLengths, listValues);
+
+            sections[sectionIndex].type = BINARY_PROFILE_SECTION_LIST;
+            sections[sectionIndex].index = channelIndex;
+            sections[sectionIndex].offset = file.tell();
+
+            if (!writeBinaryList(bufferedFile, listLengths, listValues) || !bufferedFile.flush()) {
+                return false;
+            }
+
+            sections[sectionIndex].size = file.tell() - sections[sectionIndex].offset;
+            sectionIndex++;
+        }
+
+#if OPTION_DISPLAY
+        if (showProgress) {
+            psu::gui::updateProgressPage(channelIndex + 1, CH_MAX);
+        }
+#endif
+    }
+
+    // header and section table
+    uint8_t *p = buffer;
+    putUint32(p, BINARY_PROFILE_MAGIC);
+    putUint16(p, BINARY_PROFILE_VERSION);
+    putUint16(p, numSections);
+    putUint32(p, headerBlockSize);
+    for (int i = 0; i < numSections; i++) {
+        writeSectionEntry(p, sections[i]);
+    }
+
+    if (!file.seek(0)) {
+        return false;
+    }
+
+    return bufferedFile.write(buffer, tableEnd) && bufferedFile.flush();
+}
+
+static bool readBinaryList(File &file, const BinaryProfileSection &section, List &list) {
+    if (section.size < BINARY_PROFILE_LIST_HEADER_SIZE || !file.seek(section.offset)) {
+        return false;
+    }
+
+    uint8_t buffer[BINARY_PROFILE_LIST_HEADER_SIZE];
+    if (file.read(buffer, sizeof(buffer)) != sizeof(buffer)) {
+        return false;
+    }
+
+    BinaryReader reader(buffer, sizeof(buffer));
+    uint16_t listLengths[3];
+    for (int i = 0; i < 3; i++) {
+        reader.getUint16(listLengths[i]);
+        if (listLengths[i] > MAX_LIST_LENGTH) {
+            return false;
+        }
+    }
+
+    if (section.size < BINARY_PROFILE_LIST_HEADER_SIZE + (listLengths[0] + listLengths[1] + listLengths[2]) * sizeof(float)) {
+        return false;
+    }
+
+    float *listValues[3] = { list.dwellList, list.voltageList, list.currentList };
+    for (int i = 0; i < 3; i++) {
+        uint32_t size = listLengths[i] * sizeof(float);
+        if (file.read(listValues[i], size) != size) {
+            return false;
+        }
+
+        // stored little endian, convert in place
+        for (int j = 0; j < listLengths[i]; j++) {
+            BinaryReader valueReader((const uint8_t *)&listValues[i][j], sizeof(float));
+            valueReader.getFloat(listValues[i][j]);
+        }
+    }
+
+    list.dwellListLength = listLengths[0];
+    list.voltageListLength = listLengths[1];
+    list.currentListLength = listLengths[2];
+
+    return true;
+}
+
+static bool profileReadBinary(File &file, Parameters &parameters, List *lists, int options, bool showProgress) {
+    uint8_t buffer[BINARY_PROFILE_SYSTEM_SECTION_MAX_SIZE];
+
+    if (file.read(buffer, BINARY_PROFILE_HEADER_SIZE) != BINARY_PROFILE_HEADER_SIZE) {
+        return false;
+    }
+
+    BinaryReader headerReader(buffer, BINARY_PROFILE_HEADER_SIZE);
+    uint32_t magic;
+    uint16_t version;
+    uint16_t numSections;
+    uint32_t headerBlockSize;
+    headerReader.getUint32(magic);
+    headerReader.getUint16(version);
+    headerReader.getUint16(numSections);
+    headerReader.getUint32(headerBlockSize);
+
+    // newer versions only extend the format
+    if (magic != BINARY_PROFILE_MAGIC || version < 1) {
+        return false;
+    }
+
+    // section table, only the known sections are kept
+    BinaryProfileSection sections[BINARY_PROFILE_MAX_SECTIONS];
+    int numKnownSections = 0;
+    for (int i = 0; i < numSections; i++) {
+        if (file.read(buffer, BINARY_PROFILE_SECTION_ENTRY_SIZE) != BINARY_PROFILE_SECTION_ENTRY_SIZE) {
+            return false;
+        }
+
+        BinaryProfileSection section;
+        BinaryReader entryReader(buffer, BINARY_PROFILE_SECTION_ENTRY_SIZE);
+        entryReader.getUint16(section.type);
+        entryReader.getUint16(section.index);
+        entryReader.getUint32(section.offset);
+        entryReader.getUint32(section.size);
+
+        if (
+            (section.type == BINARY_PROFILE_SECTION_SYSTEM || ((section.type == BINARY_PROFILE_SECTION_CHANNEL || section.type == BINARY_PROFILE_SECTION_LIST) && section.index < CH_MAX)) &&
+            numKnownSections < BINARY_PROFILE_MAX_SECTIONS
+        ) {
+            sections[numKnownSections++] = section;
+        }
+    }
+
+    // system section
+    for (int i = 0; i < numKnownSections; i++) {
+        if (sections[i].type == BINARY_PROFILE_SECTION_SYSTEM) {
+            uint32_t size = MIN(sections[i].size, sizeof(buffer));
+            if (!file.seek(sections[i].offset) || file.read(buffer, size) != size) {
+                return false;
+            }
+
+            BinaryReader reader(buffer, size);
+            decodeSystemSection(reader, parameters, options);
+            break;
+        }
+    }
+
+    if (options & LOAD_PROFILE_FROM_FILE_OPTION_ONLY_NAME) {
+        parameters.flags.isValid = 1;
+        return true;
+    }
+
+    // channel sections
+    for (int channelIndex = 0; channelIndex < CH_MAX; channelIndex++) {
+        parameters.channels[channelIndex].parametersAreValid = 0;
+    }
+
+    for (int i = 0; i < numKnownSections; i++) {
+        if (sections[i].type == BINARY_PROFILE_SECTION_CHANNEL) {
+            if (!file.seek(sections[i].offset)) {
+                return false;
+            }
+
+            ReadContext ctx(file, sections[i].offset + sections[i].size);
+            if (!ctx.doRead(profileReadCallback, parameters, nullptr, 0, false)) {
+                return false;
+            }
+        }
+    }
+
+    // lists are read only if requested
+    if (lists) {
+        for (int channelIndex = 0; channelIndex < CH_MAX; channelIndex++) {
+            if (parameters.channels[channelIndex].parametersAreValid) {
+                auto &list = lists[channelIndex];
+                list.dwellListLength = 0;
+                list.voltageListLength = 0;
+                list.currentListLength = 0;
+            }
+        }
+
+        for (int i = 0; i < numKnownSections; i++) {
+            if (sections[i].type == BINARY_PROFILE_SECTION_LIST) {
+                if (!readBinaryList(file, sections[i], lists[sections[i].index])) {
+                    return false;
+                }
+
+#if OPTION_DISPLAY
+                if (showProgress) {
+                    psu::gui::updateProgressPage(i + 1, numKnownSections);
+                }
+#endif
+            }
+        }
+    }
+
+    parameters.flags.isValid = 1;
+
+    return true;
+}
+
+static bool saveProfileToFile(const char *filePath, Parameters &profile, List *lists, int options, bool showProgress, int *err) {
     if (!sd_card::isMounted(err)) {
         if (err) {
             *err = SCPI_ERROR_MISSING_MASS_MEDIA;
@@ -947,14 +1505,18 @@ static bool saveProfileToFile(const char *filePath, Parameters &profile, List *l
         File file;
 
         if (file.open(filePath, FILE_CREATE_ALWAYS | FILE_WRITE)) {
-            WriteContext ctx(file);
+            bool result;
+            if (options & SAVE_PROFILE_TO_FILE_OPTION_BINARY) {
+                result = profileWriteBinary(file, profile, lists, showProgress);
+            } else {
+                WriteContext ctx(file);
+                result = profileWrite(ctx, profile, lists, showProgress) && ctx.flush();
+            }
 
-            if (profileWrite(ctx, profile, lists, showProgress)) {
-                if (ctx.flush()) {
-                    file.close();
-                    onSdCardFileChangeHook(filePath);
-                    return true;
-                }
+            if (result) {
+                file.close();
+                onSdCardFileChangeHook(filePath);
+                return true;
             }
         }
 
@@ -979,7 +1541,7 @@ static void saveStateToProfile0(bool merge) {
     saveState(g_profilesCache[0], g_listsProfile0);
 
     int err;
-    if (!saveProfileToFile(filePath, g_profilesCache[0], g_listsProfile0, false, &err)) {
+    if (!saveProfileToFile(filePath, g_profilesCache[0], g_listsProfile0, SAVE_PROFILE_TO_FILE_OPTION_BINARY, false, &err)) {
         generateError(err);
         return;
     }
@@ -987,9 +1549,10 @@ static void saveStateToProfile0(bool merge) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-ReadContext::ReadContext(File &file_)
+ReadContext::ReadContext(File &file_, uint32_t endPosition_)
     : result(true)
     , file(file_)
+    , endPosition(endPosition_)
 {
 }
 
@@ -1006,7 +1569,7 @@ bool ReadContext::doRead(bool (*callback)(ReadContext &ctx, Parameters &paramete
 #endif
 
         sd_card::matchZeroOrMoreSpaces(file);
-        if (!file.available()) {
+        if (!file.available() || file.tell() >= endPosition) {
             break;
         }
 
@@ -1251,9 +1814,22 @@ static bool loadProfileFromFile(const char *filePath, Parameters &profile, List
         return false;
     }
 
-    ReadContext ctx(file);
-
-    bool result = profileRead(ctx, profile, lists, options, showProgress);
+    // text profiles (older locations, imported or user edited files) are still supported
+    bool result;
+    uint8_t magicBuffer[4];
+    uint32_t magic;
+    BinaryReader magicReader(magicBuffer, sizeof(magicBuffer));
+    if (
+        file.read(magicBuffer, sizeof(magicBuffer)) == sizeof(magicBuffer) &&
+        magicReader.getUint32(magic) && magic == BINARY_PROFILE_MAGIC
+    ) {
+        file.seek(0);
+        result = profileReadBinary(file, profile, lists, options, showProgress);
+    } else {
+        file.seek(0);
+        ReadContext ctx(file);
+        result = profileRead(ctx, profile, lists, options, showProgress);
+    }
 
     file.close();
 
@@ -1325,6 +1901,37 @@ static bool isProfile0Dirty() {
     return false;
 }
 
+bool benchmarkLoadProfile(const char *filePath, int numRepeats, uint32_t &loadTime, int *err) {
+    Parameters profile;
+    saveState(profile, nullptr);
+
+    // lists of the profile 0 must not be touched, they are saved back on the next auto save
+    static_assert(CH_MAX * sizeof(List) <= BENCHMARK_BUFFER_SIZE, "BENCHMARK_BUFFER is too small");
+    List *lists = (List *)BENCHMARK_BUFFER;
+
+    for (int channelIndex = 0; channelIndex < CH_MAX; channelIndex++) {
+        auto &list = lists[channelIndex];
+        list::fillBenchmarkList(list.dwellList, list.voltageList, list.currentList);
+        list.dwellListLength = MAX_LIST_LENGTH;
+        list.voltageListLength = MAX_LIST_LENGTH;
+        list.currentListLength = MAX_LIST_LENGTH;
+    }
+
+    if (!saveProfileToFile(filePath, profile, lists, 0, false, err)) {
+        return false;
+    }
+
+    uint32_t startTime = micros();
+    for (int i = 0; i < numRepeats; i++) {
+        if (!loadProfileFromFile(filePath, profile, lists, 0, false, err)) {
+            return false;
+        }
+    }
+    loadTime = micros() - startTime;
+
+    return true;
+}
+
 } // namespace profile
 } // namespace psu
 } // namespace eez
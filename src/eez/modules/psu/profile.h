@@ -109,6 +109,9 @@ void setFreezeState(bool value);
 
 void loadProfileParametersToCache(int location);
 
+// Saves current state with max. length lists on all channels and measures how long it takes to load it.
+bool benchmarkLoadProfile(const char *filePath, int numRepeats, uint32_t &loadTime, int *err);
+
 class WriteContext {
 public:
     WriteContext(File &file_);
@@ -139,7 +142,8 @@ private:
 
 class ReadContext {
 public:
-    ReadContext(File &file_);
+    // reading stops at the endPosition, or at the end of the file
+    ReadContext(File &file_, uint32_t endPosition_ = 0xFFFFFFFF);
 
     bool doRead(bool(*callback)(ReadContext &ctx, Parameters &parameters, List *lists), Parameters &parameters, List *lists, int options, bool showProgress);
 
@@ -161,6 +165,7 @@ public:
 
 private:
     sd_card::BufferedFileRead file;
+    uint32_t endPosition;
     char groupName[100];
     char propertyName[100];
 };
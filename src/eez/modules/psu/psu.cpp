@@ -292,6 +292,9 @@ void PsuModule::setProfileParameters(int channelIndex, uint8_t *buffer, bool mis
 
     channel.p_limit = channel.roundChannelValue(UNIT_WATT, MIN(parameters->p_limit, channel.u.max * channel.i.max));
 
+    ++channel.u.version;
+    ++channel.i.version;
+
     channel.prot_conf.u_delay = parameters->u_delay;
     channel.prot_conf.u_level = parameters->u_level;
     channel.prot_conf.i_delay = parameters->i_delay;
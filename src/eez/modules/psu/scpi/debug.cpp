@@ -18,6 +18,7 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <eez/firmware.h>
 #include <eez/system.h>
@@ -27,13 +28,23 @@
 #endif
 
 #include <eez/modules/psu/psu.h>
+#include <eez/modules/psu/channel_dispatcher.h>
 #include <eez/modules/psu/serial_psu.h>
 #include <eez/modules/psu/temperature.h>
 #include <eez/modules/psu/ontime.h>
 #include <eez/modules/psu/scpi/psu.h>
 #include <eez/modules/psu/event_queue.h>
+#include <eez/modules/psu/dlog_record.h>
+#include <eez/modules/psu/list_program.h>
+#include <eez/modules/psu/profile.h>
+#include <eez/modules/psu/sd_card.h>
+#if defined(EEZ_PLATFORM_SIMULATOR)
+#include <eez/libs/sd_fat/sd_fat.h>
+#endif
 #if OPTION_DISPLAY
 #include <eez/modules/psu/gui/psu.h>
+#include <eez/modules/mcu/display.h>
+#include <eez/gui/profiler.h>
 #endif
 
 #include <eez/modules/mcu/eeprom.h>
@@ -497,6 +508,867 @@ scpi_result_t scpi_cmd_debugEvent(scpi_t *context) {
     return SCPI_RES_OK;
 }
 
+scpi_result_t scpi_cmd_debugEventQ(scpi_t *context) {
+    char buffer[512] = { 0 };
+    char *p = buffer;
+
+    event_queue::WriteQueueStatistics stats;
+    event_queue::getWriteQueueStatistics(stats);
+
+    sprintf(p, "queue size: %u\n", (unsigned)stats.size);
+    p += strlen(p);
+
+    sprintf(p, "queued: %u\n", (unsigned)stats.numQueued);
+    p += strlen(p);
+
+    sprintf(p, "high water mark: %u\n", (unsigned)stats.highWaterMark);
+    p += strlen(p);
+
+    sprintf(p, "dropped: %u\n", (unsigned)stats.numDropped);
+    p += strlen(p);
+
+    sprintf(p, "collapsed: %u\n", (unsigned)stats.numCollapsed);
+    p += strlen(p);
+
+    sprintf(p, "batches: %u\n", (unsigned)stats.numBatches);
+    p += strlen(p);
+
+    sprintf(p, "max batch size: %u\n", (unsigned)stats.maxBatchSize);
+    p += strlen(p);
+
+    SCPI_ResultText(context, buffer);
+
+    return SCPI_RES_OK;
+}
+
+scpi_result_t scpi_cmd_debugDlogQ(scpi_t *context) {
+    char buffer[512] = { 0 };
+    char *p = buffer;
+
+    dlog_record::WriteStatistics &stats = dlog_record::g_writeStatistics;
+
+    sprintf(p, "written: %u bytes\n", (unsigned)stats.numBytesWritten);
+    p += strlen(p);
+
+    sprintf(p, "write speed: %.3f MB/s\n", dlog_record::getWriteSpeed());
+    p += strlen(p);
+
+    sprintf(p, "max write latency: %u us\n", (unsigned)stats.maxWriteTime);
+    p += strlen(p);
+
+    sprintf(p, "opens: %u\n", (unsigned)stats.numOpens);
+    p += strlen(p);
+
+    sprintf(p, "syncs: %u\n", (unsigned)stats.numSyncs);
+    p += strlen(p);
+
+    sprintf(p, "errors: %u\n", (unsigned)stats.numErrors);
+    p += strlen(p);
+
+    if (stats.numBlocks > 0) {
+        sprintf(p, "blocks: %u\n", (unsigned)stats.numBlocks);
+        p += strlen(p);
+
+        sprintf(p, "compression ratio: %.2f\n", dlog_record::getCompressionRatio());
+        p += strlen(p);
+
+        sprintf(p, "avg. block fill: %u bytes\n", (unsigned)(stats.numEncodedBytes / stats.numBlocks));
+        p += strlen(p);
+
+        sprintf(p, "avg. block encode time: %u us\n", (unsigned)(stats.encodeTime / stats.numBlocks));
+        p += strlen(p);
+
+        sprintf(p, "max block encode time: %u us\n", (unsigned)stats.maxEncodeTime);
+        p += strlen(p);
+    }
+
+    SCPI_ResultCharacters(context, buffer, strlen(buffer));
+
+    return SCPI_RES_OK;
+}
+
+scpi_result_t scpi_cmd_debugScpiLookupQ(scpi_t *context) {
+    static const int NUM_REPEATS = 10;
+
+    const scpi_command_index_t *cmdindex = context->cmdindex;
+    if (!cmdindex) {
+        SCPI_ErrorPush(context, SCPI_ERROR_EXECUTION_ERROR);
+        return SCPI_RES_ERR;
+    }
+
+    uint32_t linearTime = 0;
+    uint32_t indexedTime = 0;
+    uint32_t numLookups = 0;
+
+    for (int i = 0; context->cmdlist[i].pattern; i++) {
+        // make header from the pattern: skip optional nodes and numeric suffix placeholders
+        char header[128];
+        int len = 0;
+        int optional = 0;
+        for (const char *p = context->cmdlist[i].pattern; *p && len < (int)sizeof(header); p++) {
+            if (*p == '[') {
+                optional++;
+            } else if (*p == ']') {
+                optional--;
+            } else if (!optional && *p != '#') {
+                header[len++] = *p;
+            }
+        }
+
+        context->cmdindex = nullptr;
+        uint32_t start = micros();
+        for (int j = 0; j < NUM_REPEATS; j++) {
+            SCPI_FindCommand(context, header, len);
+        }
+        linearTime += micros() - start;
+
+        context->cmdindex = cmdindex;
+        start = micros();
+        for (int j = 0; j < NUM_REPEATS; j++) {
+            SCPI_FindCommand(context, header, len);
+        }
+        indexedTime += micros() - start;
+
+        numLookups += NUM_REPEATS;
+    }
+
+    char buffer[256];
+    sprintf(buffer, "commands: %u\nlinear: %.0f lookups/s\nindexed: %.0f lookups/s",
+        (unsigned)(numLookups / NUM_REPEATS),
+        linearTime > 0 ? numLookups * 1E6 / linearTime : 0.0,
+        indexedTime > 0 ? numLookups * 1E6 / indexedTime : 0.0);
+
+    SCPI_ResultCharacters(context, buffer, strlen(buffer));
+
+    return SCPI_RES_OK;
+}
+
+scpi_result_t scpi_cmd_debugGuiDirtyQ(scpi_t *context) {
+#if OPTION_DISPLAY
+    using namespace mcu::display;
+
+    char buffer[512] = { 0 };
+    char *p = buffer;
+
+    DirtyStatistics stats = g_dirtyStatistics;
+    uint32_t numDisplayPixels = getDisplayWidth() * getDisplayHeight();
+
+    sprintf(p, "frames: %u\n", (unsigned)stats.numFrames);
+    p += strlen(p);
+
+    sprintf(p, "last frame: %u pixels (%.1f%%), %u rects\n", (unsigned)stats.lastNumPixels, 100.0f * stats.lastNumPixels / numDisplayPixels, (unsigned)stats.lastNumRects);
+    p += strlen(p);
+
+    uint32_t avgNumPixels = stats.numFrames > 0 ? (uint32_t)(stats.totalNumPixels / stats.numFrames) : 0;
+    sprintf(p, "avg. frame: %u pixels (%.1f%%)\n", (unsigned)avgNumPixels, 100.0f * avgNumPixels / numDisplayPixels);
+    p += strlen(p);
+
+    sprintf(p, "max frame: %u pixels (%.1f%%)", (unsigned)stats.maxNumPixels, 100.0f * stats.maxNumPixels / numDisplayPixels);
+    p += strlen(p);
+
+    SCPI_ResultCharacters(context, buffer, strlen(buffer));
+
+    return SCPI_RES_OK;
+#else
+    SCPI_ErrorPush(context, SCPI_ERROR_HARDWARE_MISSING);
+    return SCPI_RES_ERR;
+#endif
+}
+
+// Optional first parameter of the benchmark commands.
+static bool getBenchmarkRepeatsParam(scpi_t *context, int32_t defaultNumRepeats, int32_t maxNumRepeats, int32_t *numRepeats) {
+    if (!SCPI_ParamInt(context, numRepeats, false)) {
+        if (SCPI_ParamErrorOccurred(context)) {
+            return false;
+        }
+        *numRepeats = defaultNumRepeats;
+    }
+
+    if (*numRepeats < 1 || *numRepeats > maxNumRepeats) {
+        SCPI_ErrorPush(context, SCPI_ERROR_ILLEGAL_PARAMETER_VALUE);
+        return false;
+    }
+
+    return true;
+}
+
+#define BENCHMARK_RESULT_BUFFER_SIZE 1024
+
+// Benchmark result is returned as the lines of text, without the last new line.
+static scpi_result_t returnBenchmarkResult(scpi_t *context, char *buffer) {
+    size_t length = strlen(buffer);
+    if (length > 0 && buffer[length - 1] == '\n') {
+        buffer[--length] = 0;
+    }
+
+    SCPI_ResultCharacters(context, buffer, length);
+
+    return SCPI_RES_OK;
+}
+
+#if defined(EEZ_PLATFORM_SIMULATOR) && OPTION_DISPLAY
+
+#define CONF_DRAW_TEXT_BENCHMARK_DEFAULT_NUM_REPEATS 100
+#define CONF_DRAW_TEXT_BENCHMARK_MAX_NUM_REPEATS 10000
+
+#define CONF_BLIT_BENCHMARK_DEFAULT_NUM_REPEATS 100
+#define CONF_BLIT_BENCHMARK_MAX_NUM_REPEATS 10000
+
+static const struct {
+    const char *name;
+    int fontID;
+} g_drawTextBenchmarkFonts[] = {
+    { "oswald12", FONT_ID_OSWALD12 },
+    { "oswald14", FONT_ID_OSWALD14 },
+    { "oswald17", FONT_ID_OSWALD17 },
+    { "oswald20", FONT_ID_OSWALD20 },
+    { "oswald24", FONT_ID_OSWALD24 },
+    { "oswald38", FONT_ID_OSWALD38 },
+    { "oswald48", FONT_ID_OSWALD48 },
+    { "roboto", FONT_ID_ROBOTO_CONDENSED_REGULAR }
+};
+
+// typical main page channel readout
+static const char *g_drawTextBenchmarkText = "CH1 40.000 V 5.000 A 200.00 W";
+
+#endif
+
+scpi_result_t scpi_cmd_debugGuiTextQ(scpi_t *context) {
+#if defined(EEZ_PLATFORM_SIMULATOR) && OPTION_DISPLAY
+    using namespace mcu::display;
+
+    int32_t numRepeats;
+    if (!getBenchmarkRepeatsParam(context, CONF_DRAW_TEXT_BENCHMARK_DEFAULT_NUM_REPEATS, CONF_DRAW_TEXT_BENCHMARK_MAX_NUM_REPEATS, &numRepeats)) {
+        return SCPI_RES_ERR;
+    }
+
+    char buffer[BENCHMARK_RESULT_BUFFER_SIZE];
+    char *p = buffer;
+
+    for (unsigned i = 0; i < sizeof(g_drawTextBenchmarkFonts) / sizeof(g_drawTextBenchmarkFonts[0]); i++) {
+        eez::gui::font::Font font(eez::gui::getFontData(g_drawTextBenchmarkFonts[i].fontID));
+
+        DrawTextBenchmarkResult result;
+        benchmarkDrawText(font, g_drawTextBenchmarkText, numRepeats, result);
+
+        double referenceRate = result.referenceTime > 0 ? 1.0 * result.numPixels / result.referenceTime : 0.0;
+        double rate = result.time > 0 ? 1.0 * result.numPixels / result.time : 0.0;
+
+        sprintf(p, "%s: %u glyphs, %.1f Mpixel/s (blendColor %.1f Mpixel/s, %.1fx), %u mismatches\n",
+            g_drawTextBenchmarkFonts[i].name,
+            (unsigned)result.numGlyphs,
+            rate,
+            referenceRate,
+            referenceRate > 0 ? rate / referenceRate : 0.0,
+            (unsigned)result.numMismatches);
+        p += strlen(p);
+    }
+
+    return returnBenchmarkResult(context, buffer);
+#else
+    SCPI_ErrorPush(context, SCPI_ERROR_HARDWARE_MISSING);
+    return SCPI_RES_ERR;
+#endif
+}
+
+scpi_result_t scpi_cmd_debugGuiBlitQ(scpi_t *context) {
+#if defined(EEZ_PLATFORM_SIMULATOR) && OPTION_DISPLAY
+    using namespace mcu::display;
+
+    int32_t numRepeats;
+    if (!getBenchmarkRepeatsParam(context, CONF_BLIT_BENCHMARK_DEFAULT_NUM_REPEATS, CONF_BLIT_BENCHMARK_MAX_NUM_REPEATS, &numRepeats)) {
+        return SCPI_RES_ERR;
+    }
+
+    BlitBenchmarkResult results[NUM_BLIT_BENCHMARKS];
+    benchmarkBlit(numRepeats, results);
+
+    char buffer[BENCHMARK_RESULT_BUFFER_SIZE];
+    char *p = buffer;
+
+    for (int i = 0; i < NUM_BLIT_BENCHMARKS; i++) {
+        sprintf(p, "%s: %.1f Mpixel/s\n", results[i].name,
+            results[i].time > 0 ? 1.0 * results[i].numPixels / results[i].time : 0.0);
+        p += strlen(p);
+    }
+
+    return returnBenchmarkResult(context, buffer);
+#else
+    SCPI_ErrorPush(context, SCPI_ERROR_HARDWARE_MISSING);
+    return SCPI_RES_ERR;
+#endif
+}
+
+scpi_result_t scpi_cmd_debugGuiUpdateQ(scpi_t *context) {
+#if OPTION_DISPLAY
+    const eez::gui::UpdateScreenStatistics &statistics = eez::gui::g_updateScreenStatistics;
+
+    uint32_t numFrames = statistics.numFrames > 0 ? statistics.numFrames : 1;
+
+    char buffer[512];
+    sprintf(buffer,
+        "Skip static widgets: %s\n"
+        "Frames: %u\n"
+        "Frame time: last %u us, avg %u us, max %u us\n"
+        "Widgets visited: last %u, avg %u\n"
+        "Widgets skipped: last %u, avg %u\n"
+        "Versioned widgets skipped: last %u, avg %u",
+        eez::gui::g_skipStaticWidgets ? "ON" : "OFF",
+        (unsigned)statistics.numFrames,
+        (unsigned)statistics.frameTime,
+        (unsigned)(statistics.totalFrameTime / numFrames),
+        (unsigned)statistics.maxFrameTime,
+        (unsigned)statistics.numWidgetsVisited,
+        (unsigned)(statistics.totalWidgetsVisited / numFrames),
+        (unsigned)statistics.numWidgetsSkipped,
+        (unsigned)(statistics.totalWidgetsSkipped / numFrames),
+        (unsigned)statistics.numVersionedWidgetsSkipped,
+        (unsigned)(statistics.totalVersionedWidgetsSkipped / numFrames));
+
+    SCPI_ResultCharacters(context, buffer, strlen(buffer));
+
+    return SCPI_RES_OK;
+#else
+    SCPI_ErrorPush(context, SCPI_ERROR_HARDWARE_MISSING);
+    return SCPI_RES_ERR;
+#endif
+}
+
+scpi_result_t scpi_cmd_debugGuiUpdateSkip(scpi_t *context) {
+#if OPTION_DISPLAY
+    bool skip;
+    if (!SCPI_ParamBool(context, &skip, TRUE)) {
+        return SCPI_RES_ERR;
+    }
+
+    eez::gui::g_skipStaticWidgets = skip;
+
+    // start measuring from scratch, so both modes can be compared
+    eez::gui::resetUpdateScreenStatistics();
+
+    return SCPI_RES_OK;
+#else
+    SCPI_ErrorPush(context, SCPI_ERROR_HARDWARE_MISSING);
+    return SCPI_RES_ERR;
+#endif
+}
+
+scpi_result_t scpi_cmd_debugGuiTimingQ(scpi_t *context) {
+#if OPTION_DISPLAY
+    using namespace eez::gui::profiler;
+
+    PhaseStatistics statistics[NUM_PHASES + 1];
+    getStatistics(statistics);
+
+    char buffer[512];
+    char *p = buffer;
+
+    sprintf(p, "Frames: %d\n", getNumFrames());
+    p += strlen(p);
+
+    for (int phase = 0; phase <= NUM_PHASES; phase++) {
+        sprintf(p, "%s: min %u us, avg %u us, p99 %u us, max %u us\n",
+            getPhaseName(phase),
+            (unsigned)statistics[phase].min,
+            (unsigned)statistics[phase].avg,
+            (unsigned)statistics[phase].p99,
+            (unsigned)statistics[phase].max);
+        p += strlen(p);
+    }
+
+    // remove last new line
+    *--p = 0;
+
+    SCPI_ResultCharacters(context, buffer, strlen(buffer));
+
+    return SCPI_RES_OK;
+#else
+    SCPI_ErrorPush(context, SCPI_ERROR_HARDWARE_MISSING);
+    return SCPI_RES_ERR;
+#endif
+}
+
+scpi_result_t scpi_cmd_debugGuiTimingOverlay(scpi_t *context) {
+#if defined(EEZ_PLATFORM_SIMULATOR) && OPTION_DISPLAY
+    bool visible;
+    if (!SCPI_ParamBool(context, &visible, TRUE)) {
+        return SCPI_RES_ERR;
+    }
+
+    eez::gui::profiler::setOverlayVisible(visible);
+
+    return SCPI_RES_OK;
+#else
+    SCPI_ErrorPush(context, SCPI_ERROR_HARDWARE_MISSING);
+    return SCPI_RES_ERR;
+#endif
+}
+
+#define CONF_COLORS_BENCHMARK_DEFAULT_NUM_REPEATS 100
+#define CONF_COLORS_BENCHMARK_MAX_NUM_REPEATS 10000
+
+scpi_result_t scpi_cmd_debugGuiColorsQ(scpi_t *context) {
+#if OPTION_DISPLAY
+    using namespace mcu::display;
+
+    int32_t numRepeats;
+    if (!getBenchmarkRepeatsParam(context, CONF_COLORS_BENCHMARK_DEFAULT_NUM_REPEATS, CONF_COLORS_BENCHMARK_MAX_NUM_REPEATS, &numRepeats)) {
+        return SCPI_RES_ERR;
+    }
+
+    ColorsBenchmarkResult result;
+    benchmarkColors(numRepeats, result);
+
+    uint32_t numLookups = numRepeats * result.numColors;
+
+    char buffer[BENCHMARK_RESULT_BUFFER_SIZE];
+    sprintf(buffer,
+        "Colors: %u, luminosity step: %u\n"
+        "Palette build: %u us\n"
+        "HSL adjust: %.1f ns/color\n"
+        "Palette lookup: %.1f ns/color (%.1fx)",
+        (unsigned)result.numColors,
+        (unsigned)result.luminosityStep,
+        (unsigned)result.buildTime,
+        numLookups > 0 ? 1000.0 * result.referenceTime / numLookups : 0.0,
+        numLookups > 0 ? 1000.0 * result.time / numLookups : 0.0,
+        result.time > 0 ? 1.0 * result.referenceTime / result.time : 0.0);
+
+    return returnBenchmarkResult(context, buffer);
+#else
+    SCPI_ErrorPush(context, SCPI_ERROR_HARDWARE_MISSING);
+    return SCPI_RES_ERR;
+#endif
+}
+
+#define CONF_PARSE_BENCHMARK_DEFAULT_NUM_REPEATS 10
+#define CONF_PARSE_BENCHMARK_MAX_NUM_REPEATS 1000
+
+// Scratch file name that can't collide with the user files. Returns false
+// if such file, for whatever reason, already exists, so it is never overwritten.
+static bool getBenchmarkFilePath(char *filePath, const char *dirPath, const char *extension, int *err) {
+    snprintf(filePath, MAX_PATH_LENGTH, "%s" PATH_SEPARATOR "~benchmark_%08X%s", dirPath, (unsigned)micros(), extension);
+    filePath[MAX_PATH_LENGTH - 1] = 0;
+
+    if (sd_card::exists(filePath, nullptr)) {
+        *err = SCPI_ERROR_FILE_NAME_ERROR;
+        return false;
+    }
+
+    return true;
+}
+
+static uint32_t getBenchmarkFileSize(const char *filePath) {
+    File file;
+    if (!file.open(filePath, FILE_OPEN_EXISTING | FILE_READ)) {
+        return 0;
+    }
+    uint32_t size = file.size();
+    file.close();
+    return size;
+}
+
+scpi_result_t scpi_cmd_debugParseQ(scpi_t *context) {
+    int32_t numRepeats;
+    if (!getBenchmarkRepeatsParam(context, CONF_PARSE_BENCHMARK_DEFAULT_NUM_REPEATS, CONF_PARSE_BENCHMARK_MAX_NUM_REPEATS, &numRepeats)) {
+        return SCPI_RES_ERR;
+    }
+
+    int err;
+
+    char listFilePath[MAX_PATH_LENGTH];
+    if (!getBenchmarkFilePath(listFilePath, LISTS_DIR, ".list", &err)) {
+        SCPI_ErrorPush(context, err);
+        return SCPI_RES_ERR;
+    }
+
+    uint32_t listLoadTime;
+    uint32_t numMismatches;
+    bool result = list::benchmarkLoadList(listFilePath, numRepeats, listLoadTime, numMismatches, &err);
+    uint32_t listFileSize = getBenchmarkFileSize(listFilePath);
+    sd_card::deleteFile(listFilePath, nullptr);
+    if (!result) {
+        SCPI_ErrorPush(context, err);
+        return SCPI_RES_ERR;
+    }
+
+    char profileFilePath[MAX_PATH_LENGTH];
+    if (!getBenchmarkFilePath(profileFilePath, PROFILES_DIR, ".profile", &err)) {
+        SCPI_ErrorPush(context, err);
+        return SCPI_RES_ERR;
+    }
+
+    uint32_t profileLoadTime;
+    result = profile::benchmarkLoadProfile(profileFilePath, numRepeats, profileLoadTime, &err);
+    uint32_t profileFileSize = getBenchmarkFileSize(profileFilePath);
+    sd_card::deleteFile(profileFilePath, nullptr);
+    if (!result) {
+        SCPI_ErrorPush(context, err);
+        return SCPI_RES_ERR;
+    }
+
+    char buffer[BENCHMARK_RESULT_BUFFER_SIZE];
+    sprintf(buffer,
+        "List: %u bytes, %u us/load, %.2f MB/s, mismatches: %u\n"
+        "Profile: %u bytes, %u us/load, %.2f MB/s",
+        (unsigned)listFileSize,
+        (unsigned)(listLoadTime / numRepeats),
+        listLoadTime > 0 ? 1.0 * listFileSize * numRepeats / listLoadTime : 0.0,
+        (unsigned)numMismatches,
+        (unsigned)profileFileSize,
+        (unsigned)(profileLoadTime / numRepeats),
+        profileLoadTime > 0 ? 1.0 * profileFileSize * numRepeats / profileLoadTime : 0.0);
+
+    return returnBenchmarkResult(context, buffer);
+}
+
+#if defined(EEZ_PLATFORM_SIMULATOR)
+
+////////////////////////////////////////////////////////////////////////////////
+// SCPI throughput benchmark
+//
+// Command mix is a text, one command per line, split in families:
+//
+//     [family name]
+//     command
+//     command
+//     ...
+//
+// Every command line is passed through psu::scpi::input, same as for serial,
+// ethernet and MicroPython, to the separate SCPI context with discarded output.
+//
+// Commands are really executed. Channel 1 set values and lists, changed by the default mix,
+// are restored afterwards and its MMEM commands use a scratch file. Custom mix is
+// executed as it is, so it should contain only the commands that are safe to run.
+
+#define CONF_SCPI_BENCHMARK_DEFAULT_NUM_REPEATS 10
+#define CONF_SCPI_BENCHMARK_MAX_NUM_REPEATS 1000
+#define CONF_SCPI_BENCHMARK_MAX_NUM_FAMILIES 8
+#define CONF_SCPI_BENCHMARK_MAX_NUM_SAMPLES 16384
+#define CONF_SCPI_BENCHMARK_MAX_MIX_SIZE 8192
+
+// %s is the scratch file path
+static const char *g_benchmarkDefaultMixFormat =
+    "[setpoint]\n"
+    "INST:NSEL 1\n"
+    "VOLT 1.5\n"
+    "CURR 0.5\n"
+    "VOLT 2.5\n"
+    "CURR 1\n"
+    "[measure]\n"
+    "MEAS:VOLT?\n"
+    "MEAS:CURR?\n"
+    "MEAS:POW?\n"
+    "[list]\n"
+    "LIST:VOLT 1,2,3,4,5,6,7,8,9,10\n"
+    "LIST:CURR 0.1,0.2,0.3,0.4,0.5,0.6,0.7,0.8,0.9,1\n"
+    "LIST:DWEL 0.01\n"
+    "LIST:VOLT?\n"
+    "[mmem]\n"
+    "MMEM:DOWN:FNAM \"%s\"\n"
+    "MMEM:DOWN:SIZE 64\n"
+    "MMEM:DOWN:DATA #2640123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF\n"
+    "MMEM:DOWN:FNAM \"%s\"\n"
+    "MMEM:UPL? \"%s\"\n"
+    "MMEM:DEL \"%s\"\n";
+
+struct BenchmarkSavedState {
+    float uSet;
+    float iSet;
+    uint16_t dwellListLength;
+    uint16_t voltageListLength;
+    uint16_t currentListLength;
+    float dwellList[MAX_LIST_LENGTH];
+    float voltageList[MAX_LIST_LENGTH];
+    float currentList[MAX_LIST_LENGTH];
+};
+
+struct BenchmarkFamily {
+    char name[16];
+    uint32_t firstSample;
+    uint32_t numSamples;
+    uint32_t totalTime;
+};
+
+static char g_benchmarkMix[CONF_SCPI_BENCHMARK_MAX_MIX_SIZE + 1];
+static BenchmarkFamily g_benchmarkFamilies[CONF_SCPI_BENCHMARK_MAX_NUM_FAMILIES];
+static uint32_t g_benchmarkSamples[CONF_SCPI_BENCHMARK_MAX_NUM_SAMPLES];
+static uint32_t g_benchmarkNumErrors;
+static uint32_t g_benchmarkNumOutputBytes;
+static BenchmarkSavedState g_benchmarkSavedState;
+
+static size_t benchmarkWrite(scpi_t *context, const char *data, size_t len) {
+    g_benchmarkNumOutputBytes += len;
+    return len;
+}
+
+static scpi_result_t benchmarkFlush(scpi_t *context) {
+    return SCPI_RES_OK;
+}
+
+static int benchmarkError(scpi_t *context, int_fast16_t err) {
+    if (err != 0) {
+        g_benchmarkNumErrors++;
+    }
+    return 0;
+}
+
+static scpi_result_t benchmarkControl(scpi_t *context, scpi_ctrl_name_t ctrl, scpi_reg_val_t val) {
+    return SCPI_RES_OK;
+}
+
+static scpi_result_t benchmarkReset(scpi_t *context) {
+    return SCPI_RES_OK;
+}
+
+static scpi_interface_t g_benchmarkScpiInterface = {
+    benchmarkError, benchmarkWrite, benchmarkControl, benchmarkFlush, benchmarkReset,
+};
+
+static scpi_reg_val_t g_benchmarkScpiPsuRegs[eez::scpi::SCPI_PSU_REG_COUNT];
+static scpi_psu_t g_benchmarkScpiPsuContext = { g_benchmarkScpiPsuRegs };
+static char g_benchmarkScpiInputBuffer[SCPI_PARSER_INPUT_BUFFER_LENGTH];
+static scpi_error_t g_benchmarkErrorQueueData[SCPI_PARSER_ERROR_QUEUE_SIZE + 1];
+static scpi_t g_benchmarkScpiContext;
+
+static int compareBenchmarkSamples(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static uint32_t getBenchmarkPercentile(const uint32_t *samples, uint32_t numSamples, uint32_t percentile) {
+    uint32_t rank = (numSamples * percentile + 99) / 100;
+    return samples[rank > 0 ? rank - 1 : 0];
+}
+
+static bool loadBenchmarkMix(scpi_t *context, const char *filePath) {
+    File file;
+    if (!file.open(filePath, FILE_OPEN_EXISTING | FILE_READ)) {
+        SCPI_ErrorPush(context, SCPI_ERROR_FILE_NOT_FOUND);
+        return false;
+    }
+
+    size_t fileSize = file.size();
+    if (fileSize > CONF_SCPI_BENCHMARK_MAX_MIX_SIZE) {
+        file.close();
+        SCPI_ErrorPush(context, SCPI_ERROR_OUT_OF_DEVICE_MEMORY);
+        return false;
+    }
+
+    size_t bytesRead = file.read(g_benchmarkMix, fileSize);
+    file.close();
+
+    if (bytesRead != fileSize) {
+        SCPI_ErrorPush(context, SCPI_ERROR_MASS_STORAGE_ERROR);
+        return false;
+    }
+
+    g_benchmarkMix[fileSize] = 0;
+
+    return true;
+}
+
+static void saveBenchmarkState(Channel &channel) {
+    BenchmarkSavedState &state = g_benchmarkSavedState;
+
+    state.uSet = channel_dispatcher::getUSet(channel);
+    state.iSet = channel_dispatcher::getISet(channel);
+
+    float *list = list::getDwellList(channel, &state.dwellListLength);
+    memcpy(state.dwellList, list, state.dwellListLength * sizeof(float));
+
+    list = list::getVoltageList(channel, &state.voltageListLength);
+    memcpy(state.voltageList, list, state.voltageListLength * sizeof(float));
+
+    list = list::getCurrentList(channel, &state.currentListLength);
+    memcpy(state.currentList, list, state.currentListLength * sizeof(float));
+}
+
+static void restoreBenchmarkState(Channel &channel) {
+    BenchmarkSavedState &state = g_benchmarkSavedState;
+
+    list::setDwellList(channel, state.dwellList, state.dwellListLength);
+    list::setVoltageList(channel, state.voltageList, state.voltageListLength);
+    list::setCurrentList(channel, state.currentList, state.currentListLength);
+
+    channel_dispatcher::setVoltage(channel, state.uSet);
+    channel_dispatcher::setCurrent(channel, state.iSet);
+}
+
+// Runs all command lines of the family numRepeats times, returns false if there is no more space for samples.
+static bool runBenchmarkFamily(BenchmarkFamily &family, const char *commands, const char *commandsEnd, int numRepeats) {
+    for (int i = 0; i < numRepeats; i++) {
+        const char *line = commands;
+        while (line < commandsEnd) {
+            const char *lineEnd = line;
+            while (lineEnd < commandsEnd && *lineEnd != '\n') {
+                lineEnd++;
+            }
+
+            size_t lineLen = lineEnd - line;
+            while (lineLen > 0 && line[lineLen - 1] == '\r') {
+                lineLen--;
+            }
+
+            if (lineLen > 0) {
+                if (family.firstSample + family.numSamples == CONF_SCPI_BENCHMARK_MAX_NUM_SAMPLES) {
+                    return false;
+                }
+
+                uint32_t start = micros();
+                input(g_benchmarkScpiContext, line, lineLen);
+                input(g_benchmarkScpiContext, "\n", 1);
+                uint32_t latency = micros() - start;
+
+                g_benchmarkSamples[family.firstSample + family.numSamples++] = latency;
+                family.totalTime += latency;
+            }
+
+            line = lineEnd + 1;
+        }
+    }
+
+    return true;
+}
+
+#endif // EEZ_PLATFORM_SIMULATOR
+
+scpi_result_t scpi_cmd_debugScpiBenchmarkQ(scpi_t *context) {
+#if defined(EEZ_PLATFORM_SIMULATOR)
+    int32_t numRepeats;
+    if (!getBenchmarkRepeatsParam(context, CONF_SCPI_BENCHMARK_DEFAULT_NUM_REPEATS, CONF_SCPI_BENCHMARK_MAX_NUM_REPEATS, &numRepeats)) {
+        return SCPI_RES_ERR;
+    }
+
+    char filePath[MAX_PATH_LENGTH + 1];
+    bool isFilePathSpecified;
+    if (!getFilePath(context, filePath, false, &isFilePathSpecified)) {
+        return SCPI_RES_ERR;
+    }
+
+    char scratchFilePath[MAX_PATH_LENGTH];
+    if (isFilePathSpecified) {
+        if (!loadBenchmarkMix(context, filePath)) {
+            return SCPI_RES_ERR;
+        }
+    } else {
+        int err;
+        if (!getBenchmarkFilePath(scratchFilePath, "", ".txt", &err)) {
+            SCPI_ErrorPush(context, err);
+            return SCPI_RES_ERR;
+        }
+        snprintf(g_benchmarkMix, sizeof(g_benchmarkMix), g_benchmarkDefaultMixFormat,
+            scratchFilePath, scratchFilePath, scratchFilePath, scratchFilePath);
+    }
+
+    const char *mix = g_benchmarkMix;
+
+    Channel &channel = Channel::get(0);
+    saveBenchmarkState(channel);
+
+    init(g_benchmarkScpiContext, g_benchmarkScpiPsuContext, &g_benchmarkScpiInterface,
+         g_benchmarkScpiInputBuffer, SCPI_PARSER_INPUT_BUFFER_LENGTH, g_benchmarkErrorQueueData,
+         SCPI_PARSER_ERROR_QUEUE_SIZE + 1);
+
+    g_benchmarkNumErrors = 0;
+    g_benchmarkNumOutputBytes = 0;
+
+    int numFamilies = 0;
+    uint32_t numSamples = 0;
+    bool overflow = false;
+
+    const char *p = mix;
+    while (*p && !overflow) {
+        // family header
+        const char *name = "default";
+        size_t nameLen = strlen(name);
+        if (*p == '[') {
+            name = ++p;
+            while (*p && *p != ']' && *p != '\n') {
+                p++;
+            }
+            nameLen = p - name;
+            while (*p && *p != '\n') {
+                p++;
+            }
+            if (*p) {
+                p++;
+            }
+        }
+
+        // family commands, until the next family header
+        const char *commands = p;
+        while (*p && *p != '[') {
+            while (*p && *p != '\n') {
+                p++;
+            }
+            if (*p) {
+                p++;
+            }
+        }
+
+        if (numFamilies == CONF_SCPI_BENCHMARK_MAX_NUM_FAMILIES) {
+            overflow = true;
+            break;
+        }
+
+        BenchmarkFamily &family = g_benchmarkFamilies[numFamilies++];
+        nameLen = MIN(nameLen, sizeof(family.name) - 1);
+        strncpy(family.name, name, nameLen);
+        family.name[nameLen] = 0;
+        family.firstSample = numSamples;
+        family.numSamples = 0;
+        family.totalTime = 0;
+
+        overflow = !runBenchmarkFamily(family, commands, p, numRepeats);
+
+        numSamples += family.numSamples;
+    }
+
+    restoreBenchmarkState(channel);
+
+    if (!isFilePathSpecified && sd_card::exists(scratchFilePath, nullptr)) {
+        sd_card::deleteFile(scratchFilePath, nullptr);
+    }
+
+    char buffer[BENCHMARK_RESULT_BUFFER_SIZE];
+    char *q = buffer;
+    uint32_t totalTime = 0;
+
+    for (int i = 0; i < numFamilies; i++) {
+        BenchmarkFamily &family = g_benchmarkFamilies[i];
+        if (family.numSamples == 0) {
+            continue;
+        }
+
+        uint32_t *samples = g_benchmarkSamples + family.firstSample;
+        qsort(samples, family.numSamples, sizeof(uint32_t), compareBenchmarkSamples);
+
+        sprintf(q, "%s: %u cmds, p50 %u us, p99 %u us, %.0f cmds/s\n", family.name,
+            (unsigned)family.numSamples,
+            (unsigned)getBenchmarkPercentile(samples, family.numSamples, 50),
+            (unsigned)getBenchmarkPercentile(samples, family.numSamples, 99),
+            family.totalTime > 0 ? family.numSamples * 1E6 / family.totalTime : 0.0);
+        q += strlen(q);
+
+        totalTime += family.totalTime;
+    }
+
+    sprintf(q, "total: %u cmds, %.0f cmds/s, %u errors, %u output bytes%s",
+        (unsigned)numSamples,
+        totalTime > 0 ? numSamples * 1E6 / totalTime : 0.0,
+        (unsigned)g_benchmarkNumErrors,
+        (unsigned)g_benchmarkNumOutputBytes,
+        overflow ? ", truncated" : "");
+
+    return returnBenchmarkResult(context, buffer);
+#else
+    SCPI_ErrorPush(context, SCPI_ERROR_HARDWARE_MISSING);
+    return SCPI_RES_ERR;
+#endif
+}
+
 } // namespace scpi
 } // namespace psu
 } // namespace eez
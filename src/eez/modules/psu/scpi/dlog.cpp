@@ -25,6 +25,10 @@ namespace eez {
 namespace psu {
 namespace scpi {
 
+// SENSe:DLOG:DATA? response block: U32 first row index, U16 number of columns, U16 number of rows, rows
+#define DLOG_DATA_HEADER_SIZE 8
+#define CONF_DLOG_DATA_MAX_SIZE 4096
+
 scpi_result_t scpi_cmd_abortDlog(scpi_t *context) {
     dlog_record::abort();
     return SCPI_RES_OK;
@@ -143,6 +147,27 @@ scpi_result_t scpi_cmd_senseDlogFunctionPowerQ(scpi_t *context) {
     return SCPI_RES_OK;
 }
 
+scpi_result_t scpi_cmd_senseDlogCompression(scpi_t *context) {
+    if (!dlog_record::isIdle()) {
+        SCPI_ErrorPush(context, SCPI_ERROR_CANNOT_CHANGE_TRANSIENT_TRIGGER);
+        return SCPI_RES_ERR;
+    }
+
+    bool enable;
+    if (!SCPI_ParamBool(context, &enable, TRUE)) {
+        return SCPI_RES_ERR;
+    }
+
+    dlog_record::g_parameters.compression = enable;
+
+    return SCPI_RES_OK;
+}
+
+scpi_result_t scpi_cmd_senseDlogCompressionQ(scpi_t *context) {
+    SCPI_ResultBool(context, dlog_record::g_parameters.compression);
+    return SCPI_RES_OK;
+}
+
 scpi_result_t scpi_cmd_senseDlogPeriod(scpi_t *context) {
     if (!dlog_record::isIdle()) {
         SCPI_ErrorPush(context, SCPI_ERROR_CANNOT_CHANGE_TRANSIENT_TRIGGER);
@@ -752,6 +777,37 @@ scpi_result_t scpi_cmd_initiateDlogTrace(scpi_t *context) {
     return SCPI_RES_OK;
 }
 
+scpi_result_t scpi_cmd_senseDlogDataQ(scpi_t *context) {
+    if (!dlog_record::isExecuting()) {
+        SCPI_ErrorPush(context, SCPI_ERROR_EXECUTION_ERROR);
+        return SCPI_RES_ERR;
+    }
+
+    uint32_t rowIndex;
+    if (!SCPI_ParamUInt32(context, &rowIndex, true)) {
+        return SCPI_RES_ERR;
+    }
+
+    static uint8_t buffer[DLOG_DATA_HEADER_SIZE + CONF_DLOG_DATA_MAX_SIZE];
+
+    uint8_t numYAxes = dlog_record::g_recording.parameters.numYAxes;
+    uint32_t rowSize = numYAxes * sizeof(float);
+    uint32_t numRows = dlog_record::getLiveRows(rowIndex, buffer + DLOG_DATA_HEADER_SIZE, CONF_DLOG_DATA_MAX_SIZE / rowSize);
+
+    buffer[0] = rowIndex & 0xFF;
+    buffer[1] = (rowIndex >> 8) & 0xFF;
+    buffer[2] = (rowIndex >> 16) & 0xFF;
+    buffer[3] = rowIndex >> 24;
+    buffer[4] = numYAxes;
+    buffer[5] = 0;
+    buffer[6] = numRows & 0xFF;
+    buffer[7] = numRows >> 8;
+
+    SCPI_ResultArbitraryBlock(context, buffer, DLOG_DATA_HEADER_SIZE + numRows * rowSize);
+
+    return SCPI_RES_OK;
+}
+
 scpi_result_t scpi_cmd_senseDlogTraceData(scpi_t *context) {
     if (!dlog_record::isTraceExecuting()) {
         SCPI_ErrorPush(context, SCPI_ERROR_EXECUTION_ERROR);
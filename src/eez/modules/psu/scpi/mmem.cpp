@@ -163,8 +163,13 @@ scpi_result_t scpi_cmd_mmemoryInformationQ(scpi_t *context) {
         return SCPI_RES_ERR;
     }
 
+    uint32_t uploadRate, downloadRate;
+    sd_card::getTransferRates(uploadRate, downloadRate);
+
     SCPI_ResultUInt64(context, usedSpace);
     SCPI_ResultUInt64(context, freeSpace);
+    SCPI_ResultUInt32(context, uploadRate);
+    SCPI_ResultUInt32(context, downloadRate);
 
     return SCPI_RES_OK;
 }
@@ -234,11 +239,14 @@ void startDownloading() {
 }
 
 void finishDownloading(int16_t eventId) {
-	sd_card::downloadFinished();
-
-	if (eventId != event_queue::EVENT_INFO_FILE_DOWNLOAD_SUCCEEDED) {
-        sd_card::deleteFile(g_downloadFilePath, 0);
+    // if download didn't succeed, destination file is left unchanged
+    int err;
+	if (!sd_card::downloadFinished(eventId == event_queue::EVENT_INFO_FILE_DOWNLOAD_SUCCEEDED, &err)) {
+        if (eventId == event_queue::EVENT_INFO_FILE_DOWNLOAD_SUCCEEDED) {
+            eventId = event_queue::EVENT_ERROR_FILE_DOWNLOAD_FAILED;
+        }
     }
+
     event_queue::pushEvent(eventId);
 #if OPTION_DISPLAY
     psu::gui::hideProgressPage();
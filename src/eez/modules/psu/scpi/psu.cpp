@@ -41,6 +41,13 @@ SCPI_COMMANDS
 #define SCPI_COMMAND(P, C) { P, C },
 static const scpi_command_t scpi_commands[] = { SCPI_COMMANDS SCPI_CMD_LIST_END };
 
+// Command index is shared by all SCPI contexts (serial, ethernet, ...),
+// it is built only once, before any SCPI context is initialized.
+static const size_t NUM_SCPI_COMMANDS = sizeof(scpi_commands) / sizeof(scpi_commands[0]);
+static uint16_t g_commandIndexEntries[2 * NUM_SCPI_COMMANDS];
+static scpi_command_index_t g_commandIndex;
+static bool g_commandIndexValid = SCPI_CommandIndexInit(&g_commandIndex, scpi_commands, g_commandIndexEntries, 2 * NUM_SCPI_COMMANDS);
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void init(scpi_t &scpi_context, scpi_psu_t &scpi_psu_context, scpi_interface_t *interface,
@@ -50,6 +57,9 @@ void init(scpi_t &scpi_context, scpi_psu_t &scpi_psu_context, scpi_interface_t *
               getSerialNumber(), MCU_FIRMWARE, input_buffer, input_buffer_length,
               error_queue_data, error_queue_size);
 
+    if (g_commandIndexValid) {
+        scpi_context.cmdindex = &g_commandIndex;
+    }
 
     if (CH_NUM > 0) {
         auto &channel = Channel::get(0);
@@ -16,7 +16,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #if defined(EEZ_PLATFORM_STM32)
@@ -25,7 +27,9 @@
 #include <fatfs.h>
 #endif
 
+#include <eez/file_type.h>
 #include <eez/firmware.h>
+#include <eez/memory.h>
 #include <eez/usb.h>
 
 #include <eez/modules/psu/psu.h>
@@ -33,6 +37,7 @@
 #include <scpi/scpi.h>
 
 #include <eez/modules/psu/datetime.h>
+#include <eez/modules/psu/dlog_view.h>
 #include <eez/modules/psu/event_queue.h>
 #include <eez/modules/psu/list_program.h>
 #include <eez/modules/psu/profile.h>
@@ -53,6 +58,9 @@ extern "C" int g_sdCardIsPresent;
 #define CONF_DEBOUNCE_TIMEOUT_MS 500
 #define CONF_DOWNLOAD_TIMEOUT_MS 10000
 
+#define DOWNLOAD_TEMP_FILE_EXTENSION ".part"
+#define DOWNLOAD_JOURNAL_FILE_PATH (PATH_SEPARATOR "download.jnl")
+
 namespace eez {
 
 SdFat SD;
@@ -80,9 +88,32 @@ static State g_state;
 TestResult g_testResult = TEST_FAILED;
 int g_lastError;
 
+// buffers are 32-bit aligned and multiple of the sector size
+static uint8_t * const UPLOAD_BUFFERS = FILE_TRANSFER_BUFFER;
+static const uint32_t UPLOAD_BUFFER_SIZE = 16 * 1024;
+static const uint32_t NUM_UPLOAD_BUFFERS = 2;
+
+static uint8_t * const DOWNLOAD_BUFFER = UPLOAD_BUFFERS + NUM_UPLOAD_BUFFERS * UPLOAD_BUFFER_SIZE;
+static const uint32_t DOWNLOAD_BUFFER_SIZE = FILE_TRANSFER_BUFFER_SIZE - NUM_UPLOAD_BUFFERS * UPLOAD_BUFFER_SIZE;
+
+static File g_uploadFile;
+static uint32_t g_lastUploadRate;
+
 static File g_downloadFile;
 static uint32_t g_downloadedFileOffset;
+static uint32_t g_downloadBufferPosition;
+static uint32_t g_downloadStartTime;
 static char g_downloadFilePath[MAX_PATH_LENGTH + 1];
+static char g_downloadTempFilePath[MAX_PATH_LENGTH + sizeof(DOWNLOAD_TEMP_FILE_EXTENSION)];
+static uint32_t g_lastDownloadRate;
+
+// Download in progress is recorded in the journal file, so after a power loss
+// the temporary file is either deleted (not completed) or moved over
+// the destination file (completed), see recoverDownload.
+struct DownloadJournal {
+    uint8_t completed;
+    char filePath[MAX_PATH_LENGTH + 1];
+};
 
 static uint32_t g_getInfoVersion;
 
@@ -93,9 +124,13 @@ static uint32_t g_debounceTimeout;
 static void stateTransition(Event event);
 static void testTimeoutEvent(uint32_t &timeout, Event timeoutEvent);
 
+static void initTransfer();
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void init() {
+    initTransfer();
+
 #if defined(EEZ_PLATFORM_STM32)
     MX_SDMMC1_SD_Init();
 	g_sdCardIsPresent = HAL_GPIO_ReadPin(SD_DETECT_GPIO_Port, SD_DETECT_Pin) == GPIO_PIN_RESET ? 1 : 0;
@@ -268,13 +303,97 @@ bool catalogLength(const char *dirPath, size_t *length, int *err) {
     return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// File transfer (MMEMory:UPLoad and MMEMory:DOWNload)
+//
+// Upload: file is read in big chunks into the aligned buffers by the read ahead thread,
+// so the next chunk is read from SD card while the current one is sent.
+//
+// Download: received data is collected in the write behind buffer and written
+// to the temporary file, one full buffer at a time. Every buffer written is also synced,
+// so after SD card error file can be reopened and the buffer written again.
+// Only when all the data is downloaded, temporary file replaces the destination file,
+// so after the failure or crash the destination file is never partially written.
+
+static void uploadReadAheadThreadMainLoop(const void *);
+
+#if defined(EEZ_PLATFORM_STM32)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wwrite-strings"
+#endif
+
+osThreadDef(g_uploadReadAheadTask, uploadReadAheadThreadMainLoop, osPriorityNormal, 0, 1024);
+
+#if defined(EEZ_PLATFORM_STM32)
+#pragma GCC diagnostic pop
+#endif
+
+osMessageQDef(g_uploadReadRequestQueue, NUM_UPLOAD_BUFFERS, uint32_t);
+osMessageQId g_uploadReadRequestQueueId;
+
+osMessageQDef(g_uploadReadResultQueue, NUM_UPLOAD_BUFFERS, uint32_t);
+osMessageQId g_uploadReadResultQueueId;
+
+osMutexId(g_uploadMutexId);
+osMutexDef(g_uploadMutex);
+
+static void initTransfer() {
+    g_uploadMutexId = osMutexCreate(osMutex(g_uploadMutex));
+    g_uploadReadRequestQueueId = osMessageCreate(osMessageQ(g_uploadReadRequestQueue), 0);
+    g_uploadReadResultQueueId = osMessageCreate(osMessageQ(g_uploadReadResultQueue), 0);
+
+#if !defined(__EMSCRIPTEN__)
+    osThreadCreate(osThread(g_uploadReadAheadTask), nullptr);
+#endif
+}
+
+static uint32_t getTransferRate(uint32_t numBytes, uint32_t startTime) {
+    uint32_t duration = millis() - startTime;
+    return (uint32_t)(numBytes * 1000ULL / (duration > 0 ? duration : 1));
+}
+
+static void readUploadBuffer(uint32_t bufferIndex) {
+    uint32_t size = g_uploadFile.read(UPLOAD_BUFFERS + bufferIndex * UPLOAD_BUFFER_SIZE, UPLOAD_BUFFER_SIZE);
+    osMessagePut(g_uploadReadResultQueueId, size, osWaitForever);
+}
+
+static void uploadReadAheadThreadMainLoop(const void *) {
+    while (true) {
+        osEvent event = osMessageGet(g_uploadReadRequestQueueId, osWaitForever);
+        if (event.status == osEventMessage) {
+            readUploadBuffer(event.value.v);
+        }
+    }
+}
+
+static void requestUploadRead(uint32_t bufferIndex) {
+#if defined(__EMSCRIPTEN__)
+    // there is no read ahead thread, read immediately
+    readUploadBuffer(bufferIndex);
+#else
+    osMessagePut(g_uploadReadRequestQueueId, bufferIndex, osWaitForever);
+#endif
+}
+
+static uint32_t waitUploadRead() {
+    osEvent event = osMessageGet(g_uploadReadResultQueueId, osWaitForever);
+    return event.status == osEventMessage ? event.value.v : 0;
+}
+
 bool upload(const char *filePath, void *param, void (*callback)(void *param, const void *buffer, int size), int *err) {
     if (!sd_card::isMounted(err)) {
         return false;
     }
 
-    File file;
-    if (!file.open(filePath, FILE_OPEN_EXISTING | FILE_READ)) {
+    // upload buffers and read ahead thread are shared by all the interfaces
+    if (osMutexWait(g_uploadMutexId, osWaitForever) != osOK) {
+        if (err)
+            *err = SCPI_ERROR_MASS_STORAGE_ERROR;
+        return false;
+    }
+
+    if (!g_uploadFile.open(filePath, FILE_OPEN_EXISTING | FILE_READ)) {
+        osMutexRelease(g_uploadMutexId);
         if (err)
             *err = SCPI_ERROR_FILE_NAME_NOT_FOUND;
         return false;
@@ -282,7 +401,7 @@ bool upload(const char *filePath, void *param, void (*callback)(void *param, con
 
     bool result = true;
 
-    size_t totalSize = file.size();
+    size_t totalSize = g_uploadFile.size();
     size_t uploaded = 0;
 
 #if OPTION_DISPLAY
@@ -293,15 +412,35 @@ bool upload(const char *filePath, void *param, void (*callback)(void *param, con
 
     callback(param, NULL, totalSize);
 
-    const int CHUNK_SIZE = 512;
-    uint8_t buffer[CHUNK_SIZE];
+    uint32_t startTime = millis();
 
-    while (true) {
-        int size = file.read(buffer, CHUNK_SIZE);
+    int numPendingReads = 0;
+    size_t requested = 0;
+    for (uint32_t i = 0; i < NUM_UPLOAD_BUFFERS && requested < totalSize; i++) {
+        requestUploadRead(i);
+        numPendingReads++;
+        requested += UPLOAD_BUFFER_SIZE;
+    }
+
+    uint32_t bufferIndex = 0;
+
+    while (numPendingReads > 0) {
+        uint32_t size = waitUploadRead();
+        numPendingReads--;
+
+        // file could be changed in the meantime, send only what was announced in the header
+        uint32_t expectedSize = (uint32_t)MIN(UPLOAD_BUFFER_SIZE, totalSize - uploaded);
+        if (size < expectedSize) {
+            if (err) {
+                *err = SCPI_ERROR_MASS_STORAGE_ERROR;
+            }
+            result = false;
+            break;
+        }
 
-        callback(param, buffer, size);
+        callback(param, UPLOAD_BUFFERS + bufferIndex * UPLOAD_BUFFER_SIZE, expectedSize);
 
-        uploaded += size;
+        uploaded += expectedSize;
 
 #if OPTION_DISPLAY
         if (!psu::gui::updateProgressPage(uploaded, totalSize)) {
@@ -315,18 +454,28 @@ bool upload(const char *filePath, void *param, void (*callback)(void *param, con
         }
 #endif
 
-        if (size < CHUNK_SIZE) {
-        	if (uploaded < totalSize) {
-                if (err) {
-                    *err = SCPI_ERROR_MASS_STORAGE_ERROR;
-                }
-                result = false;
-        	}
-            break;
+        // this buffer is sent, it can be used for the next chunk
+        if (requested < totalSize) {
+            requestUploadRead(bufferIndex);
+            numPendingReads++;
+            requested += UPLOAD_BUFFER_SIZE;
         }
+
+        bufferIndex = (bufferIndex + 1) % NUM_UPLOAD_BUFFERS;
     }
 
-    file.close();
+    // file can't be closed while read ahead thread is still using it
+    while (numPendingReads-- > 0) {
+        waitUploadRead();
+    }
+
+    g_uploadFile.close();
+
+    if (result) {
+        g_lastUploadRate = getTransferRate(uploaded, startTime);
+    }
+
+    osMutexRelease(g_uploadMutexId);
 
     callback(param, NULL, -1);
 
@@ -337,30 +486,14 @@ bool upload(const char *filePath, void *param, void (*callback)(void *param, con
     return result;
 }
 
-bool download(const char *filePath, bool truncate, const void *buffer, size_t size, int *perr) {
-    if (!sd_card::isMounted(perr)) {
-        return false;
-    }
-
-	if (truncate) {
-	    if (!g_downloadFile.open(filePath, FILE_CREATE_ALWAYS | FILE_WRITE)) {
-			if (perr) {
-				*perr = SCPI_ERROR_FILE_NAME_NOT_FOUND;
-            }
-			return false;
-		}
-        strcpy(g_downloadFilePath, filePath);
-        g_downloadedFileOffset = 0;
-	}
-
-    int err = 0;
-
+static bool flushDownloadBuffer(int *perr) {
     uint32_t timeout = millis() + CONF_DOWNLOAD_TIMEOUT_MS;
     while (millis() < timeout) {
-        size_t written = g_downloadFile.write((const uint8_t *)buffer, size);
-        if (written == size) {
+        size_t written = g_downloadFile.write(DOWNLOAD_BUFFER, g_downloadBufferPosition);
+        if (written == g_downloadBufferPosition) {
             if (g_downloadFile.sync()) {
-                g_downloadedFileOffset += size;
+                g_downloadedFileOffset += g_downloadBufferPosition;
+                g_downloadBufferPosition = 0;
                 return true;
             }
         }
@@ -370,7 +503,7 @@ bool download(const char *filePath, bool truncate, const void *buffer, size_t si
         bool ropened = false;
 
         while (millis() < timeout) {
-            if (g_downloadFile.open(filePath, FILE_OPEN_EXISTING | FILE_WRITE)) {
+            if (g_downloadFile.open(g_downloadTempFilePath, FILE_OPEN_EXISTING | FILE_WRITE)) {
                 if (g_downloadFile.seek(g_downloadedFileOffset)) {
                     ropened = true;
                     break;
@@ -388,14 +521,164 @@ bool download(const char *filePath, bool truncate, const void *buffer, size_t si
     sd_card::reinitialize();
 
     if (perr) {
-        *perr = err;
+        *perr = SCPI_ERROR_MASS_STORAGE_ERROR;
     }
     return false;
 }
 
-void downloadFinished() {
+static bool writeDownloadJournal(bool completed) {
+    File file;
+
+    if (completed) {
+        // only the first byte is changed, file path is already there
+        if (!file.open(DOWNLOAD_JOURNAL_FILE_PATH, FILE_OPEN_EXISTING | FILE_WRITE)) {
+            return false;
+        }
+        uint8_t value = 1;
+        bool result = file.write(&value, 1) == 1;
+        file.close();
+        return result;
+    }
+
+    if (!file.open(DOWNLOAD_JOURNAL_FILE_PATH, FILE_CREATE_ALWAYS | FILE_WRITE)) {
+        return false;
+    }
+    DownloadJournal journal;
+    journal.completed = 0;
+    strcpy(journal.filePath, g_downloadFilePath);
+    size_t size = offsetof(DownloadJournal, filePath) + strlen(journal.filePath) + 1;
+    bool result = file.write(&journal, size) == size;
+    file.close();
+    return result;
+}
+
+// finishes or cleans up the download interrupted by a power loss or card removal
+static void recoverDownload() {
+    File file;
+    if (!file.open(DOWNLOAD_JOURNAL_FILE_PATH, FILE_OPEN_EXISTING | FILE_READ)) {
+        return;
+    }
+
+    DownloadJournal journal;
+    size_t size = file.read(&journal, sizeof(journal));
+    file.close();
+
+    if (size > offsetof(DownloadJournal, filePath) && memchr(journal.filePath, 0, size - offsetof(DownloadJournal, filePath))) {
+        char tempFilePath[MAX_PATH_LENGTH + sizeof(DOWNLOAD_TEMP_FILE_EXTENSION)];
+        strcpy(tempFilePath, journal.filePath);
+        strcat(tempFilePath, DOWNLOAD_TEMP_FILE_EXTENSION);
+
+        if (SD.exists(tempFilePath)) {
+            if (journal.completed) {
+                if (SD.exists(journal.filePath)) {
+                    SD.remove(journal.filePath);
+                }
+                SD.rename(tempFilePath, journal.filePath);
+            } else {
+                SD.remove(tempFilePath);
+            }
+        }
+    }
+
+    SD.remove(DOWNLOAD_JOURNAL_FILE_PATH);
+}
+
+bool download(const char *filePath, bool truncate, const void *buffer, size_t size, int *perr) {
+    if (!sd_card::isMounted(perr)) {
+        return false;
+    }
+
+	if (truncate) {
+        strcpy(g_downloadFilePath, filePath);
+        strcpy(g_downloadTempFilePath, filePath);
+        strcat(g_downloadTempFilePath, DOWNLOAD_TEMP_FILE_EXTENSION);
+
+        if (!writeDownloadJournal(false)) {
+            if (perr) {
+                *perr = SCPI_ERROR_MASS_STORAGE_ERROR;
+            }
+            return false;
+        }
+
+	    if (!g_downloadFile.open(g_downloadTempFilePath, FILE_CREATE_ALWAYS | FILE_WRITE)) {
+			if (perr) {
+				*perr = SCPI_ERROR_FILE_NAME_NOT_FOUND;
+            }
+			return false;
+		}
+
+        g_downloadedFileOffset = 0;
+        g_downloadBufferPosition = 0;
+        g_downloadStartTime = millis();
+	}
+
+    const uint8_t *src = (const uint8_t *)buffer;
+    while (size > 0) {
+        size_t n = MIN(size, DOWNLOAD_BUFFER_SIZE - g_downloadBufferPosition);
+        memcpy(DOWNLOAD_BUFFER + g_downloadBufferPosition, src, n);
+        g_downloadBufferPosition += n;
+        src += n;
+        size -= n;
+
+        if (g_downloadBufferPosition == DOWNLOAD_BUFFER_SIZE) {
+            if (!flushDownloadBuffer(perr)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool downloadFinished(bool succeeded, int *err) {
+    bool result = succeeded;
+
+    if (result && g_downloadBufferPosition > 0) {
+        result = flushDownloadBuffer(err);
+    }
+
     g_downloadFile.close();
-    onSdCardFileChangeHook(g_downloadFilePath);
+
+    bool completed = false;
+
+    if (result) {
+        // replace destination file with the downloaded one,
+        // if this fails or is interrupted, recoverDownload completes it on the next mount
+        completed = writeDownloadJournal(true);
+        if (
+            !completed ||
+            (SD.exists(g_downloadFilePath) && !SD.remove(g_downloadFilePath)) ||
+            !SD.rename(g_downloadTempFilePath, g_downloadFilePath)
+        ) {
+            if (err) {
+                *err = SCPI_ERROR_MASS_STORAGE_ERROR;
+            }
+            result = false;
+        }
+    }
+
+    if (result) {
+        g_lastDownloadRate = getTransferRate(g_downloadedFileOffset, g_downloadStartTime);
+        onSdCardFileChangeHook(g_downloadFilePath);
+    } else if (!completed) {
+        SD.remove(g_downloadTempFilePath);
+    }
+
+    if (result || !completed) {
+        SD.remove(DOWNLOAD_JOURNAL_FILE_PATH);
+    }
+
+    return result;
+}
+
+void getTransferRates(uint32_t &uploadRate, uint32_t &downloadRate) {
+    uploadRate = g_lastUploadRate;
+    downloadRate = g_lastDownloadRate;
+}
+
+// pyramid sidecar file (see dlog_view.h) is deleted and moved together with its DLOG file
+static bool getSidecarFilePath(const char *filePath, char *sidecarFilePath) {
+    return getFileTypeFromExtension(filePath) == FILE_TYPE_DLOG && dlog_view::getPyramidFilePath(filePath, sidecarFilePath);
 }
 
 bool moveFile(const char *sourcePath, const char *destinationPath, int *err) {
@@ -415,6 +698,20 @@ bool moveFile(const char *sourcePath, const char *destinationPath, int *err) {
         return false;
     }
 
+    char sourceSidecarPath[MAX_PATH_LENGTH + 1];
+    char destinationSidecarPath[MAX_PATH_LENGTH + 1];
+    bool hasDestinationSidecar = getSidecarFilePath(destinationPath, destinationSidecarPath);
+    if (hasDestinationSidecar && SD.exists(destinationSidecarPath)) {
+        SD.remove(destinationSidecarPath);
+    }
+    if (getSidecarFilePath(sourcePath, sourceSidecarPath) && SD.exists(sourceSidecarPath)) {
+        if (hasDestinationSidecar) {
+            SD.rename(sourceSidecarPath, destinationSidecarPath);
+        } else {
+            SD.remove(sourceSidecarPath);
+        }
+    }
+
     onSdCardFileChangeHook(sourcePath, destinationPath);
 
     return true;
@@ -514,6 +811,11 @@ bool deleteFile(const char *filePath, int *err) {
         return false;
     }
 
+    char sidecarFilePath[MAX_PATH_LENGTH + 1];
+    if (getSidecarFilePath(filePath, sidecarFilePath) && SD.exists(sidecarFilePath)) {
+        SD.remove(sidecarFilePath);
+    }
+
     onSdCardFileChangeHook(filePath);
 
     return true;
@@ -630,48 +932,49 @@ bool getInfo(uint64_t &usedSpace, uint64_t &freeSpace, bool fromCache) {
 
 BufferedFileRead::BufferedFileRead(File &file_, size_t bufferSize_)
     : file(file_)
-    , bufferSize(bufferSize_)
-    , position(bufferSize_)
-    , end(bufferSize_)
+    , bufferSize(MIN(bufferSize_, BUFFER_SIZE))
+    , readSize(MIN(MIN_READ_SIZE, bufferSize))
+    , position(0)
+    , end(0)
+    , eof(false)
 {
 }
 
 void BufferedFileRead::readNextChunk() {
-    if (position == end && end == bufferSize) {
+    if (position == end && !eof) {
         position = 0;
-        end = file.read(buffer, bufferSize);
-    }
-}
+        end = file.read(buffer, readSize);
+        eof = end < readSize;
 
-int BufferedFileRead::peek() {
-    readNextChunk();
-    return position < end ? buffer[position] : -1;
+        // Reads are getting bigger while the file is consumed, so reading
+        // only the beginning of the file (e.g. description) is still cheap.
+        if (readSize < bufferSize) {
+            readSize = MIN(2 * readSize, bufferSize);
+        }
+    }
 }
 
-int BufferedFileRead::read() {
+const uint8_t *BufferedFileRead::getSpan(size_t &length) {
     readNextChunk();
-    int ch = peek();
-    if (ch != -1) {
-        position++;
-    }
-    return ch;
+    length = end - position;
+    return buffer + position;
 }
 
 int BufferedFileRead::read(void *buf, uint32_t nbyte) {
-    uint8_t *pBegin = (uint8_t *)buf;
-    uint8_t *pEnd = pBegin + nbyte;
-    uint8_t *p;
-    for (p = pBegin; p < pEnd; p++) {
-        if (!available()) {
+    uint8_t *p = (uint8_t *)buf;
+    uint32_t numRead = 0;
+    while (numRead < nbyte) {
+        size_t length;
+        const uint8_t *span = getSpan(length);
+        if (length == 0) {
             break;
         }
-        *p = (uint8_t)read();
+        length = MIN(length, nbyte - numRead);
+        memcpy(p + numRead, span, length);
+        consume(length);
+        numRead += length;
     }
-    return p - pBegin;
-}
-
-bool BufferedFileRead::available() {
-    return peek() != -1;
+    return numRead;
 }
 
 size_t BufferedFileRead::size() {
@@ -679,7 +982,7 @@ size_t BufferedFileRead::size() {
 }
 
 size_t BufferedFileRead::tell() {
-    return file.tell();
+    return file.tell() - (end - position);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -744,13 +1047,27 @@ bool isSpace(int c) {
 }
 #endif
 
+// Tokenizer works directly on the spans of the read buffer,
+// instead of calling peek and read for every character.
+
 void matchZeroOrMoreSpaces(BufferedFileRead &file) {
     while (true) {
-        int c = file.peek();
-        if (!isSpace(c)) {
+        size_t length;
+        const uint8_t *span = file.getSpan(length);
+        if (length == 0) {
+            return;
+        }
+
+        size_t i = 0;
+        while (i < length && isSpace(span[i])) {
+            i++;
+        }
+
+        file.consume(i);
+
+        if (i < length) {
             return;
         }
-        file.read();
     }
 }
 
@@ -780,24 +1097,26 @@ bool matchUntil(BufferedFileRead &file, char ch, char *result, int count) {
     char *end = count == -1 ? (char *)0xFFFFFFFF : result + count;
 
     while (true) {
-        int next = file.peek();
-        if (next == -1) {
+        size_t length;
+        const uint8_t *span = file.getSpan(length);
+        if (length == 0) {
             return false;
         }
 
-        file.read();
+        for (size_t i = 0; i < length; i++) {
+            if (span[i] == ch) {
+                file.consume(i + 1);
+                *result = 0;
+                return true;
+            }
 
-        if (next == ch) {
-            *result = 0;
-            return true;
+            if (result < end) {
+                *result++ = (char)span[i];
+            }
         }
 
-        if (result < end) {
-            *result++ = (char)next;
-        }
+        file.consume(length);
     }
-
-    return true;
 }
 
 void skipUntil(BufferedFileRead &file, const char *str) {
@@ -825,11 +1144,20 @@ void skipUntil(BufferedFileRead &file, const char *str) {
 
 void skipUntilEOL(BufferedFileRead &file) {
     while (true) {
-        int next = file.peek();
-        if (next == -1 || next == '\r' || next == '\n') {
+        size_t length;
+        const uint8_t *span = file.getSpan(length);
+        if (length == 0) {
             return;
         }
-        file.read();
+
+        for (size_t i = 0; i < length; i++) {
+            if (span[i] == '\r' || span[i] == '\n') {
+                file.consume(i);
+                return;
+            }
+        }
+
+        file.consume(length);
     }
 }
 
@@ -899,64 +1227,220 @@ bool match(BufferedFileRead &file, unsigned int &result) {
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
 
-bool match(BufferedFileRead &file, float &result) {
-    matchZeroOrMoreSpaces(file);
+enum NumberTokenState {
+    NUMBER_TOKEN_START,
+    NUMBER_TOKEN_SIGN,
+    NUMBER_TOKEN_INTEGER,
+    NUMBER_TOKEN_POINT, // decimal point without integer digits
+    NUMBER_TOKEN_FRACTION,
+    NUMBER_TOKEN_EXPONENT,
+    NUMBER_TOKEN_EXPONENT_SIGN,
+    NUMBER_TOKEN_EXPONENT_DIGITS,
+    NUMBER_TOKEN_END
+};
 
-    int c = file.peek();
-    if (c == -1) {
-        return false;
-    }
+static NumberTokenState nextNumberTokenState(NumberTokenState state, uint8_t ch) {
+    bool isDigit = ch >= '0' && ch <= '9';
 
-    bool isNegative;
-    if (c == '-') {
-        file.read();
-        isNegative = true;
-        c = file.peek();
-    } else {
-        isNegative = false;
+    switch (state) {
+    case NUMBER_TOKEN_START:
+        if (ch == '+' || ch == '-') {
+            return NUMBER_TOKEN_SIGN;
+        }
+        // fall through
+    case NUMBER_TOKEN_SIGN:
+        if (isDigit) {
+            return NUMBER_TOKEN_INTEGER;
+        }
+        return ch == '.' ? NUMBER_TOKEN_POINT : NUMBER_TOKEN_END;
+
+    case NUMBER_TOKEN_INTEGER:
+        if (isDigit) {
+            return NUMBER_TOKEN_INTEGER;
+        }
+        if (ch == '.') {
+            return NUMBER_TOKEN_FRACTION;
+        }
+        return ch == 'e' || ch == 'E' ? NUMBER_TOKEN_EXPONENT : NUMBER_TOKEN_END;
+
+    case NUMBER_TOKEN_POINT:
+        return isDigit ? NUMBER_TOKEN_FRACTION : NUMBER_TOKEN_END;
+
+    case NUMBER_TOKEN_FRACTION:
+        if (isDigit) {
+            return NUMBER_TOKEN_FRACTION;
+        }
+        return ch == 'e' || ch == 'E' ? NUMBER_TOKEN_EXPONENT : NUMBER_TOKEN_END;
+
+    case NUMBER_TOKEN_EXPONENT:
+        if (ch == '+' || ch == '-') {
+            return NUMBER_TOKEN_EXPONENT_SIGN;
+        }
+        // fall through
+    case NUMBER_TOKEN_EXPONENT_SIGN:
+    case NUMBER_TOKEN_EXPONENT_DIGITS:
+        return isDigit ? NUMBER_TOKEN_EXPONENT_DIGITS : NUMBER_TOKEN_END;
+
+    default:
+        return NUMBER_TOKEN_END;
     }
+}
 
-    bool isFraction = false;
-    float fraction = 1.0;
+// Matches [+-]digits[.digits][(e|E)[+-]digits] and copies it to the token.
+static bool matchNumberToken(BufferedFileRead &file, char *token, size_t tokenSize) {
+    matchZeroOrMoreSpaces(file);
 
-    long value = -1;
+    NumberTokenState state = NUMBER_TOKEN_START;
+    size_t tokenLength = 0;
 
     while (true) {
-        if (c == '.') {
-            if (isFraction) {
-                return false;
+        size_t length;
+        const uint8_t *span = file.getSpan(length);
+        if (length == 0) {
+            break;
+        }
+
+        size_t i;
+        for (i = 0; i < length; i++) {
+            NumberTokenState nextState = nextNumberTokenState(state, span[i]);
+            if (nextState == NUMBER_TOKEN_END) {
+                break;
             }
-            isFraction = true;
-        } else if (c >= '0' && c <= '9') {
-            if (value == -1) {
-                value = 0;
+
+            if (tokenLength == tokenSize - 1) {
+                return false;
             }
+            token[tokenLength++] = span[i];
 
-            value = value * 10 + c - '0';
+            state = nextState;
+        }
+
+        file.consume(i);
+
+        if (i < length) {
+            break;
+        }
+    }
 
-            if (isFraction) {
-                fraction *= 0.1f;
+    token[tokenLength] = 0;
+
+    return state == NUMBER_TOKEN_INTEGER || state == NUMBER_TOKEN_FRACTION || state == NUMBER_TOKEN_EXPONENT_DIGITS;
+}
+
+// Parses the token matched by matchNumberToken, result is correctly rounded.
+//
+// Significant digits are collected in the integer and the value is calculated
+// with a single (exact operand) multiplication or division, which is correctly
+// rounded, in float if possible, otherwise in double. Double result is then
+// correctly rounded to float, unless it is exactly half way between two floats.
+// Everything else (very long mantissa, big exponent) is left to strtof.
+bool parseFloat(const char *token, float &result) {
+    static const float FLOAT_POWERS_OF_10[] = {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+    };
+
+    static const double DOUBLE_POWERS_OF_10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char *p = token;
+
+    bool isNegative = false;
+    if (*p == '+' || *p == '-') {
+        isNegative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int numDigits = 0;
+    int exponent = 0;
+    bool isTruncated = false;
+
+    for (; *p >= '0' && *p <= '9'; p++) {
+        if (numDigits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa > 0) {
+                numDigits++;
             }
         } else {
-            if (value == -1) {
-                return false;
-            }
+            exponent++;
+            isTruncated = isTruncated || *p != '0';
+        }
+    }
 
-            result = (float)value;
-            if (isNegative) {
-                result = -result;
+    if (*p == '.') {
+        for (p++; *p >= '0' && *p <= '9'; p++) {
+            if (numDigits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa > 0) {
+                    numDigits++;
+                }
+                exponent--;
+            } else {
+                isTruncated = isTruncated || *p != '0';
             }
-            if (isFraction) {
-                result *= fraction;
+        }
+    }
+
+    if (*p == 'e' || *p == 'E') {
+        p++;
+
+        bool isExponentNegative = false;
+        if (*p == '+' || *p == '-') {
+            isExponentNegative = *p == '-';
+            p++;
+        }
+
+        int value = 0;
+        for (; *p >= '0' && *p <= '9'; p++) {
+            if (value < 10000) {
+                value = value * 10 + (*p - '0');
             }
+        }
+
+        exponent += isExponentNegative ? -value : value;
+    }
 
+    if (mantissa == 0 && !isTruncated) {
+        result = isNegative ? -0.0f : 0.0f;
+        return true;
+    }
+
+    if (!isTruncated) {
+        if (mantissa <= (1UL << 24) && exponent >= -10 && exponent <= 10) {
+            float value = (float)mantissa;
+            value = exponent < 0 ? value / FLOAT_POWERS_OF_10[-exponent] : value * FLOAT_POWERS_OF_10[exponent];
+            result = isNegative ? -value : value;
             return true;
         }
 
-        file.read();
-        c = file.peek();
+        if (mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+            double value = (double)mantissa;
+            value = exponent < 0 ? value / DOUBLE_POWERS_OF_10[-exponent] : value * DOUBLE_POWERS_OF_10[exponent];
+
+            // rounding to float is correct if double is not exactly half way between two floats
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            if ((bits & 0x1FFFFFFF) != 0x10000000) {
+                result = isNegative ? -(float)value : (float)value;
+                return true;
+            }
+        }
     }
+
+    result = strtof(token, nullptr);
+    return true;
+}
+
+bool match(BufferedFileRead &file, float &result) {
+    char token[64];
+    if (!matchNumberToken(file, token, sizeof(token))) {
+        return false;
+    }
+    return parseFloat(token, result);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1053,6 +1537,9 @@ static bool mount() {
     auto savedState = g_state;
     g_state = STATE_MOUNTED;
     bool result = prepareCard();
+    if (result) {
+        recoverDownload();
+    }
     g_state = savedState;
     
     if (!result) {
@@ -56,7 +56,8 @@ bool catalog(const char *dirPath, void *param, void (*callback)(void *param, con
 bool catalogLength(const char *dirPath, size_t *length, int *err);
 bool upload(const char *filePath, void *param, void (*callback)(void *param, const void *buffer, int size), int *err);
 bool download(const char *filePath, bool truncate, const void *buffer, size_t size, int *err);
-void downloadFinished();
+bool downloadFinished(bool succeeded, int *err);
+void getTransferRates(uint32_t &uploadRate, uint32_t &downloadRate); // bytes per second, last transfer
 bool moveFile(const char *sourcePath, const char *destinationPath, int *err);
 bool copyFile(const char *sourcePath, const char *destinationPath, bool showProgress, int *err);
 bool deleteFile(const char *filePath, int *err);
@@ -74,21 +75,47 @@ class BufferedFileRead {
 public:
     BufferedFileRead(File &file, size_t bufferSize = BUFFER_SIZE);
 
-    int peek();
-    int read();
+    int peek() {
+        if (position == end) {
+            readNextChunk();
+        }
+        return position < end ? buffer[position] : -1;
+    }
+
+    int read() {
+        int ch = peek();
+        if (ch != -1) {
+            position++;
+        }
+        return ch;
+    }
+
     int read(void *buf, uint32_t nbyte);
-    bool available();
+
+    bool available() {
+        return peek() != -1;
+    }
+
+    // Returns not yet consumed part of the buffer (buffer is filled if empty),
+    // length is 0 at the end of the file.
+    const uint8_t *getSpan(size_t &length);
+    void consume(size_t length) {
+        position += length;
+    }
 
     size_t size();
     size_t tell();
 
 private:
     File &file;
-    static const size_t BUFFER_SIZE = 512;
+    static const size_t BUFFER_SIZE = 2048;
+    static const size_t MIN_READ_SIZE = 512;
     uint8_t buffer[BUFFER_SIZE];
     uint32_t bufferSize;
+    uint32_t readSize;
     size_t position;
     size_t end;
+    bool eof;
 
     void readNextChunk();
 };
@@ -121,6 +148,8 @@ bool matchQuotedString(BufferedFileRead &file, char *str, unsigned int strLength
 bool match(BufferedFileRead &file, unsigned int &result);
 bool match(BufferedFileRead &file, float &result);
 
+bool parseFloat(const char *token, float &result);
+
 } // namespace sd_card
 } // namespace psu
 } // namespace eez
@@ -97,7 +97,11 @@ void UARTClass::releaseInputBuffer() {
 
 int UARTClass::write(const char *buffer, int size) {
 #if defined(EEZ_PLATFORM_STM32)    
-    CDC_Transmit_FS((uint8_t *)buffer, (uint16_t)size);
+    // must not be greater than APP_TX_DATA_SIZE from usbd_cdc_if.c
+    static const int MAX_TRANSMIT_SIZE = 4096;
+    for (int i = 0; i < size; i += MAX_TRANSMIT_SIZE) {
+        CDC_Transmit_FS((uint8_t *)buffer + i, (uint16_t)MIN(size - i, MAX_TRANSMIT_SIZE));
+    }
     return size;
 #endif
 
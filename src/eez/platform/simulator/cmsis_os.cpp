@@ -3,6 +3,8 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include <chrono>
+
 #ifdef EEZ_PLATFORM_SIMULATOR_WIN32
 #include <windows.h>
 #else
@@ -114,48 +116,47 @@ uint32_t osKernelSysTick() {
 #endif    
 }
 
+// Waits on condition variable until predicate is satisfied or timeout expires.
+// There is no other thread under Emscripten, so it never waits there.
+template <typename Predicate>
+static bool waitFor(std::condition_variable &condition, std::unique_lock<std::mutex> &lock, uint32_t millisec, Predicate predicate) {
+#ifdef __EMSCRIPTEN__
+    return predicate();
+#else
+    if (millisec == osWaitForever) {
+        condition.wait(lock, predicate);
+        return true;
+    }
+    return condition.wait_for(lock, std::chrono::milliseconds(millisec), predicate);
+#endif
+}
+
 osMessageQId osMessageCreate(osMessageQId queue_id, osThreadId thread_id) {
+    std::lock_guard<std::mutex> lock(queue_id->mutex);
     queue_id->tail = 0;
-    queue_id->head = 0;
-    queue_id->overflow = 0;
+    queue_id->count = 0;
     return queue_id;
 }
 
 osEvent osMessageGet(osMessageQId queue_id, uint32_t millisec) {
-    if (millisec == 0) millisec = 1;
+    std::unique_lock<std::mutex> lock(queue_id->mutex);
 
-    while (queue_id->tail == queue_id->head) {
-        if (queue_id->overflow) {
-            queue_id->overflow = 0;
-        }
-
-#ifdef __EMSCRIPTEN__
+    if (!waitFor(queue_id->notEmpty, lock, millisec, [queue_id] { return queue_id->count > 0; })) {
         return {
-            osOK,
+            millisec == 0 ? osOK : osEventTimeout,
             0
         };
-#else
-        
-        osDelay(1);
-        millisec -= 1;
-
-        if (millisec == 0) {
-            return {
-                osOK,
-                0
-            };
-        }
-#endif
-    }
-    uint16_t tail = queue_id->tail + 1;
-    if (tail >= queue_id->numElements) {
-        tail = 0;
     }
-    queue_id->tail = tail;
-    uint32_t info = ((uint32_t *)queue_id->data)[tail];
-    if (queue_id->overflow) {
-        queue_id->overflow = 0;
+
+    uint32_t info = ((uint32_t *)queue_id->data)[queue_id->tail];
+    if (++queue_id->tail == queue_id->numElements) {
+        queue_id->tail = 0;
     }
+    queue_id->count--;
+
+    lock.unlock();
+    queue_id->notFull.notify_one();
+
     return {
         osEventMessage,
         info
@@ -163,23 +164,28 @@ osEvent osMessageGet(osMessageQId queue_id, uint32_t millisec) {
 }
 
 osStatus osMessagePut(osMessageQId queue_id, uint32_t info, uint32_t millisec) {
-    while (queue_id->overflow) {
-        osDelay(0);
+    std::unique_lock<std::mutex> lock(queue_id->mutex);
+
+    if (!waitFor(queue_id->notFull, lock, millisec, [queue_id] { return queue_id->count < queue_id->numElements; })) {
+        return millisec == 0 ? osErrorResource : osErrorTimeoutResource;
     }
-    uint16_t head = queue_id->head + 1;
+
+    uint32_t head = queue_id->tail + queue_id->count;
     if (head >= queue_id->numElements) {
-        head = 0;
+        head -= queue_id->numElements;
     }
     ((uint32_t *)queue_id->data)[head] = info;
-    queue_id->head = head;
-    if (queue_id->head == queue_id->tail) {
-        queue_id->overflow = 1;
-    }
+    queue_id->count++;
+
+    lock.unlock();
+    queue_id->notEmpty.notify_one();
+
     return osOK;
 }
 
 uint32_t osMessageWaiting(osMessageQId queue_id) {
-    return queue_id->head - queue_id->tail;
+    std::lock_guard<std::mutex> lock(queue_id->mutex);
+    return queue_id->count;
 }
 
 Mutex *osMutexCreate(Mutex &mutex) {
@@ -187,13 +193,20 @@ Mutex *osMutexCreate(Mutex &mutex) {
 }
 
 osStatus osMutexWait(Mutex *mutex, unsigned int timeout) {
-    while (mutex->locked) {
-    	osDelay(1);
+#ifndef __EMSCRIPTEN__
+    if (timeout == osWaitForever) {
+        mutex->mutex.lock();
+        return osOK;
     }
-    mutex->locked = true;
-    return osOK;
+
+    if (timeout > 0) {
+        return mutex->mutex.try_lock_for(std::chrono::milliseconds(timeout)) ? osOK : osErrorTimeoutResource;
+    }
+#endif
+
+    return mutex->mutex.try_lock() ? osOK : osErrorResource;
 }
 
 void osMutexRelease(Mutex *mutex) {
-    mutex->locked = false;
+    mutex->mutex.unlock();
 }
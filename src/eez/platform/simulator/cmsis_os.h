@@ -2,9 +2,15 @@
 
 #include <stdint.h>
 
+#include <mutex>
+#include <condition_variable>
+
 typedef enum {
     osOK = 0,
-    osEventMessage = 0x10
+    osEventMessage = 0x10,
+    osEventTimeout = 0x40,
+    osErrorResource = 0x81,
+    osErrorTimeoutResource = 0xC1
 } osStatus;
 
 typedef enum {
@@ -89,9 +95,11 @@ struct osEvent {
 struct MessageQueue {
     void *data;
     uint8_t numElements;
-    volatile uint16_t tail;
-    volatile uint16_t head;
-    volatile uint8_t overflow;
+    uint16_t tail;
+    uint16_t count;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
 };
 
 typedef MessageQueue *osMessageQId;
@@ -112,7 +120,7 @@ uint32_t osMessageWaiting(osMessageQId queue_id);
 // Mutex
 
 struct Mutex {
-    bool locked;
+    std::timed_mutex mutex;
 };
 
 #define osMutexDef(mutex) Mutex mutex
@@ -138,6 +138,9 @@
     SCPI_COMMAND("SENSe:DLOG:FUNCtion:POWer?", scpi_cmd_senseDlogFunctionPowerQ) \
     SCPI_COMMAND("SENSe:DLOG:FUNCtion:VOLTage", scpi_cmd_senseDlogFunctionVoltage) \
     SCPI_COMMAND("SENSe:DLOG:FUNCtion:VOLTage?", scpi_cmd_senseDlogFunctionVoltageQ) \
+    SCPI_COMMAND("SENSe:DLOG:COMPression", scpi_cmd_senseDlogCompression) \
+    SCPI_COMMAND("SENSe:DLOG:COMPression?", scpi_cmd_senseDlogCompressionQ) \
+    SCPI_COMMAND("SENSe:DLOG:DATA?", scpi_cmd_senseDlogDataQ) \
     SCPI_COMMAND("SENSe:DLOG:PERiod", scpi_cmd_senseDlogPeriod) \
     SCPI_COMMAND("SENSe:DLOG:PERiod?", scpi_cmd_senseDlogPeriodQ) \
     SCPI_COMMAND("SENSe:DLOG:TIME", scpi_cmd_senseDlogTime) \
@@ -415,6 +418,19 @@
     SCPI_COMMAND("DEBUg:DCM220?", scpi_cmd_debugDcm220Q) \
     SCPI_COMMAND("DEBUg:DOWNload:FIRMware", scpi_cmd_debugDownloadFirmware) \
     SCPI_COMMAND("DEBUg:EVENt", scpi_cmd_debugEvent) \
+    SCPI_COMMAND("DEBUg:EVENt?", scpi_cmd_debugEventQ) \
+    SCPI_COMMAND("DEBUg:DLOG?", scpi_cmd_debugDlogQ) \
+    SCPI_COMMAND("DEBUg:SCPI:LOOKup?", scpi_cmd_debugScpiLookupQ) \
+    SCPI_COMMAND("DEBUg:SCPI:BENChmark?", scpi_cmd_debugScpiBenchmarkQ) \
+    SCPI_COMMAND("DEBUg:GUI:DIRTy?", scpi_cmd_debugGuiDirtyQ) \
+    SCPI_COMMAND("DEBUg:GUI:TEXT?", scpi_cmd_debugGuiTextQ) \
+    SCPI_COMMAND("DEBUg:GUI:BLIT?", scpi_cmd_debugGuiBlitQ) \
+    SCPI_COMMAND("DEBUg:GUI:UPDate?", scpi_cmd_debugGuiUpdateQ) \
+    SCPI_COMMAND("DEBUg:GUI:UPDate:SKIP", scpi_cmd_debugGuiUpdateSkip) \
+    SCPI_COMMAND("DEBUg:GUI:TIMing?", scpi_cmd_debugGuiTimingQ) \
+    SCPI_COMMAND("DEBUg:GUI:TIMing:OVERlay", scpi_cmd_debugGuiTimingOverlay) \
+    SCPI_COMMAND("DEBUg:GUI:COLors?", scpi_cmd_debugGuiColorsQ) \
+    SCPI_COMMAND("DEBUg:PARSe?", scpi_cmd_debugParseQ) \
     SCPI_COMMAND("SYSTem:DATE:CLEar", scpi_cmd_systemDateClear) \
     SCPI_COMMAND("SYSTem:TIME:CLEar", scpi_cmd_systemTimeClear) \
     SCPI_COMMAND("ROUTe:OPEN", scpi_cmd_routeOpen) \
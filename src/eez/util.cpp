@@ -24,6 +24,7 @@
 #include <string.h>
 
 #if defined(EEZ_PLATFORM_STM32)
+#include <cmsis_os.h>
 #include <crc.h>
 #endif
 
@@ -154,35 +155,85 @@ void strcatLoad(char *str, float value) {
     }
 }
 
+// both STM32 CRC peripheral and the software implementation start from all ones
+static const uint32_t CRC32_INITIAL_VALUE = 0xFFFFFFFF;
+
 #if defined(EEZ_PLATFORM_STM32)
+// CRC peripheral is shared by all threads (it is also used for BP3C SPI
+// transfers), so it is used inside critical section, in chunks not to keep
+// interrupts disabled for too long.
+static const size_t CRC32_MAX_CHUNK_SIZE = 1024;
+
 uint32_t crc32(const uint8_t *mem_block, size_t block_size) {
-	return HAL_CRC_Calculate(&hcrc, (uint32_t *)mem_block, block_size);
+    // peripheral continues from the INIT register, so CRC of the previous chunk is loaded there
+    uint32_t crc = CRC32_INITIAL_VALUE;
+
+    while (block_size > 0) {
+        size_t chunk_size = block_size < CRC32_MAX_CHUNK_SIZE ? block_size : CRC32_MAX_CHUNK_SIZE;
+
+        taskENTER_CRITICAL();
+        WRITE_REG(hcrc.Instance->INIT, crc);
+        crc = HAL_CRC_Calculate(&hcrc, (uint32_t *)mem_block, chunk_size);
+        WRITE_REG(hcrc.Instance->INIT, CRC32_INITIAL_VALUE);
+        taskEXIT_CRITICAL();
+
+        mem_block += chunk_size;
+        block_size -= chunk_size;
+    }
+
+    return crc;
 }
 #else
 /*
-From http://www.hackersdelight.org/hdcodetxt/crc.c.txt:
-
-This is the basic CRC-32 calculation with some optimization but no
-table lookup. The the byte reversal is avoided by shifting the crc reg
-right instead of left and by using a reversed 32-bit word to represent
-the polynomial.
-When compiled to Cyclops with GCC, this function executes in 8 + 72n
-instructions, where n is the number of bytes in the input message. It
-should be doable in 4 + 61n instructions.
-If the inner loop is strung out (approx. 5*8 = 40 instructions),
-it would take about 6 + 46n instructions.
+Slice-by-8 CRC-32 (reflected polynomial 0xEDB88320), processes 8 bytes
+per iteration with 8 lookup tables, see
+http://create.stephan-brumme.com/crc32/#slicing-by-8-overview
 */
 
-uint32_t crc32(const uint8_t *mem_block, size_t block_size) {
-    uint32_t crc = 0xFFFFFFFF;
-    for (size_t i = 0; i < block_size; ++i) {
-        uint32_t byte = mem_block[i]; // Get next byte.
-        crc = crc ^ byte;
-        for (int j = 0; j < 8; ++j) { // Do eight times.
-            uint32_t mask = -((int32_t)crc & 1);
-            crc = (crc >> 1) ^ (0xEDB88320 & mask);
+struct Crc32Tables {
+    uint32_t table[8][256];
+
+    Crc32Tables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; j++) {
+                crc = (crc >> 1) ^ (0xEDB88320 & -(int32_t)(crc & 1));
+            }
+            table[0][i] = crc;
+        }
+
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+            }
         }
     }
+};
+
+static Crc32Tables g_crc32Tables;
+
+uint32_t crc32(const uint8_t *mem_block, size_t block_size) {
+    const uint32_t (*table)[256] = g_crc32Tables.table;
+
+    uint32_t crc = CRC32_INITIAL_VALUE;
+
+    while (block_size >= 8) {
+        uint32_t one = (mem_block[0] | (mem_block[1] << 8) | (mem_block[2] << 16) | ((uint32_t)mem_block[3] << 24)) ^ crc;
+        uint32_t two = mem_block[4] | (mem_block[5] << 8) | (mem_block[6] << 16) | ((uint32_t)mem_block[7] << 24);
+
+        crc = table[7][one & 0xFF] ^ table[6][(one >> 8) & 0xFF] ^
+              table[5][(one >> 16) & 0xFF] ^ table[4][one >> 24] ^
+              table[3][two & 0xFF] ^ table[2][(two >> 8) & 0xFF] ^
+              table[1][(two >> 16) & 0xFF] ^ table[0][two >> 24];
+
+        mem_block += 8;
+        block_size -= 8;
+    }
+
+    while (block_size-- > 0) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *mem_block++) & 0xFF];
+    }
+
     return ~crc;
 }
 #endif
@@ -36,6 +36,7 @@
     VALUE_TYPE(POINTER) \
     VALUE_TYPE(TIME_SECONDS) \
     VALUE_TYPE(YT_DATA_GET_VALUE_FUNCTION_POINTER) \
+    VALUE_TYPE(YT_DATA_GET_VALUES_FUNCTION_POINTER) \
     VALUE_TYPE(LESS_THEN_MIN_FLOAT) \
     VALUE_TYPE(GREATER_THEN_MAX_FLOAT) \
     VALUE_TYPE(CHANNEL_LABEL) \
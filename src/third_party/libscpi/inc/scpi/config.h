@@ -114,6 +114,11 @@ extern "C" {
 #define USE_DEPRECATED_FUNCTIONS 1
 #endif
 
+/* Number of buckets in command index, see SCPI_CommandIndexInit */
+#ifndef SCPI_CMD_INDEX_NUM_BUCKETS
+#define SCPI_CMD_INDEX_NUM_BUCKETS 128
+#endif
+
 #ifndef USE_CUSTOM_DTOSTRE
 #define USE_CUSTOM_DTOSTRE 0
 #endif
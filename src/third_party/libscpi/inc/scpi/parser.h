@@ -55,6 +55,9 @@ extern "C" {
     void SCPI_InitHeap(scpi_t * context, char * error_info_heap, size_t error_info_heap_length);
 #endif
 
+    scpi_bool_t SCPI_CommandIndexInit(scpi_command_index_t * index, const scpi_command_t * commands, uint16_t * entries, size_t entries_size);
+    const scpi_command_t * SCPI_FindCommand(scpi_t * context, const char * header, int len);
+
     scpi_bool_t SCPI_Input(scpi_t * context, const char * data, int len);
     scpi_bool_t SCPI_Parse(scpi_t * context, char * data, int len);
 
@@ -356,6 +356,15 @@ extern "C" {
 #endif /* USE_COMMAND_TAGS */
     };
 
+    /* Commands grouped by the first characters of the first two nodes */
+    struct _scpi_command_index_t {
+        const scpi_command_t * cmdlist;
+        /* command list indexes, bucket by bucket, last bucket holds commands which are not indexed */
+        uint16_t * entries;
+        uint16_t bucket_start[SCPI_CMD_INDEX_NUM_BUCKETS + 2];
+    };
+    typedef struct _scpi_command_index_t scpi_command_index_t;
+
     struct _scpi_interface_t {
         scpi_error_callback_t error;
         scpi_write_t write;
@@ -366,6 +375,7 @@ extern "C" {
 
     struct _scpi_t {
         const scpi_command_t * cmdlist;
+        const scpi_command_index_t * cmdindex;
         scpi_buffer_t buffer;
         scpi_param_list_t param_list;
         scpi_interface_t * interface;
@@ -159,22 +159,337 @@ static scpi_bool_t processCommand(scpi_t * context) {
     return result;
 }
 
+#define CMD_INDEX_KEY_LENGTH 3
+#define CMD_INDEX_MAX_NODES 16
+#define CMD_INDEX_MAX_PATTERN_BUCKETS 16
+
+/* Pattern node, used while building command index */
+typedef struct {
+    const char * ptr;
+    scpi_bool_t optional;
+} cmd_index_node_t;
+
+/**
+ * Calculate command index bucket from the first CMD_INDEX_KEY_LENGTH characters
+ * of the first two nodes
+ * @param key1 - first node
+ * @param key2 - second node, NULL if there is no second node
+ * @return bucket index
+ */
+static int commandIndexBucket(const char * key1, const char * key2) {
+    unsigned hash = 0;
+    int i;
+
+    for (i = 0; i < CMD_INDEX_KEY_LENGTH; i++) {
+        hash = hash * 31 + toupper((unsigned char) key1[i]);
+    }
+
+    for (i = 0; i < CMD_INDEX_KEY_LENGTH; i++) {
+        hash = hash * 31 + (key2 != NULL ? toupper((unsigned char) key2[i]) : 0);
+    }
+
+    return hash % SCPI_CMD_INDEX_NUM_BUCKETS;
+}
+
+/**
+ * Pattern node can be used as a key only if its short form has at least
+ * CMD_INDEX_KEY_LENGTH characters, because then every matching header node
+ * starts with the same CMD_INDEX_KEY_LENGTH characters.
+ * @param node
+ * @return TRUE if node can be used as a key
+ */
+static scpi_bool_t commandIndexPatternKey(const char * node) {
+    int i;
+
+    for (i = 0; i < CMD_INDEX_KEY_LENGTH; i++) {
+        if (!isupper((unsigned char) node[i]) && node[i] != '*') {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Split pattern in nodes
+ * @param pattern
+ * @param nodes
+ * @return number of nodes or -1 if there is too many nodes
+ */
+static int commandIndexPatternNodes(const char * pattern, cmd_index_node_t * nodes) {
+    int n = 0;
+
+    while (*pattern != '\0' && *pattern != '?') {
+        if (n == CMD_INDEX_MAX_NODES) {
+            return -1;
+        }
+
+        nodes[n].optional = FALSE;
+        if (*pattern == '[') {
+            nodes[n].optional = TRUE;
+            pattern++;
+        }
+
+        if (*pattern == ':') {
+            pattern++;
+        }
+
+        nodes[n].ptr = pattern;
+        n++;
+
+        while (*pattern != '\0' && strchr(":[]?", *pattern) == NULL) {
+            pattern++;
+        }
+
+        if (*pattern == ']') {
+            pattern++;
+        }
+    }
+
+    return n;
+}
+
+/**
+ * Find all command index buckets of the pattern, one for each combination of
+ * the first two nodes (optional nodes can be skipped).
+ * @param pattern
+ * @param buckets
+ * @return number of buckets or -1 if pattern can't be indexed
+ */
+static int commandIndexPatternBuckets(const char * pattern, int * buckets) {
+    cmd_index_node_t nodes[CMD_INDEX_MAX_NODES];
+    int n = commandIndexPatternNodes(pattern, nodes);
+    int numBuckets = 0;
+    int i, j, k;
+
+    for (i = 0; i < n; i++) {
+        if (!commandIndexPatternKey(nodes[i].ptr)) {
+            return -1;
+        }
+
+        for (j = i + 1; ; j++) {
+            int bucket;
+
+            if (j < n && !commandIndexPatternKey(nodes[j].ptr)) {
+                return -1;
+            }
+
+            bucket = commandIndexBucket(nodes[i].ptr, j < n ? nodes[j].ptr : NULL);
+
+            for (k = 0; k < numBuckets && buckets[k] != bucket; k++) {
+            }
+            if (k == numBuckets) {
+                if (numBuckets == CMD_INDEX_MAX_PATTERN_BUCKETS) {
+                    return -1;
+                }
+                buckets[numBuckets++] = bucket;
+            }
+
+            if (j == n || !nodes[j].optional) {
+                break;
+            }
+        }
+
+        if (!nodes[i].optional) {
+            break;
+        }
+    }
+
+    return n > 0 ? numBuckets : -1;
+}
+
+/**
+ * Header node can be used as a key if it starts with CMD_INDEX_KEY_LENGTH letters
+ * @param header
+ * @param end
+ * @return TRUE if node can be used as a key
+ */
+static scpi_bool_t commandIndexHeaderKey(const char * header, const char * end) {
+    int i;
+
+    if (end - header < CMD_INDEX_KEY_LENGTH) {
+        return FALSE;
+    }
+
+    for (i = 0; i < CMD_INDEX_KEY_LENGTH; i++) {
+        if (!isalpha((unsigned char) header[i]) && header[i] != '*') {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Find command index bucket of the header
+ * @param header
+ * @param len
+ * @return bucket index or SCPI_CMD_INDEX_NUM_BUCKETS if header can match only not indexed patterns
+ */
+static int commandIndexHeaderBucket(const char * header, int len) {
+    const char * end = header + len;
+    const char * key1;
+    const char * key2 = NULL;
+
+    if (header < end && *header == ':') {
+        header++;
+    }
+
+    if (!commandIndexHeaderKey(header, end)) {
+        return SCPI_CMD_INDEX_NUM_BUCKETS;
+    }
+    key1 = header;
+
+    while (header < end && *header != ':' && *header != '?') {
+        header++;
+    }
+
+    if (header < end && *header == ':') {
+        header++;
+        if (!commandIndexHeaderKey(header, end)) {
+            return SCPI_CMD_INDEX_NUM_BUCKETS;
+        }
+        key2 = header;
+    }
+
+    return commandIndexBucket(key1, key2);
+}
+
+/**
+ * Initialize command index, it can be shared by all contexts with the same command list.
+ * Commands are grouped by the first two nodes, so the index is effectively the first two
+ * levels of the command tree. Command with optional nodes at the beginning is in more buckets.
+ * @param index
+ * @param commands
+ * @param entries
+ * @param entries_size - number of entries, two per command is usually enough
+ * @return FALSE if there is not enough entries
+ */
+scpi_bool_t SCPI_CommandIndexInit(scpi_command_index_t * index, const scpi_command_t * commands, uint16_t * entries, size_t entries_size) {
+    int32_t i;
+    int buckets[CMD_INDEX_MAX_PATTERN_BUCKETS];
+    int numBuckets;
+    int bucket;
+
+    index->cmdlist = NULL;
+    index->entries = entries;
+
+    memset(index->bucket_start, 0, sizeof(index->bucket_start));
+
+    /* count commands per bucket */
+    for (i = 0; commands[i].pattern != NULL; i++) {
+        numBuckets = commandIndexPatternBuckets(commands[i].pattern, buckets);
+        if (numBuckets < 0) {
+            buckets[0] = SCPI_CMD_INDEX_NUM_BUCKETS;
+            numBuckets = 1;
+        }
+        for (bucket = 0; bucket < numBuckets; bucket++) {
+            index->bucket_start[buckets[bucket] + 1]++;
+        }
+    }
+
+    for (bucket = 0; bucket <= SCPI_CMD_INDEX_NUM_BUCKETS; bucket++) {
+        index->bucket_start[bucket + 1] += index->bucket_start[bucket];
+    }
+
+    if (index->bucket_start[SCPI_CMD_INDEX_NUM_BUCKETS + 1] > entries_size) {
+        return FALSE;
+    }
+
+    /* fill buckets, command list order is preserved inside bucket */
+    for (i = 0; commands[i].pattern != NULL; i++) {
+        numBuckets = commandIndexPatternBuckets(commands[i].pattern, buckets);
+        if (numBuckets < 0) {
+            buckets[0] = SCPI_CMD_INDEX_NUM_BUCKETS;
+            numBuckets = 1;
+        }
+        for (bucket = 0; bucket < numBuckets; bucket++) {
+            entries[index->bucket_start[buckets[bucket]]++] = (uint16_t) i;
+        }
+    }
+
+    /* bucket_start was moved to the start of the next bucket */
+    for (bucket = SCPI_CMD_INDEX_NUM_BUCKETS; bucket > 0; bucket--) {
+        index->bucket_start[bucket] = index->bucket_start[bucket - 1];
+    }
+    index->bucket_start[0] = 0;
+
+    index->cmdlist = commands;
+
+    return TRUE;
+}
+
+/**
+ * Search matching pattern using command index. Candidates from the header bucket
+ * and not indexed commands are checked in command list order, so the first matching
+ * pattern is the same as with the linear search.
+ * @param index
+ * @param header
+ * @param len
+ * @result matching command or NULL
+ */
+static const scpi_command_t * findCommandIndexed(const scpi_command_index_t * index, const char * header, int len) {
+    int bucket = commandIndexHeaderBucket(header, len);
+    uint16_t i = index->bucket_start[bucket];
+    uint16_t iEnd = index->bucket_start[bucket + 1];
+    uint16_t j = index->bucket_start[SCPI_CMD_INDEX_NUM_BUCKETS];
+    uint16_t jEnd = index->bucket_start[SCPI_CMD_INDEX_NUM_BUCKETS + 1];
+    const scpi_command_t * cmd;
+
+    if (bucket == SCPI_CMD_INDEX_NUM_BUCKETS) {
+        iEnd = i;
+    }
+
+    while (i < iEnd || j < jEnd) {
+        if (j >= jEnd || (i < iEnd && index->entries[i] < index->entries[j])) {
+            cmd = &index->cmdlist[index->entries[i++]];
+        } else {
+            cmd = &index->cmdlist[index->entries[j++]];
+        }
+
+        if (matchCommand(cmd->pattern, header, len, NULL, 0, 0)) {
+            return cmd;
+        }
+    }
+
+    return NULL;
+}
+
 /**
- * Cycle all patterns and search matching pattern. Execute command callback.
+ * Search matching pattern, with command index if there is one
  * @param context
- * @result TRUE if context->paramlist is filled with correct values
+ * @param header
+ * @param len
+ * @result matching command or NULL
  */
-static scpi_bool_t findCommandHeader(scpi_t * context, const char * header, int len) {
+const scpi_command_t * SCPI_FindCommand(scpi_t * context, const char * header, int len) {
     int32_t i;
     const scpi_command_t * cmd;
 
+    if (context->cmdindex != NULL && context->cmdindex->cmdlist == context->cmdlist) {
+        return findCommandIndexed(context->cmdindex, header, len);
+    }
+
     for (i = 0; context->cmdlist[i].pattern != NULL; i++) {
         cmd = &context->cmdlist[i];
         if (matchCommand(cmd->pattern, header, len, NULL, 0, 0)) {
-            context->param_list.cmd = cmd;
-            return TRUE;
+            return cmd;
         }
     }
+    return NULL;
+}
+
+/**
+ * Search matching pattern.
+ * @param context
+ * @result TRUE if context->paramlist is filled with correct values
+ */
+static scpi_bool_t findCommandHeader(scpi_t * context, const char * header, int len) {
+    const scpi_command_t * cmd = SCPI_FindCommand(context, header, len);
+    if (cmd != NULL) {
+        context->param_list.cmd = cmd;
+        return TRUE;
+    }
     return FALSE;
 }
 